@@ -25,6 +25,8 @@ DEFINES += QT_DEPRECATED_WARNINGS
 LIBS += -fopenmp
 LIBS += `pkg-config --libs opencv`
 LIBS += -lcaer
+LIBS += -lz
+LIBS += -llz4 -lzstd
 
 QMAKE_CXXFLAGS += -fopenmp
 
@@ -34,7 +36,27 @@ SOURCES += main.cpp\
     processor.cpp \
     simpletimeplot.cpp \
     aspectratiopixmap.cpp \
-    camerahandler.cpp
+    camerahandler.cpp \
+    summedareatable.cpp \
+    componentlabeler.cpp \
+    temporalsmoothing.cpp \
+    eventimagerenderer.cpp \
+    timesurface.cpp \
+    eventdecoder.cpp \
+    backgroundactivityfilter.cpp \
+    hotpixelfilter.cpp \
+    aedatreader.cpp \
+    columnarwriter.cpp \
+    columnarreader.cpp \
+    eventsource.cpp \
+    aedat4source.cpp \
+    propheseerawsource.cpp \
+    csvsource.cpp \
+    syntheticsource.cpp \
+    processingpool.cpp \
+    pipeline.cpp \
+    pipelinemanager.cpp \
+    recordingtee.cpp
 
 HEADERS  += mainwindow.h \
     eventbuffer.h \
@@ -43,6 +65,28 @@ HEADERS  += mainwindow.h \
     simpletimeplot.h \
     settings.h \
     aspectratiopixmap.h \
-    camerahandler.h
+    camerahandler.h \
+    spscqueue.h \
+    summedareatable.h \
+    componentlabeler.h \
+    temporalsmoothing.h \
+    eventimagerenderer.h \
+    timesurface.h \
+    eventdecoder.h \
+    backgroundactivityfilter.h \
+    hotpixelfilter.h \
+    aedatreader.h \
+    columnarformat.h \
+    columnarwriter.h \
+    columnarreader.h \
+    eventsource.h \
+    aedat4source.h \
+    propheseerawsource.h \
+    csvsource.h \
+    syntheticsource.h \
+    processingpool.h \
+    pipeline.h \
+    pipelinemanager.h \
+    recordingtee.h
 
 FORMS    += mainwindow.ui
@@ -0,0 +1,349 @@
+#include "aedat4source.h"
+
+#include <string.h>
+
+#include "settings.h"
+
+// Size of a polarity event in an event packet: int64 timestamp,
+// int16 x, int16 y, bool polarity and padding
+#define AEDAT4_EVENT_SZ 16
+// Size of the packet header: int32 stream id, int32 size
+#define AEDAT4_PACKET_HEADER_SZ 8
+// Compression types of the IOHeader, the HIGH variants only differ when writing
+#define AEDAT4_COMPRESSION_NONE 0
+#define AEDAT4_COMPRESSION_LZ4 1
+#define AEDAT4_COMPRESSION_LZ4_HIGH 2
+#define AEDAT4_COMPRESSION_ZSTD 3
+#define AEDAT4_COMPRESSION_ZSTD_HIGH 4
+// Upper bound of a decompressed packet, protects against corrupt packets
+#define AEDAT4_MAX_PACKET_SZ (256<<20)
+
+template<typename T>
+static inline T fbRead(const uchar* buf, uint32_t pos)
+{
+    T v;
+    memcpy(&v,buf + pos,sizeof(T));
+    return v;
+}
+
+/**
+ * @brief fbDeref Follows the flatbuffer offset stored at pos.
+ * @return Position of the referenced object or 0 if it is outside the buffer
+ */
+static uint32_t fbDeref(const uchar* buf, uint32_t sz, uint32_t pos)
+{
+    if((uint64_t)pos + 4 > sz)
+        return 0;
+    uint64_t target = (uint64_t)pos + fbRead<uint32_t>(buf,pos);
+    return target < sz ? target : 0;
+}
+
+/**
+ * @brief fbField Looks up a field of a flatbuffer table in its vtable.
+ * @param field Index of the field in the schema
+ * @param fieldSz Size of the field value
+ * @return Position of the field or 0 if it is absent or invalid
+ */
+static uint32_t fbField(const uchar* buf, uint32_t sz, uint32_t table, int field, uint32_t fieldSz)
+{
+    if(table == 0 || (uint64_t)table + 4 > sz)
+        return 0;
+    int64_t vtable = (int64_t)table - fbRead<int32_t>(buf,table);
+    if(vtable < 0 || vtable + 4 > sz)
+        return 0;
+    uint16_t vtableSz = fbRead<uint16_t>(buf,vtable);
+    uint32_t entry = 4 + 2*field;
+    if(entry + 2 > vtableSz || vtable + vtableSz > sz)
+        return 0;
+    uint16_t offset = fbRead<uint16_t>(buf,vtable + entry);
+    if(offset == 0 || (uint64_t)table + offset + fieldSz > sz)
+        return 0;
+    return table + offset;
+}
+
+/**
+ * @brief xmlAttrInt Returns the value of the first integer attribute with the key behind from.
+ */
+static int xmlAttrInt(const QString &xml, const QString &key, int from)
+{
+    int pos = xml.indexOf("key=\"" + key + "\"",from);
+    if(pos < 0)
+        return 0;
+    int start = xml.indexOf(">",pos) + 1;
+    int end = xml.indexOf("<",start);
+    return start > 0 && end > start ? xml.mid(start,end - start).toInt() : 0;
+}
+
+Aedat4Source::Aedat4Source():
+    m_dataOffset(0),
+    m_pos(0),
+    m_dataEnd(0),
+    m_streamId(-1),
+    m_compression(AEDAT4_COMPRESSION_NONE),
+    m_lz4Ctx(NULL),
+    m_zstdCtx(NULL),
+    m_events(NULL),
+    m_eventCnt(0),
+    m_eventPos(0)
+{
+}
+
+Aedat4Source::~Aedat4Source()
+{
+    close();
+}
+
+bool Aedat4Source::open(QString fileName)
+{
+    close();
+    if(!mapFile(fileName))
+        return false;
+    if(!parseHeader()) {
+        close();
+        return false;
+    }
+    if(!probeStream()) {
+        printf("No events in %s\n", fileName.toStdString().c_str());
+        close();
+        return false;
+    }
+    printf("AEDAT4 file: %dx%d\n", m_sx, m_sy);
+    return true;
+}
+
+void Aedat4Source::close()
+{
+    EventSource::close();
+    if(m_lz4Ctx != NULL)
+        LZ4F_freeDecompressionContext(m_lz4Ctx);
+    m_lz4Ctx = NULL;
+    if(m_zstdCtx != NULL)
+        ZSTD_freeDCtx(m_zstdCtx);
+    m_zstdCtx = NULL;
+    m_packetBuffer.clear();
+    m_dataOffset = m_pos = m_dataEnd = 0;
+    m_streamId = -1;
+    m_compression = AEDAT4_COMPRESSION_NONE;
+    m_events = NULL;
+    m_eventCnt = m_eventPos = 0;
+}
+
+void Aedat4Source::setRange(int64_t t0, int64_t t1)
+{
+    // Without an index, packets before t0 are skipped by their last timestamp
+    m_t0 = t0;
+    m_t1 = t1;
+    m_pos = m_dataOffset;
+    m_events = NULL;
+    m_eventCnt = m_eventPos = 0;
+}
+
+size_t Aedat4Source::nextEvents(sDVSEvent *events, int64_t *ts, size_t maxCnt)
+{
+    size_t n = 0;
+    while(n < maxCnt) {
+        if(m_eventPos >= m_eventCnt && !nextPacket())
+            break;
+
+        const uchar* e = m_events + (size_t)m_eventPos*AEDAT4_EVENT_SZ;
+        m_eventPos++;
+        int64_t t;
+        int16_t x, y;
+        memcpy(&t,e,sizeof(t));
+        memcpy(&x,e + 8,sizeof(x));
+        memcpy(&y,e + 10,sizeof(y));
+        if(!pushEvent(x,y,e[12] != 0,t,events,ts,n)) {
+            m_pos = m_dataEnd;
+            m_eventCnt = m_eventPos = 0;
+            break;
+        }
+    }
+    return n;
+}
+
+bool Aedat4Source::parseHeader()
+{
+    const char* text = (const char*)m_data;
+    if(m_size < 11 || strncmp(text,"#!AER-DAT4.",11) != 0)
+        return false;
+
+    // Version line, followed by the size prefixed IOHeader flatbuffer
+    qint64 pos = 11;
+    while(pos < m_size && text[pos] != '\n')
+        pos++;
+    pos++;
+    if(pos + 4 > m_size)
+        return false;
+    int32_t headerSz = fbRead<int32_t>(m_data,pos);
+    pos += 4;
+    if(headerSz <= 0 || pos + headerSz > m_size)
+        return false;
+
+    // IOHeader: compression (int32), dataTablePosition (int64), infoNode (string)
+    const uchar* buf = m_data + pos;
+    uint32_t sz = headerSz;
+    uint32_t table = fbDeref(buf,sz,0);
+    uint32_t f;
+    int32_t compression = (f = fbField(buf,sz,table,0,4)) ? fbRead<int32_t>(buf,f) : 0;
+    int64_t dataTablePos = (f = fbField(buf,sz,table,1,8)) ? fbRead<int64_t>(buf,f) : -1;
+    QString info;
+    uint32_t str;
+    if((f = fbField(buf,sz,table,2,4)) && (str = fbDeref(buf,sz,f)) && str + 4 <= sz) {
+        uint32_t len = fbRead<uint32_t>(buf,str);
+        if((uint64_t)str + 4 + len <= sz)
+            info = QString::fromLatin1((const char*)buf + str + 4,len);
+    }
+
+    m_compression = compression;
+    switch(compression) {
+    case AEDAT4_COMPRESSION_NONE:
+        break;
+    case AEDAT4_COMPRESSION_LZ4:
+    case AEDAT4_COMPRESSION_LZ4_HIGH:
+        if(LZ4F_isError(LZ4F_createDecompressionContext(&m_lz4Ctx,LZ4F_VERSION)))
+            return false;
+        break;
+    case AEDAT4_COMPRESSION_ZSTD:
+    case AEDAT4_COMPRESSION_ZSTD_HIGH:
+        m_zstdCtx = ZSTD_createDCtx();
+        if(m_zstdCtx == NULL)
+            return false;
+        break;
+    default:
+        printf("Unknown AEDAT4 compression %d\n", compression);
+        return false;
+    }
+    m_dataOffset = pos + headerSz;
+    // The optional data table at the end is no packet
+    m_dataEnd = dataTablePos > m_dataOffset && dataTablePos <= m_size ? dataTablePos : m_size;
+
+    // The stream with the polarity events is the node with the type identifier EVTS
+    int typePos = info.indexOf(">EVTS<");
+    if(typePos >= 0) {
+        int nodePos = info.lastIndexOf("<node name=\"",typePos);
+        if(nodePos >= 0)
+            m_streamId = info.mid(nodePos + 12).section("\"",0,0).toInt();
+        m_sx = xmlAttrInt(info,"sizeX",typePos);
+        m_sy = xmlAttrInt(info,"sizeY",typePos);
+    }
+    if(m_streamId < 0) {
+        printf("No event stream in AEDAT4 file\n");
+        return false;
+    }
+    return true;
+}
+
+bool Aedat4Source::nextPacket()
+{
+    while(m_pos + AEDAT4_PACKET_HEADER_SZ <= m_dataEnd) {
+        int32_t streamId = fbRead<int32_t>(m_data,m_pos);
+        int32_t size = fbRead<int32_t>(m_data,m_pos + 4);
+        qint64 start = m_pos + AEDAT4_PACKET_HEADER_SZ;
+        if(size < 0 || start + size > m_dataEnd) {
+            printf("Truncated packet at offset %lld, ignoring the rest of the file\n", m_pos);
+            break;
+        }
+        m_pos = start + size;
+        if(streamId != m_streamId)
+            continue;
+
+        // EventPacket: elements (vector of events)
+        const uchar* buf = m_data + start;
+        if(m_compression != AEDAT4_COMPRESSION_NONE) {
+            int64_t rawSz = decompressPacket(buf,size);
+            if(rawSz < 0) {
+                printf("Skipping corrupt packet at offset %lld\n", start);
+                continue;
+            }
+            buf = m_packetBuffer.data();
+            size = rawSz;
+        }
+        uint32_t table = fbDeref(buf,size,0);
+        uint32_t f = fbField(buf,size,table,0,4);
+        uint32_t vec = f ? fbDeref(buf,size,f) : 0;
+        if(vec == 0 || vec + 4 > (uint32_t)size)
+            continue;
+        uint32_t cnt = fbRead<uint32_t>(buf,vec);
+        if(cnt == 0)
+            continue;
+        if(vec + 4 + (uint64_t)cnt*AEDAT4_EVENT_SZ > (uint64_t)size) {
+            printf("Skipping corrupt packet at offset %lld\n", start);
+            continue;
+        }
+
+        // Events are ordered, skip packets that end before the range
+        int64_t lastTs = fbRead<int64_t>(buf,vec + 4 + (cnt - 1)*AEDAT4_EVENT_SZ);
+        if(lastTs < m_t0)
+            continue;
+
+        m_events = buf + vec + 4;
+        m_eventCnt = cnt;
+        m_eventPos = 0;
+        return true;
+    }
+    m_pos = m_dataEnd;
+    m_events = NULL;
+    m_eventCnt = m_eventPos = 0;
+    return false;
+}
+
+int64_t Aedat4Source::decompressPacket(const uchar* data, uint32_t size)
+{
+    // Each packet is a complete LZ4 or Zstd frame. The decompressed size
+    // is not stored by DV, the buffer grows until the frame fits.
+    if(m_packetBuffer.empty())
+        m_packetBuffer.resize(qMax((size_t)size*4,(size_t)65536));
+
+    size_t dstPos = 0;
+    if(m_lz4Ctx != NULL) {
+        LZ4F_resetDecompressionContext(m_lz4Ctx);
+        size_t srcPos = 0;
+        for(;;) {
+            size_t srcSz = size - srcPos;
+            size_t dstSz = m_packetBuffer.size() - dstPos;
+            size_t ret = LZ4F_decompress(m_lz4Ctx,m_packetBuffer.data() + dstPos,&dstSz,
+                                         data + srcPos,&srcSz,NULL);
+            if(LZ4F_isError(ret))
+                return -1;
+            srcPos += srcSz;
+            dstPos += dstSz;
+            // End of the frame
+            if(ret == 0)
+                break;
+            if(dstPos < m_packetBuffer.size()) {
+                // Truncated frame
+                if(srcPos >= size)
+                    return -1;
+            } else if(m_packetBuffer.size() >= AEDAT4_MAX_PACKET_SZ) {
+                return -1;
+            } else {
+                m_packetBuffer.resize(2*m_packetBuffer.size());
+            }
+        }
+    } else if(m_zstdCtx != NULL) {
+        ZSTD_DCtx_reset(m_zstdCtx,ZSTD_reset_session_only);
+        ZSTD_inBuffer in = {data,size,0};
+        for(;;) {
+            ZSTD_outBuffer out = {m_packetBuffer.data(),m_packetBuffer.size(),dstPos};
+            size_t ret = ZSTD_decompressStream(m_zstdCtx,&out,&in);
+            if(ZSTD_isError(ret))
+                return -1;
+            dstPos = out.pos;
+            // End of the frame
+            if(ret == 0)
+                break;
+            if(dstPos < m_packetBuffer.size()) {
+                // Truncated frame
+                if(in.pos >= in.size)
+                    return -1;
+            } else if(m_packetBuffer.size() >= AEDAT4_MAX_PACKET_SZ) {
+                return -1;
+            } else {
+                m_packetBuffer.resize(2*m_packetBuffer.size());
+            }
+        }
+    } else {
+        return -1;
+    }
+    return dstPos;
+}
@@ -0,0 +1,65 @@
+#ifndef AEDAT4SOURCE_H
+#define AEDAT4SOURCE_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include <QString>
+
+#include <lz4frame.h>
+#include <zstd.h>
+
+#include "eventsource.h"
+
+/**
+ * @brief The Aedat4Source class streams the polarity events of AEDAT 4.0 recordings.
+ * The file consists of a flatbuffer header with an XML description of the streams,
+ * followed by packets of a stream id, a size and a flatbuffer.
+ * The event packets are parsed in place inside the memory mapping, without
+ * a flatbuffers dependency. Packets of LZ4 or Zstd compressed files, the default
+ * of DV, are decompressed into a buffer that is reused for all packets.
+ * Frames and other streams are skipped.
+ */
+class Aedat4Source : public EventSource
+{
+public:
+    Aedat4Source();
+    ~Aedat4Source();
+
+    bool open(QString fileName);
+    void close();
+
+    void setRange(int64_t t0, int64_t t1);
+    size_t nextEvents(sDVSEvent* events, int64_t* ts, size_t maxCnt);
+
+private:
+    bool parseHeader();
+    /**
+     * @brief nextPacket Moves to the next event packet that contains events at or after t0.
+     * @return False at the end of the file
+     */
+    bool nextPacket();
+    /**
+     * @brief decompressPacket Decompresses a packet into the packet buffer.
+     * @param data Compressed flatbuffer of the packet
+     * @param size
+     * @return Size of the decompressed packet, -1 if it is corrupt
+     */
+    int64_t decompressPacket(const uchar* data, uint32_t size);
+
+    // File offsets of the first packet, the next packet and the end of the packets
+    qint64 m_dataOffset, m_pos, m_dataEnd;
+    // Stream id of the polarity events
+    int32_t m_streamId;
+    // Compression of the packets, see AEDAT4_COMPRESSION_*
+    int32_t m_compression;
+    // Decompressed packet and the decompression contexts, reused for all packets
+    std::vector<uchar> m_packetBuffer;
+    LZ4F_dctx* m_lz4Ctx;
+    ZSTD_DCtx* m_zstdCtx;
+    // Events of the current packet inside the mapping or the packet buffer (16 bytes each)
+    const uchar* m_events;
+    uint32_t m_eventCnt, m_eventPos;
+};
+
+#endif // AEDAT4SOURCE_H
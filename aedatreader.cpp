@@ -0,0 +1,374 @@
+#include "aedatreader.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <string.h>
+
+#include "settings.h"
+#include "eventdecoder.h"
+
+// Identifies index files and their layout
+#define AEDAT_INDEX_MAGIC 0x58444941
+#define AEDAT_INDEX_VERSION 1
+
+AedatReader::AedatReader():
+    m_dataOffset(0),
+    m_pos(0),
+    m_endTs(0),
+    m_packet(NULL),
+    m_packetPos(0),
+    m_packetEnd(0),
+    m_framePos(0)
+{
+}
+
+AedatReader::~AedatReader()
+{
+    close();
+}
+
+bool AedatReader::open(QString fileName)
+{
+    close();
+
+    if(!mapFile(fileName))
+        return false;
+    if(!parseHeader()) {
+        close();
+        return false;
+    }
+
+    if(!loadIndex()) {
+        QElapsedTimer timer;
+        timer.start();
+        if(!buildIndex()) {
+            printf("No event packets in %s\n", fileName.toStdString().c_str());
+            close();
+            return false;
+        }
+        printf("Built index of %zu packets in %lld ms\n", m_index.size(), timer.elapsed());
+        if(!saveIndex())
+            printf("Can't write index file for %s\n", fileName.toStdString().c_str());
+    }
+
+    m_maxLastTs.resize(m_index.size());
+    m_minFirstTs.resize(m_index.size());
+    int64_t maxTs = INT64_MIN;
+    for(size_t i = 0; i < m_index.size(); i++) {
+        maxTs = std::max(maxTs,m_index[i].lastTs);
+        m_maxLastTs[i] = maxTs;
+    }
+    int64_t minTs = INT64_MAX;
+    for(size_t i = m_index.size(); i-- > 0;) {
+        minTs = std::min(minTs,m_index[i].firstTs);
+        m_minFirstTs[i] = minTs;
+    }
+    m_startTs = m_minFirstTs.front();
+    m_endTs = m_maxLastTs.back();
+
+    if(m_sx == 0 || m_sy == 0)
+        findSensorSize();
+
+    printf("AEDAT file: %s, %dx%d, %.1f s\n", m_source.toStdString().c_str(),
+           m_sx, m_sy, (m_endTs - m_startTs)/1000000.0);
+
+    setRange(INT64_MIN,INT64_MAX);
+    return true;
+}
+
+void AedatReader::close()
+{
+    EventSource::close();
+    m_dataOffset = 0;
+    m_source.clear();
+    m_index.clear();
+    m_maxLastTs.clear();
+    m_minFirstTs.clear();
+    m_pos = 0;
+    m_packet = NULL;
+    m_packetPos = m_packetEnd = 0;
+    m_frames.clear();
+    m_framePos = 0;
+}
+
+void AedatReader::setRange(int64_t t0, int64_t t1)
+{
+    m_t0 = t0;
+    m_t1 = t1;
+    seek(t0);
+}
+
+void AedatReader::seek(int64_t ts)
+{
+    m_pos = std::lower_bound(m_maxLastTs.begin(),m_maxLastTs.end(),ts) - m_maxLastTs.begin();
+    m_packet = NULL;
+    m_packetPos = m_packetEnd = 0;
+    m_frames.clear();
+    m_framePos = 0;
+}
+
+size_t AedatReader::nextEvents(sDVSEvent *events, int64_t *ts, size_t maxCnt)
+{
+    size_t n = 0;
+    while(n < maxCnt) {
+        if(m_packetPos >= m_packetEnd) {
+            // Return the events before the queued frames to keep them in order
+            if(n > 0 && m_framePos < m_frames.size())
+                break;
+
+            int32_t begin, end;
+            caerEventPacketHeaderConst packet = nextPacket(begin,end);
+            if(packet == NULL)
+                break;
+            if(packet->eventType == FRAME_EVENT) {
+                if(m_framePos == m_frames.size()) {
+                    m_frames.clear();
+                    m_framePos = 0;
+                }
+                caerFrameEventPacketConst framePacket = (caerFrameEventPacketConst)packet;
+                for(int32_t i = begin; i < end; i++) {
+                    caerFrameEventConst frame = caerFrameEventPacketGetEventConst(framePacket,i);
+                    if(caerFrameEventIsValid(frame))
+                        m_frames.push_back(std::make_pair(caerFrameEventGetTimestamp64(frame,framePacket),
+                                                          (caerFrameEvent)frame));
+                }
+            } else if(packet->eventType == POLARITY_EVENT) {
+                m_packet = (caerPolarityEventPacketConst)packet;
+                m_packetPos = begin;
+                m_packetEnd = end;
+            }
+            continue;
+        }
+
+        int32_t cnt = std::min((size_t)(m_packetEnd - m_packetPos),maxCnt - n);
+        size_t decoded = decodePolarityRange(m_packet,m_packetPos,m_packetPos + cnt,events + n);
+        // The decoder keeps the lower 32 bits, the packet overflow counter the rest
+        int64_t high = (int64_t)(m_packet->packetHeader.eventTSOverflow >> 1) << 32;
+        for(size_t i = n; i < n + decoded; i++)
+            ts[i] = high | events[i].ts;
+        m_packetPos += cnt;
+        n += decoded;
+    }
+    return n;
+}
+
+bool AedatReader::nextFrameTime(int64_t &ts) const
+{
+    if(m_framePos >= m_frames.size())
+        return false;
+    ts = m_frames[m_framePos].first;
+    return true;
+}
+
+caerFrameEvent AedatReader::nextFrame()
+{
+    if(m_framePos >= m_frames.size())
+        return NULL;
+    return m_frames[m_framePos++].second;
+}
+
+void AedatReader::skipFrame()
+{
+    if(m_framePos < m_frames.size())
+        m_framePos++;
+}
+
+caerEventPacketHeaderConst AedatReader::nextPacket(int32_t &begin, int32_t &end)
+{
+    while(m_pos < m_index.size()) {
+        // All remaining packets start behind the range
+        if(m_minFirstTs[m_pos] > m_t1)
+            break;
+
+        const sAedatIndexEntry &e = m_index[m_pos++];
+        if(e.lastTs < m_t0 || e.firstTs > m_t1)
+            continue;
+
+        caerEventPacketHeaderConst packet = (caerEventPacketHeaderConst)(m_data + e.offset);
+        begin = e.firstTs >= m_t0 ? 0 : lowerBound(packet,m_t0);
+        end = e.lastTs <= m_t1 ? packet->eventNumber : lowerBound(packet,m_t1 + 1);
+        if(begin < end)
+            return packet;
+    }
+    m_pos = m_index.size();
+    return NULL;
+}
+
+bool AedatReader::parseHeader()
+{
+    const char* text = (const char*)m_data;
+    qint64 maxSz = std::min(m_size,(qint64)AEDAT_MAX_HEADER_SZ);
+    if(maxSz < 11 || strncmp(text,"#!AER-DAT3.",11) != 0)
+        return false;
+
+    qint64 pos = 0;
+    while(pos < maxSz && text[pos] == '#') {
+        qint64 lineEnd = pos;
+        while(lineEnd < maxSz && text[lineEnd] != '\n')
+            lineEnd++;
+        QString line = QString::fromLatin1(text + pos, lineEnd - pos).trimmed();
+        pos = lineEnd + 1;
+
+        if(line.startsWith("#Source ")) {
+            // e.g. "#Source 1: DAVIS240C"
+            m_source = line.section(": ",1).trimmed();
+        } else if(line == "#!END-HEADER") {
+            m_dataOffset = pos;
+            break;
+        }
+    }
+    if(m_dataOffset == 0)
+        return false;
+
+    // Known sensors, other sizes are determined from the data
+    if(m_source.startsWith("DAVIS240")) {
+        m_sx = 240;
+        m_sy = 180;
+    } else if(m_source.startsWith("DAVIS346")) {
+        m_sx = 346;
+        m_sy = 260;
+    } else if(m_source.startsWith("DAVIS640")) {
+        m_sx = 640;
+        m_sy = 480;
+    } else if(m_source.startsWith("DVS128") || m_source.startsWith("DAVIS128")) {
+        m_sx = 128;
+        m_sy = 128;
+    }
+    return true;
+}
+
+bool AedatReader::buildIndex()
+{
+    m_index.clear();
+    const qint64 headerSz = sizeof(struct caer_event_packet_header);
+    qint64 offset = m_dataOffset;
+    while(offset + headerSz <= m_size) {
+        caerEventPacketHeaderConst packet = (caerEventPacketHeaderConst)(m_data + offset);
+        if(packet->eventSize <= 0 || packet->eventNumber < 0 ||
+                packet->eventCapacity < packet->eventNumber) {
+            printf("Invalid packet at offset %lld, ignoring the rest of the file\n", offset);
+            break;
+        }
+        qint64 packetSz = headerSz + (qint64)packet->eventCapacity*packet->eventSize;
+        if(offset + packetSz > m_size) {
+            printf("Truncated packet at offset %lld, ignoring the rest of the file\n", offset);
+            break;
+        }
+
+        if(packet->eventNumber > 0) {
+            sAedatIndexEntry e;
+            e.offset = offset;
+            e.firstTs = eventTs(packet,0);
+            e.lastTs = eventTs(packet,packet->eventNumber - 1);
+            e.type = packet->eventType;
+            m_index.push_back(e);
+        }
+        offset += packetSz;
+    }
+    return !m_index.empty();
+}
+
+bool AedatReader::loadIndex()
+{
+    QFile file(m_file.fileName() + AEDAT_INDEX_SUFFIX);
+    if(!file.exists() || !file.open(QIODevice::ReadOnly))
+        return false;
+
+    uint32_t magic = 0, version = 0;
+    uint64_t fileSz = 0, cnt = 0;
+    uint16_t sx = 0, sy = 0;
+    if(file.read((char*)&magic,sizeof(magic)) != sizeof(magic) ||
+            file.read((char*)&version,sizeof(version)) != sizeof(version) ||
+            file.read((char*)&fileSz,sizeof(fileSz)) != sizeof(fileSz) ||
+            file.read((char*)&sx,sizeof(sx)) != sizeof(sx) ||
+            file.read((char*)&sy,sizeof(sy)) != sizeof(sy) ||
+            file.read((char*)&cnt,sizeof(cnt)) != sizeof(cnt))
+        return false;
+    // The recording was changed if the size differs
+    if(magic != AEDAT_INDEX_MAGIC || version != AEDAT_INDEX_VERSION ||
+            fileSz != (uint64_t)m_size || cnt == 0 ||
+            file.size() != (qint64)(4+4+8+2+2+8 + cnt*sizeof(sAedatIndexEntry)))
+        return false;
+
+    m_index.resize(cnt);
+    if(file.read((char*)m_index.data(),cnt*sizeof(sAedatIndexEntry)) != (qint64)(cnt*sizeof(sAedatIndexEntry))) {
+        m_index.clear();
+        return false;
+    }
+    if(sx > 0 && sy > 0) {
+        m_sx = sx;
+        m_sy = sy;
+    }
+    return true;
+}
+
+bool AedatReader::saveIndex()
+{
+    if(m_sx == 0 || m_sy == 0)
+        findSensorSize();
+
+    QFile file(m_file.fileName() + AEDAT_INDEX_SUFFIX);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    uint32_t magic = AEDAT_INDEX_MAGIC, version = AEDAT_INDEX_VERSION;
+    uint64_t fileSz = m_size, cnt = m_index.size();
+    return file.write((const char*)&magic,sizeof(magic)) == sizeof(magic) &&
+           file.write((const char*)&version,sizeof(version)) == sizeof(version) &&
+           file.write((const char*)&fileSz,sizeof(fileSz)) == sizeof(fileSz) &&
+           file.write((const char*)&m_sx,sizeof(m_sx)) == sizeof(m_sx) &&
+           file.write((const char*)&m_sy,sizeof(m_sy)) == sizeof(m_sy) &&
+           file.write((const char*)&cnt,sizeof(cnt)) == sizeof(cnt) &&
+           file.write((const char*)m_index.data(),cnt*sizeof(sAedatIndexEntry)) == (qint64)(cnt*sizeof(sAedatIndexEntry));
+}
+
+void AedatReader::findSensorSize()
+{
+    int maxX = -1, maxY = -1;
+    size_t probed = 0;
+    for(size_t i = 0; i < m_index.size() && probed < AEDAT_SIZE_PROBE_PACKETS; i++) {
+        caerEventPacketHeaderConst packet = (caerEventPacketHeaderConst)(m_data + m_index[i].offset);
+        if(m_index[i].type == FRAME_EVENT) {
+            // Frames have the full sensor size
+            caerFrameEventConst frame = (caerFrameEventConst)(packet + 1);
+            m_sx = caerFrameEventGetLengthX(frame);
+            m_sy = caerFrameEventGetLengthY(frame);
+            return;
+        } else if(m_index[i].type == POLARITY_EVENT) {
+            caerPolarityEventPacketConst polarity = (caerPolarityEventPacketConst)packet;
+            for(int32_t j = 0; j < packet->eventNumber; j++) {
+                caerPolarityEventConst ev = &polarity->events[j];
+                if(!caerPolarityEventIsValid(ev))
+                    continue;
+                maxX = std::max(maxX,(int)caerPolarityEventGetX(ev));
+                maxY = std::max(maxY,(int)caerPolarityEventGetY(ev));
+            }
+            probed++;
+        }
+    }
+    m_sx = maxX + 1;
+    m_sy = maxY + 1;
+}
+
+int64_t AedatReader::eventTs(caerEventPacketHeaderConst packet, int32_t i)
+{
+    const uint8_t* ev = (const uint8_t*)(packet + 1) + (size_t)i*packet->eventSize;
+    int32_t ts;
+    memcpy(&ts, ev + packet->eventTSOffset, sizeof(ts));
+    return ((int64_t)packet->eventTSOverflow << TS_OVERFLOW_SHIFT) | ts;
+}
+
+int32_t AedatReader::lowerBound(caerEventPacketHeaderConst packet, int64_t ts)
+{
+    // Timestamps are ordered within a packet
+    int32_t lo = 0, hi = packet->eventNumber;
+    while(lo < hi) {
+        int32_t mid = lo + (hi - lo)/2;
+        if(eventTs(packet,mid) < ts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
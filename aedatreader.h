@@ -0,0 +1,149 @@
+#ifndef AEDATREADER_H
+#define AEDATREADER_H
+
+#include <inttypes.h>
+#include <vector>
+#include <utility>
+
+#include <QString>
+
+#include <libcaer/events/common.h>
+#include <libcaer/events/polarity.h>
+#include <libcaer/events/frame.h>
+
+#include "eventsource.h"
+
+/**
+ * Index entry for a single event packet of an AEDAT file.
+ */
+typedef struct sAedatIndexEntry {
+    // File offset of the packet header
+    uint64_t offset;
+    // 64 bit timestamps of the first and last event in us
+    int64_t firstTs;
+    int64_t lastTs;
+    // Event type of the packet
+    int16_t type;
+} sAedatIndexEntry;
+
+/**
+ * @brief The AedatReader class reads AEDAT 3.x recordings through a memory mapping.
+ * Packets are returned as pointers into the mapping, nothing is copied.
+ * A timestamp index of all packets is built on the first open and cached
+ * in a file next to the recording. It allows to seek to any time and
+ * to restrict the playback to a time range.
+ * Events can be read packet by packet with nextPacket or as decoded batches
+ * through the EventSource interface, but not both at the same time.
+ * The file format is little endian, like the supported platforms.
+ */
+class AedatReader : public EventSource
+{
+public:
+    AedatReader();
+    ~AedatReader();
+
+    /**
+     * @brief open Maps the file and loads or builds its index.
+     * @param fileName
+     * @return False if the file can't be opened or is no AEDAT 3.x file
+     */
+    bool open(QString fileName);
+    void close();
+
+    /**
+     * @brief getEndTime Returns the time of the last event in the recording.
+     * @return
+     */
+    int64_t getEndTime() const
+    {
+        return m_endTs;
+    }
+
+    /**
+     * @brief setRange Restricts the playback to events in [t0,t1] and seeks to t0.
+     * @param t0 Absolute time in us
+     * @param t1 Absolute time in us
+     */
+    void setRange(int64_t t0, int64_t t1);
+    /**
+     * @brief nextEvents Decodes the polarity events of the next packets in the range.
+     * Frames of the scanned packets are queued and returned by nextFrame.
+     * @param events
+     * @param ts
+     * @param maxCnt
+     * @return
+     */
+    size_t nextEvents(sDVSEvent* events, int64_t* ts, size_t maxCnt);
+    bool nextFrameTime(int64_t &ts) const;
+    caerFrameEvent nextFrame();
+    void skipFrame();
+    /**
+     * @brief seek Continues the playback at the first packet that contains events at or after ts.
+     * @param ts Absolute time in us
+     */
+    void seek(int64_t ts);
+
+    /**
+     * @brief nextPacket Returns the next packet with events in the range
+     * and the indices of these events.
+     * @param begin First event in the range
+     * @param end Behind the last event in the range
+     * @return Packet inside the mapping or NULL at the end of the range
+     */
+    caerEventPacketHeaderConst nextPacket(int32_t &begin, int32_t &end);
+    /**
+     * @brief getEntry Returns the index entry of the packet that was last returned by nextPacket.
+     * @return
+     */
+    const sAedatIndexEntry &getEntry() const
+    {
+        return m_index[m_pos-1];
+    }
+
+private:
+    bool parseHeader();
+    bool buildIndex();
+    bool loadIndex();
+    bool saveIndex();
+    /**
+     * @brief findSensorSize Determines the sensor size from the first frames
+     * or events if the source is unknown.
+     */
+    void findSensorSize();
+    /**
+     * @brief eventTs Returns the 64 bit timestamp of an event in a packet.
+     * @param packet
+     * @param i
+     * @return
+     */
+    static int64_t eventTs(caerEventPacketHeaderConst packet, int32_t i);
+    /**
+     * @brief lowerBound Returns the index of the first event with a timestamp of at least ts.
+     * @param packet
+     * @param ts
+     * @return
+     */
+    static int32_t lowerBound(caerEventPacketHeaderConst packet, int64_t ts);
+
+    // Offset of the first packet behind the text header
+    qint64 m_dataOffset;
+    QString m_source;
+
+    std::vector<sAedatIndexEntry> m_index;
+    // Largest last timestamp up to each packet and smallest first timestamp from
+    // each packet on. Packets of different types may overlap in time.
+    std::vector<int64_t> m_maxLastTs;
+    std::vector<int64_t> m_minFirstTs;
+    // Next packet
+    size_t m_pos;
+    int64_t m_endTs;
+
+    // Polarity packet and events that are not yet returned by nextEvents
+    caerPolarityEventPacketConst m_packet;
+    int32_t m_packetPos, m_packetEnd;
+    // Valid frames of the scanned packets that are not yet returned by nextFrame
+    std::vector<std::pair<int64_t,caerFrameEvent> > m_frames;
+    size_t m_framePos;
+};
+
+#endif // AEDATREADER_H
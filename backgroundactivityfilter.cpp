@@ -0,0 +1,71 @@
+#include "backgroundactivityfilter.h"
+
+#include <algorithm>
+
+#include "settings.h"
+
+BackgroundActivityFilter::BackgroundActivityFilter():
+    m_stride(0),
+    m_sx(0),
+    m_sy(0),
+    m_initialized(false),
+    m_timeWindow(NOISE_FILTER_TIME_WINDOW_US),
+    m_enabled(NOISE_FILTER_ENABLED),
+    m_totalCnt(0),
+    m_droppedCnt(0)
+{
+}
+
+void BackgroundActivityFilter::setup(uint16_t sx, uint16_t sy)
+{
+    m_sx = sx;
+    m_sy = sy;
+    m_stride = sx + 2;
+    m_lastTs.resize(m_stride*(sy + 2));
+    m_initialized = false;
+    m_totalCnt = 0;
+    m_droppedCnt = 0;
+}
+
+size_t BackgroundActivityFilter::filterEvents(sDVSEvent *events, size_t cnt)
+{
+    if(!m_enabled || cnt == 0 || m_lastTs.empty())
+        return cnt;
+
+    const uint32_t dt = m_timeWindow;
+    if(!m_initialized) {
+        // No pixel has support at the beginning
+        std::fill(m_lastTs.begin(),m_lastTs.end(),events[0].ts - dt - 1);
+        m_initialized = true;
+    }
+
+    const size_t s = m_stride;
+    size_t n = 0;
+    for(size_t i = 0; i < cnt; i++) {
+        const uint32_t ts = events[i].ts;
+        const uint16_t x = dvsEventX(events[i].addr);
+        const uint16_t y = dvsEventY(events[i].addr);
+        if(x >= m_sx || y >= m_sy)
+            continue;
+
+        uint32_t* p = &m_lastTs[(y + 1)*s + x + 1];
+        bool supported = ts - *p <= dt;
+
+        // Support all neighbours, but not the pixel itself
+        p[-s-1] = ts;
+        p[-s] = ts;
+        p[-s+1] = ts;
+        p[-1] = ts;
+        p[1] = ts;
+        p[s-1] = ts;
+        p[s] = ts;
+        p[s+1] = ts;
+
+        if(supported)
+            events[n++] = events[i];
+    }
+
+    m_totalCnt += cnt;
+    m_droppedCnt += cnt - n;
+    return n;
+}
@@ -0,0 +1,93 @@
+#ifndef BACKGROUNDACTIVITYFILTER_H
+#define BACKGROUNDACTIVITYFILTER_H
+
+#include <atomic>
+#include <vector>
+
+#include "camerahandler.h"
+#include "datatypes.h"
+
+/**
+ * @brief The BackgroundActivityFilter class removes uncorrelated noise events.
+ * An event passes if one of its 8 neighbours had an event within the time window.
+ * Each event writes its timestamp to the neighbours in a per pixel map,
+ * so the check itself is a single lookup. Runs on the camera thread.
+ */
+class BackgroundActivityFilter: public CameraHandler::IEventFilter
+{
+public:
+    BackgroundActivityFilter();
+
+    /**
+     * @brief setup Allocates the timestamp map for the sensor size and resets the counters.
+     * Must not be called while streaming.
+     * @param sx
+     * @param sy
+     */
+    void setup(uint16_t sx, uint16_t sy);
+    /**
+     * @brief filterEvents Implements the filter interface of the camera handler.
+     * @param events
+     * @param cnt
+     * @return
+     */
+    size_t filterEvents(sDVSEvent* events, size_t cnt);
+
+    /**
+     * @brief setTimeWindow Sets the maximum time to a supporting neighbour event.
+     * Can be changed while streaming.
+     * @param us
+     */
+    void setTimeWindow(uint32_t us)
+    {
+        m_timeWindow = us;
+    }
+    uint32_t getTimeWindow()
+    {
+        return m_timeWindow;
+    }
+    /**
+     * @brief setEnabled Enables or disables the filter. Can be changed while streaming.
+     * @param enabled
+     */
+    void setEnabled(bool enabled)
+    {
+        m_enabled = enabled;
+    }
+    bool isEnabled()
+    {
+        return m_enabled;
+    }
+    /**
+     * @brief getTotalCnt Returns the number of filtered events since the last setup.
+     * @return
+     */
+    uint64_t getTotalCnt()
+    {
+        return m_totalCnt;
+    }
+    /**
+     * @brief getDroppedCnt Returns the number of removed events since the last setup.
+     * @return
+     */
+    uint64_t getDroppedCnt()
+    {
+        return m_droppedCnt;
+    }
+
+private:
+    // Time of the last event in the neighbourhood of each pixel,
+    // with a border of one pixel to avoid bound checks
+    std::vector<uint32_t> m_lastTs;
+    size_t m_stride;
+    uint16_t m_sx,m_sy;
+    // True after the first event, the map is initialized relative to it
+    bool m_initialized;
+
+    std::atomic<uint32_t> m_timeWindow;
+    std::atomic_bool m_enabled;
+    std::atomic<uint64_t> m_totalCnt;
+    std::atomic<uint64_t> m_droppedCnt;
+};
+
+#endif // BACKGROUNDACTIVITYFILTER_H
@@ -3,7 +3,11 @@
 #include <QVector2D>
 #include <QtConcurrent/QtConcurrent>
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "settings.h"
+#include "eventdecoder.h"
 
 void playbackFinished(void* ptr)
 {
@@ -17,10 +21,20 @@ void playbackFinished(void* ptr)
 CameraHandler::CameraHandler()
     :m_davisHandle(NULL),
      m_playbackHandle(NULL),
+     m_source(NULL),
      m_isStreaming(false),
      m_isConnected(false),
      m_eventReciever(nullptr),
-     m_frameReciever(nullptr)
+     m_frameReciever(nullptr),
+     m_playbackSpeed(1),
+     m_playbackRefSpeed(0),
+     m_playbackRefTs(0),
+     m_playbackFrom(INT64_MIN),
+     m_playbackTo(INT64_MAX),
+     m_playbackRangeFromUs(0),
+     m_playbackRangeToUs(0),
+     m_recordFormat(RECORDING_FORMAT),
+     m_recordMaxFileBytes(0)
 {
     currTs = 0;
 }
@@ -46,6 +60,11 @@ void CameraHandler::disconnect()
         m_playbackHandle = NULL;
         playbackFinishedCallback = NULL;
         callbackParam = NULL;
+    } else if(m_source != NULL) {
+        delete m_source;
+        m_source = NULL;
+        playbackFinishedCallback = NULL;
+        callbackParam = NULL;
     }
 }
 bool CameraHandler::connect(QString file, void (*playbackFinishedCallback)(void*), void* param)
@@ -53,6 +72,23 @@ bool CameraHandler::connect(QString file, void (*playbackFinishedCallback)(void*
     if(m_isConnected)
         disconnect();
 
+    // Supported formats are read directly, other formats (e.g. AEDAT 2.0) through libcaer
+    m_source = EventSource::create(file);
+    if(m_source != NULL) {
+        m_isConnected = true;
+        this->playbackFinishedCallback = playbackFinishedCallback;
+        this->callbackParam = param;
+
+        int64_t start = m_source->getStartTime();
+        m_playbackFrom = start + m_playbackRangeFromUs;
+        m_playbackTo = m_playbackRangeToUs > 0 ? start + m_playbackRangeToUs : INT64_MAX;
+        QVector2D sz = getFrameSize();
+        printf("DVS X: %d, DVS Y: %d.\n", (int)sz.x(), (int)sz.y());
+        return true;
+    }
+    if(m_playbackRangeFromUs > 0 || m_playbackRangeToUs > 0)
+        printf("Playback range is not supported for this file.\n");
+
     m_playbackHandle = playbackOpen(file.toStdString().c_str(),playbackFinished,this);
 
     if(m_playbackHandle == NULL) {
@@ -71,11 +107,13 @@ bool CameraHandler::connect(QString file, void (*playbackFinishedCallback)(void*
     }
 }
 
-bool CameraHandler::connect(int devId)
+bool CameraHandler::connect(int devId, QString serial)
 {
     if(m_isConnected)
         disconnect();
-    m_davisHandle = caerDeviceOpen(devId, CAER_DEVICE_DAVIS, 0, 0, NULL);
+    std::string serialStr = serial.toStdString();
+    m_davisHandle = caerDeviceOpen(devId, CAER_DEVICE_DAVIS, 0, 0,
+                                   serial.isEmpty() ? NULL : serialStr.c_str());
 
     if(m_davisHandle == NULL) {
         printf("Can't connect to device!\n");
@@ -84,9 +122,9 @@ bool CameraHandler::connect(int devId)
     m_isConnected = true;
     struct caer_davis_info davis_info = caerDavisInfoGet(m_davisHandle);
 
-    printf("%s --- ID: %d, Master: %d, DVS X: %d, DVS Y: %d, Logic: %d.\n", davis_info.deviceString,
-           davis_info.deviceID, davis_info.deviceIsMaster, davis_info.dvsSizeX, davis_info.dvsSizeY,
-           davis_info.logicVersion);
+    printf("%s --- ID: %d, Serial: %s, Master: %d, DVS X: %d, DVS Y: %d, Logic: %d.\n", davis_info.deviceString,
+           davis_info.deviceID, davis_info.deviceSerialNumber, davis_info.deviceIsMaster,
+           davis_info.dvsSizeX, davis_info.dvsSizeY, davis_info.logicVersion);
 
     writeConfig();
     return true;
@@ -103,6 +141,10 @@ void CameraHandler::startStreaming()
 void CameraHandler::stopStreaming()
 {
     m_isStreaming = false;
+    {
+        QMutexLocker locker(&m_idleMutex);
+        m_idleCondition.wakeAll();
+    }
     m_future.waitForFinished();
 }
 QVector2D CameraHandler::getFrameSize()
@@ -117,6 +159,9 @@ QVector2D CameraHandler::getFrameSize()
             playbackInfo info = caerPlaybackInfoGet(m_playbackHandle);
             sx = info->sx;
             sy = info->sy;
+        } else if(m_source != NULL) {
+            sx = m_source->getWidth();
+            sy = m_source->getHeight();
         }
         return QVector2D(sx,sy);
 
@@ -125,8 +170,22 @@ QVector2D CameraHandler::getFrameSize()
     }
 }
 
+QString CameraHandler::getSerialNumber()
+{
+    if(m_isConnected && m_davisHandle) {
+        struct caer_davis_info info = caerDavisInfoGet(m_davisHandle);
+        return QString(info.deviceSerialNumber);
+    }
+    return QString();
+}
+
 void CameraHandler::run()
 {
+    if(m_source != NULL) {
+        playSource();
+        return;
+    }
+
     if(m_davisHandle != NULL) {
         bool success = caerDeviceDataStart(m_davisHandle, NULL, NULL, NULL, NULL, NULL);
         if(!success) {
@@ -136,26 +195,38 @@ void CameraHandler::run()
 
         // Let's turn on blocking data-get mode to avoid wasting resources.
         caerDeviceConfigSet(m_davisHandle, CAER_HOST_CONFIG_DATAEXCHANGE, CAER_HOST_CONFIG_DATAEXCHANGE_BLOCKING, true);
+
+        if(!m_recordFile.isEmpty()) {
+            QVector2D sz = getFrameSize();
+            m_recordingTee.start(m_recordFile,m_recordFormat,m_recordMaxFileBytes,sz.x(),sz.y());
+        }
     } else if(m_playbackHandle != NULL) {
         playbackDataStart(m_playbackHandle);
     }
     printf("Streaming started.\n");
     QElapsedTimer timer;
     timer.start();
+    unsigned long idleWaitMs = CAMERA_IDLE_WAIT_MIN_MS;
     while (m_isStreaming) {
-        QMutexLocker locker(&m_camLock);
         caerEventPacketContainer packetContainer = NULL;
-        if(m_davisHandle != NULL)
-            packetContainer = caerDeviceDataGet(m_davisHandle);
-        else if(m_playbackHandle != NULL)
-            packetContainer = playbackDataGet(m_playbackHandle);
+        {
+            QMutexLocker locker(&m_camLock);
+            if(m_davisHandle != NULL)
+                packetContainer = caerDeviceDataGet(m_davisHandle);
+            else if(m_playbackHandle != NULL)
+                packetContainer = playbackDataGet(m_playbackHandle);
+        }
 
         if (packetContainer == NULL) {
-            // Wait a bit!
-            QThread::usleep(1);
-            //QThread::yieldCurrentThread();
+            // Wait without holding the camera lock. The device blocks in caerDeviceDataGet,
+            // so this mainly throttles the playback, which returns immediately.
+            QMutexLocker locker(&m_idleMutex);
+            if(m_isStreaming)
+                m_idleCondition.wait(&m_idleMutex,idleWaitMs);
+            idleWaitMs = qMin(2*idleWaitMs,(unsigned long)CAMERA_IDLE_WAIT_MAX_MS);
             continue; // Skip if nothing there.
         }
+        idleWaitMs = CAMERA_IDLE_WAIT_MIN_MS;
 
         int32_t packetNum = caerEventPacketContainerGetEventPacketsNumber(packetContainer);
         //printf("\nGot event container with %d packets (allocated).\n", packetNum);
@@ -169,48 +240,141 @@ void CameraHandler::run()
 
             //printf("Packet %d of type %d -> size is %d.\n", i, caerEventPacketHeaderGetEventType(packetHeader),
             //        caerEventPacketHeaderGetEventNumber(packetHeader));
-
-            // DVS-Events
-            if (i == POLARITY_EVENT) {
-                caerPolarityEventPacket polarity = (caerPolarityEventPacket) packetHeader;
-                for(int i = 0; i < polarity->packetHeader.eventValid; i++) {
-                    // Get full timestamp and addresses of first event.
-                    caerPolarityEvent firstEvent = caerPolarityEventPacketGetEvent(polarity, i);
-
-                    sDVSEventDepacked e;
-                    e.ts = caerPolarityEventGetTimestamp(firstEvent);
-                    e.x = caerPolarityEventGetX(firstEvent);
-                    e.y = caerPolarityEventGetY(firstEvent);
-                    e.pol = caerPolarityEventGetPolarity(firstEvent);
-
-                    if(m_frameReciever != nullptr) {
-                        m_eventReciever->newEvent(e);
-                    }
-                }
-
-            } // Frames
-            else if(i == FRAME_EVENT) {
-                caerFrameEventPacket framePacket = (caerFrameEventPacket) packetHeader;
-                for(int i = 0; i < framePacket->packetHeader.eventValid; i++) {
-                    caerFrameEvent frame = caerFrameEventPacketGetEvent(framePacket,i);
-
-                    if(m_frameReciever != nullptr) {
-                        m_frameReciever->newFrame(frame);
-                    }
+            // Never blocks, packets are dropped if the disk falls behind
+            m_recordingTee.addPacket(packetHeader);
+            if(packetHeader->eventType == FRAME_EVENT) {
+                // Frames are only decoded if needed. The packet is handed over to
+                // the frame references instead of copying the pixels.
+                if(wantsFrames()) {
+                    caerEventPacketContainerSetEventPacket(packetContainer, i, NULL);
+                    deliverFramePacket(std::shared_ptr<struct caer_event_packet_header>(packetHeader,free));
                 }
+                continue;
             }
+            processPacket(packetHeader,0,packetHeader->eventNumber);
         }
         caerEventPacketContainerFree(packetContainer);
     }
 
     if(m_davisHandle != NULL) {
         caerDeviceDataStop(m_davisHandle);
+        m_recordingTee.stop();
     } else if(m_playbackHandle != NULL) {
         playbackDataStop(m_playbackHandle);
     }
 
     printf("Streaming stopped.\n");
 }
+
+void CameraHandler::playSource()
+{
+    printf("Streaming started.\n");
+    m_source->setRange(m_playbackFrom,m_playbackTo);
+    m_playbackRefSpeed = 0;
+    // Small chunks keep the pacing smooth
+    m_eventBatch.resize(EVENT_SOURCE_CHUNK);
+    m_eventBatchTs.resize(EVENT_SOURCE_CHUNK);
+
+    bool finished = false;
+    while (m_isStreaming) {
+        size_t cnt = m_source->nextEvents(m_eventBatch.data(),m_eventBatchTs.data(),EVENT_SOURCE_CHUNK);
+        if(cnt == 0) {
+            deliverSourceFrames(INT64_MAX);
+            finished = true;
+            break;
+        }
+
+        deliverSourceFrames(m_eventBatchTs[0]);
+        waitForPlaybackTime(m_eventBatchTs[0]);
+        deliverEvents(m_eventBatch.data(),cnt);
+    }
+
+    printf("Streaming stopped.\n");
+    if(finished)
+        playbackFinished(this);
+}
+
+void CameraHandler::deliverSourceFrames(int64_t ts)
+{
+    int64_t frameTs;
+    while(m_isStreaming && m_source->nextFrameTime(frameTs) && frameTs <= ts) {
+        if(!wantsFrames()) {
+            m_source->skipFrame();
+            continue;
+        }
+        caerFrameEvent frame = m_source->nextFrame();
+        if(frame == NULL)
+            continue;
+        // Source frames are only valid until the next call, the receiver gets its own copy
+        size_t sz = sizeof(struct caer_frame_event) + (size_t)frame->lengthX*frame->lengthY*sizeof(uint16_t);
+        void* copy = malloc(sz);
+        if(copy == NULL)
+            continue;
+        memcpy(copy,frame,sz);
+        m_frameReciever->newFrame(tFrameRef((caerFrameEvent)copy,free));
+    }
+}
+
+void CameraHandler::waitForPlaybackTime(int64_t ts)
+{
+    // Data is delivered when its timestamp is due, relative
+    // to the first delivered data and scaled by the playback speed
+    float speed = m_playbackSpeed;
+    if(speed != m_playbackRefSpeed) {
+        m_playbackRefTs = ts;
+        m_playbackRefSpeed = speed;
+        m_playbackTimer.restart();
+    }
+    // Speeds of zero or below replay as fast as possible
+    if(speed <= 0)
+        return;
+
+    qint64 dueUs = (ts - m_playbackRefTs)/speed;
+    qint64 waitUs;
+    while(m_isStreaming && (waitUs = dueUs - m_playbackTimer.nsecsElapsed()/1000) > 0) {
+        QMutexLocker locker(&m_idleMutex);
+        if(m_isStreaming)
+            m_idleCondition.wait(&m_idleMutex,qMax(1LL,waitUs/1000));
+    }
+}
+
+void CameraHandler::deliverEvents(sDVSEvent *events, size_t cnt)
+{
+    for(IEventFilter* filter:m_eventFilters)
+        cnt = filter->filterEvents(events,cnt);
+
+    if(m_eventReciever != nullptr && cnt > 0) {
+        m_eventReciever->newEvents(events,cnt);
+    }
+}
+
+void CameraHandler::processPacket(caerEventPacketHeaderConst packetHeader, int32_t begin, int32_t end)
+{
+    // DVS-Events
+    if (packetHeader->eventType == POLARITY_EVENT) {
+        caerPolarityEventPacketConst polarity = (caerPolarityEventPacketConst) packetHeader;
+        if(m_eventBatch.size() < (size_t)(end - begin))
+            m_eventBatch.resize(end - begin);
+
+        // Decode the whole packet at once, invalid events are skipped
+        size_t evCnt = decodePolarityRange(polarity,begin,end,m_eventBatch.data());
+        // Deliver the whole packet at once
+        deliverEvents(m_eventBatch.data(),evCnt);
+
+    }
+}
+
+void CameraHandler::deliverFramePacket(std::shared_ptr<caer_event_packet_header> packet)
+{
+    caerFrameEventPacket framePacket = (caerFrameEventPacket) packet.get();
+    for(int32_t i = 0; i < packet->eventNumber; i++) {
+        caerFrameEvent frame = caerFrameEventPacketGetEvent(framePacket,i);
+        if(!caerFrameEventIsValid(frame))
+            continue;
+        // Shares the ownership of the packet
+        m_frameReciever->newFrame(tFrameRef(packet,frame));
+    }
+}
 void CameraHandler::writeConfig()
 {
     QMutexLocker locker(&m_camLock);
@@ -2,16 +2,27 @@
 #define CAMERAHANDLER_H
 
 #include <atomic>
+#include <memory>
+#include <vector>
 
 #include <QMutexLocker>
 #include <QMutex>
+#include <QWaitCondition>
 #include <QThread>
 #include <QFuture>
+#include <QElapsedTimer>
 
 #include <libcaer/devices/davis.h>
 #include <libcaer/devices/playback.h>
 
 #include "datatypes.h"
+#include "eventsource.h"
+#include "recordingtee.h"
+
+/**
+ * Reference to a frame that keeps its packet alive until the last receiver releases it.
+ **/
+typedef std::shared_ptr<struct caer_frame_event> tFrameRef;
 
 class CameraHandler
 {
@@ -20,26 +31,101 @@ public:
     ~CameraHandler();
 
     bool connect(QString file, void (*playbackFinishedCallback) (void*), void* param);
-    bool connect(int devId = 1);
+    /**
+     * @brief connect Opens a live camera.
+     * @param devId ID of the device handle
+     * @param serial Serial number of the camera, empty for the first free camera
+     * @return
+     */
+    bool connect(int devId = 1, QString serial = QString());
     void disconnect();
     void startStreaming();
     void stopStreaming();
 
     QVector2D getFrameSize();
+    /**
+     * @brief getSerialNumber Returns the serial number of a connected live camera.
+     * @return Empty for recordings or if not connected
+     */
+    QString getSerialNumber();
 
     void writeConfig();
 
     void run();
 
+    /**
+     * @brief setPlaybackRange Restricts the playback of the next connected file.
+     * Only supported for files that are read through an EventSource.
+     * @param fromUs Start time relative to the beginning of the recording
+     * @param toUs End time relative to the beginning of the recording, 0 for the end
+     */
+    void setPlaybackRange(int64_t fromUs, int64_t toUs)
+    {
+        m_playbackRangeFromUs = fromUs;
+        m_playbackRangeToUs = toUs;
+    }
+
+    /**
+     * @brief setRecording Enables the recording of the raw packets of the next live stream.
+     * @param baseName Base name of the files, see RecordingTee, empty to disable the recording
+     * @param format
+     * @param maxFileBytes Size at which a new file is started, 0 for a single file
+     */
+    void setRecording(QString baseName, tRecordingFormat format, qint64 maxFileBytes)
+    {
+        m_recordFile = baseName;
+        m_recordFormat = format;
+        m_recordMaxFileBytes = maxFileBytes;
+    }
+    const RecordingTee &getRecordingTee() const
+    {
+        return m_recordingTee;
+    }
+
     class IDVSEventReciever
     {
     public:
-        virtual void newEvent(const sDVSEventDepacked & event)= 0;
+        virtual void newEvent(const sDVSEvent & event)= 0;
+        /**
+         * @brief newEvents Receives all events of a packet at once, ordered from old to new.
+         * The default implementation forwards each event to newEvent.
+         * @param events
+         * @param cnt
+         */
+        virtual void newEvents(const sDVSEvent* events, size_t cnt)
+        {
+            for(size_t i = 0; i < cnt; i++)
+                newEvent(events[i]);
+        }
     };
     class IFrameReciever
     {
     public:
-        virtual void newFrame(const caerFrameEvent &)= 0;
+        /**
+         * @brief newFrame Receives a reference to the latest frame without copying its pixels.
+         */
+        virtual void newFrame(const tFrameRef &)= 0;
+        /**
+         * @brief wantsFrames Returns false if frames are currently not needed.
+         * Frame packets are skipped at decode time in this case.
+         * @return
+         */
+        virtual bool wantsFrames()
+        {
+            return true;
+        }
+    };
+    class IEventFilter
+    {
+    public:
+        /**
+         * @brief filterEvents Removes events from a decoded packet before it is delivered.
+         * The remaining events are moved to the front, keeping their order.
+         * @param events
+         * @param cnt
+         * @return Number of remaining events
+         */
+        virtual size_t filterEvents(sDVSEvent* events, size_t cnt)= 0;
     };
 
     void setDVSEventReciever(IDVSEventReciever* reciever)
@@ -52,6 +138,16 @@ public:
         m_frameReciever = reciever;
     }
 
+    /**
+     * @brief addEventFilter Appends a filter, which is applied to each event packet
+     * on the camera thread. Filters must not be added while streaming.
+     * @param filter
+     */
+    void addEventFilter(IEventFilter* filter)
+    {
+        m_eventFilters.push_back(filter);
+    }
+
     bool isStreaming()
     {
         return m_isStreaming;
@@ -64,6 +160,7 @@ public:
     void changePlaybackSpeed(float speed)
     {
         //QMutexLocker locker(&m_camLock);
+        m_playbackSpeed = speed;
         if(m_playbackHandle != NULL)
             playbackChangeSpeed(m_playbackHandle,speed);
 
@@ -72,15 +169,78 @@ public:
     void (*playbackFinishedCallback) (void*);
     void* callbackParam;
 protected:
+    /**
+     * @brief playSource Streams the events and frames of the opened event source
+     * in the playback range with the selected playback speed.
+     */
+    void playSource();
+    /**
+     * @brief deliverSourceFrames Delivers all frames of the event source up to ts.
+     * @param ts
+     */
+    void deliverSourceFrames(int64_t ts);
+    /**
+     * @brief waitForPlaybackTime Blocks until data with the provided timestamp is due.
+     * The reference time is reset on the first call and when the playback speed changes.
+     * @param ts
+     */
+    void waitForPlaybackTime(int64_t ts);
+    /**
+     * @brief deliverEvents Applies the event filters and passes the remaining events to the receiver.
+     * @param events
+     * @param cnt
+     */
+    void deliverEvents(sDVSEvent* events, size_t cnt);
+    /**
+     * @brief processPacket Decodes, filters and delivers the events with index begin to end-1.
+     * @param packetHeader
+     * @param begin
+     * @param end
+     */
+    void processPacket(caerEventPacketHeaderConst packetHeader, int32_t begin, int32_t end);
+    /**
+     * @brief deliverFramePacket Passes references to the valid frames of a packet to the receiver.
+     * @param packet Frame packet, freed when the last frame reference is released
+     */
+    void deliverFramePacket(std::shared_ptr<struct caer_event_packet_header> packet);
+    bool wantsFrames()
+    {
+        return m_frameReciever != nullptr && m_frameReciever->wantsFrames();
+    }
+
     caerDeviceHandle m_davisHandle;
     playbackHandle m_playbackHandle;
+    // Reader of recordings that are not played through libcaer
+    EventSource* m_source;
     std::atomic_bool m_isStreaming;
     std::atomic_bool m_isConnected;
     QMutex m_camLock;
     QFuture<void> m_future;
+    // Idle wait of the streaming thread, interrupted by stopStreaming
+    QMutex m_idleMutex;
+    QWaitCondition m_idleCondition;
 
     IDVSEventReciever* m_eventReciever;
     IFrameReciever* m_frameReciever;
+    // Applied in order to each decoded event packet
+    std::vector<IEventFilter*> m_eventFilters;
+    std::atomic<float> m_playbackSpeed;
+    // Pacing reference of the file playback
+    QElapsedTimer m_playbackTimer;
+    float m_playbackRefSpeed;
+    int64_t m_playbackRefTs;
+    // Absolute playback range of the opened file
+    int64_t m_playbackFrom, m_playbackTo;
+    // Requested playback range relative to the beginning of a recording
+    int64_t m_playbackRangeFromUs, m_playbackRangeToUs;
+    // Copies the packets of the live stream to disk
+    RecordingTee m_recordingTee;
+    QString m_recordFile;
+    tRecordingFormat m_recordFormat;
+    qint64 m_recordMaxFileBytes;
+    // Decoded events of the current polarity packet or source chunk
+    std::vector<sDVSEvent> m_eventBatch;
+    std::vector<int64_t> m_eventBatchTs;
 
     int32_t currTs;
 
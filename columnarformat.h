@@ -0,0 +1,54 @@
+#ifndef COLUMNARFORMAT_H
+#define COLUMNARFORMAT_H
+
+#include <inttypes.h>
+
+/**
+ * Layout of the columnar event format (.evc), all values little endian:
+ * - sColumnarHeader
+ * - Event blocks and frames, each compressed with qCompress
+ * - Block table (sColumnarBlock[blockCnt]) and frame table (sColumnarFrame[frameCnt])
+ *
+ * An uncompressed event block holds the packed addresses (uint32 per event, see sDVSEvent)
+ * followed by the timestamps as zigzag and varint encoded differences to the previous
+ * event, starting at the first timestamp of the block.
+ * A frame holds sx*sy 16 bit pixels.
+ */
+
+#define COLUMNAR_MAGIC 0x31435645
+#define COLUMNAR_VERSION 1
+// File extension of the columnar format
+#define COLUMNAR_FILE_SUFFIX ".evc"
+
+typedef struct sColumnarHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint16_t sx, sy;
+    uint32_t blockCnt;
+    uint32_t frameCnt;
+    uint32_t reserved;
+    uint64_t eventCnt;
+    uint64_t blockTableOffset;
+    uint64_t frameTableOffset;
+} sColumnarHeader;
+
+typedef struct sColumnarBlock {
+    // File offset and compressed size of the block
+    uint64_t offset;
+    uint32_t size;
+    uint32_t eventCnt;
+    // Timestamps of the first and last event in us
+    int64_t firstTs;
+    int64_t lastTs;
+} sColumnarBlock;
+
+typedef struct sColumnarFrame {
+    // File offset and compressed size of the frame
+    uint64_t offset;
+    uint32_t size;
+    uint16_t sx, sy;
+    // Frame timestamp in us
+    int64_t ts;
+} sColumnarFrame;
+
+#endif // COLUMNARFORMAT_H
@@ -0,0 +1,217 @@
+#include "columnarreader.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "settings.h"
+
+ColumnarReader::ColumnarReader():
+    m_blockPos(0),
+    m_framePos(0),
+    m_eventPos(0)
+{
+    memset(&m_header,0,sizeof(m_header));
+}
+
+ColumnarReader::~ColumnarReader()
+{
+    close();
+}
+
+bool ColumnarReader::open(QString fileName)
+{
+    close();
+
+    if(!mapFile(fileName))
+        return false;
+    if(m_size < (qint64)sizeof(sColumnarHeader)) {
+        close();
+        return false;
+    }
+
+    memcpy(&m_header,m_data,sizeof(m_header));
+    uint64_t blockTableEnd = m_header.blockTableOffset + (uint64_t)m_header.blockCnt*sizeof(sColumnarBlock);
+    uint64_t frameTableEnd = m_header.frameTableOffset + (uint64_t)m_header.frameCnt*sizeof(sColumnarFrame);
+    if(m_header.magic != COLUMNAR_MAGIC || m_header.version != COLUMNAR_VERSION ||
+            blockTableEnd > (uint64_t)m_size || frameTableEnd > (uint64_t)m_size) {
+        printf("Invalid columnar file %s\n", fileName.toStdString().c_str());
+        close();
+        return false;
+    }
+
+    // The tables are small, copy them to have aligned entries
+    m_blocks.resize(m_header.blockCnt);
+    memcpy(m_blocks.data(),m_data + m_header.blockTableOffset,m_blocks.size()*sizeof(sColumnarBlock));
+    m_frames.resize(m_header.frameCnt);
+    memcpy(m_frames.data(),m_data + m_header.frameTableOffset,m_frames.size()*sizeof(sColumnarFrame));
+    m_sx = m_header.sx;
+    m_sy = m_header.sy;
+
+    int64_t ts = INT64_MAX;
+    if(!m_blocks.empty())
+        ts = m_blocks.front().firstTs;
+    if(!m_frames.empty())
+        ts = std::min(ts,m_frames.front().ts);
+    m_startTs = ts == INT64_MAX ? 0 : ts;
+
+    printf("Columnar file: %dx%d, %" PRIu64 " events, %u frames\n",
+           m_header.sx, m_header.sy, m_header.eventCnt, m_header.frameCnt);
+    setRange(INT64_MIN,INT64_MAX);
+    return true;
+}
+
+void ColumnarReader::close()
+{
+    EventSource::close();
+    memset(&m_header,0,sizeof(m_header));
+    m_blocks.clear();
+    m_frames.clear();
+    m_blockPos = m_framePos = 0;
+    m_blockEvents.clear();
+    m_blockTs.clear();
+    m_eventPos = 0;
+}
+
+void ColumnarReader::setRange(int64_t t0, int64_t t1)
+{
+    m_t0 = t0;
+    m_t1 = t1;
+    // Blocks and frames are ordered by time
+    m_blockPos = std::lower_bound(m_blocks.begin(),m_blocks.end(),t0,
+    [](const sColumnarBlock &b, int64_t ts) {
+        return b.lastTs < ts;
+    }) - m_blocks.begin();
+    m_framePos = std::lower_bound(m_frames.begin(),m_frames.end(),t0,
+    [](const sColumnarFrame &f, int64_t ts) {
+        return f.ts < ts;
+    }) - m_frames.begin();
+    m_blockEvents.clear();
+    m_blockTs.clear();
+    m_eventPos = 0;
+}
+
+size_t ColumnarReader::nextEvents(sDVSEvent *events, int64_t *ts, size_t maxCnt)
+{
+    if(m_eventPos >= m_blockEvents.size()) {
+        m_eventPos = 0;
+        if(nextBlock() == 0)
+            return 0;
+    }
+    size_t n = std::min(maxCnt,m_blockEvents.size() - m_eventPos);
+    memcpy(events,&m_blockEvents[m_eventPos],n*sizeof(sDVSEvent));
+    memcpy(ts,&m_blockTs[m_eventPos],n*sizeof(int64_t));
+    m_eventPos += n;
+    return n;
+}
+
+size_t ColumnarReader::nextBlock()
+{
+    while(m_blockPos < m_blocks.size()) {
+        const sColumnarBlock &b = m_blocks[m_blockPos++];
+        if(b.firstTs > m_t1) {
+            m_blockPos = m_blocks.size();
+            break;
+        }
+
+        size_t cnt = b.eventCnt;
+        // Addresses and at most 10 bytes per varint coded timestamp
+        int64_t rawSz = decompress(b.offset,b.size,cnt*(sizeof(uint32_t) + 10),m_rawBuffer,0);
+        if(rawSz < (int64_t)(cnt*sizeof(uint32_t))) {
+            printf("Skipping corrupt block at offset %" PRIu64 "\n", b.offset);
+            continue;
+        }
+
+        // Keeps the capacity, blocks have at most COLUMNAR_BLOCK_EVENTS events
+        m_blockEvents.resize(cnt);
+        m_blockTs.resize(cnt);
+        const uint8_t* addr = m_rawBuffer.data();
+        const uint8_t* p = addr + cnt*sizeof(uint32_t);
+        const uint8_t* pEnd = addr + rawSz;
+        int64_t currTs = b.firstTs;
+        size_t n = 0;
+        for(size_t i = 0; i < cnt && p < pEnd; i++) {
+            uint64_t v = 0;
+            int shift = 0;
+            while(p < pEnd && (*p & 0x80)) {
+                v |= (uint64_t)(*p++ & 0x7F) << shift;
+                shift += 7;
+            }
+            if(p < pEnd)
+                v |= (uint64_t)(*p++) << shift;
+            currTs += (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+
+            if(currTs < m_t0 || currTs > m_t1)
+                continue;
+            memcpy(&m_blockEvents[n].addr,addr + i*sizeof(uint32_t),sizeof(uint32_t));
+            m_blockEvents[n].ts = (uint32_t)currTs;
+            m_blockTs[n] = currTs;
+            n++;
+        }
+        if(n > 0) {
+            m_blockEvents.resize(n);
+            m_blockTs.resize(n);
+            return n;
+        }
+    }
+    m_blockEvents.clear();
+    m_blockTs.clear();
+    return 0;
+}
+
+bool ColumnarReader::nextFrameTime(int64_t &ts) const
+{
+    if(m_framePos >= m_frames.size() || m_frames[m_framePos].ts > m_t1)
+        return false;
+    ts = m_frames[m_framePos].ts;
+    return true;
+}
+
+void ColumnarReader::skipFrame()
+{
+    int64_t ts;
+    if(nextFrameTime(ts))
+        m_framePos++;
+}
+
+caerFrameEvent ColumnarReader::nextFrame()
+{
+    int64_t ts;
+    while(nextFrameTime(ts)) {
+        const sColumnarFrame &f = m_frames[m_framePos++];
+        size_t pixelSz = (size_t)f.sx*f.sy*sizeof(uint16_t);
+        // The pixels are decompressed behind the frame header
+        if(decompress(f.offset,f.size,pixelSz,m_frameBuffer,sizeof(struct caer_frame_event)) != (int64_t)pixelSz) {
+            printf("Skipping corrupt frame at offset %" PRIu64 "\n", f.offset);
+            continue;
+        }
+
+        // Only the fields used by the frame receivers are set
+        memset(m_frameBuffer.data(),0,sizeof(struct caer_frame_event));
+        caerFrameEvent frame = (caerFrameEvent)m_frameBuffer.data();
+        frame->info = 1 << VALID_MARK_SHIFT;
+        frame->ts_startframe = frame->ts_endframe = (int32_t)(ts & 0x7FFFFFFF);
+        frame->ts_startexposure = frame->ts_endexposure = (int32_t)(ts & 0x7FFFFFFF);
+        frame->lengthX = f.sx;
+        frame->lengthY = f.sy;
+        return frame;
+    }
+    return NULL;
+}
+
+int64_t ColumnarReader::decompress(uint64_t offset, uint64_t size, size_t maxSz, std::vector<uint8_t> &buffer, size_t pos)
+{
+    // qCompress prepends the decompressed size as big endian 32 bit integer
+    if(size < 4 || offset + size > (uint64_t)m_size)
+        return -1;
+    const uchar* src = m_data + offset;
+    uLongf len = ((uLongf)src[0] << 24) | ((uLongf)src[1] << 16) | ((uLongf)src[2] << 8) | src[3];
+    if(len > maxSz)
+        return -1;
+    if(buffer.size() < pos + len)
+        buffer.resize(pos + len);
+    if(uncompress(buffer.data() + pos,&len,src + 4,size - 4) != Z_OK)
+        return -1;
+    return len;
+}
@@ -0,0 +1,72 @@
+#ifndef COLUMNARREADER_H
+#define COLUMNARREADER_H
+
+#include <vector>
+
+#include <QString>
+
+#include <libcaer/events/frame.h>
+
+#include "columnarformat.h"
+#include "eventsource.h"
+
+/**
+ * @brief The ColumnarReader class streams recordings in the columnar format,
+ * see columnarformat.h. The file is memory mapped and decoded block by block
+ * directly into batches of packed events. Frames are decoded on request.
+ */
+class ColumnarReader : public EventSource
+{
+public:
+    ColumnarReader();
+    ~ColumnarReader();
+
+    bool open(QString fileName);
+    void close();
+
+    void setRange(int64_t t0, int64_t t1);
+    size_t nextEvents(sDVSEvent* events, int64_t* ts, size_t maxCnt);
+    bool nextFrameTime(int64_t &ts) const;
+    /**
+     * @brief nextFrame Decodes the next frame. The frame stays valid until the next call.
+     * @return Frame or NULL if there are no more frames
+     */
+    caerFrameEvent nextFrame();
+    void skipFrame();
+
+private:
+    /**
+     * @brief nextBlock Decodes the events of the next block in the range
+     * into the block buffers.
+     * @return Number of events, 0 at the end of the range
+     */
+    size_t nextBlock();
+    /**
+     * @brief decompress Decompresses data written by qCompress into the buffer at pos.
+     * The buffer only grows, so its capacity is reused by later calls.
+     * @param offset Offset of the compressed data in the file
+     * @param size Size of the compressed data
+     * @param maxSz Maximum plausible decompressed size
+     * @param buffer
+     * @param pos
+     * @return Decompressed size, -1 if the data is corrupt
+     */
+    int64_t decompress(uint64_t offset, uint64_t size, size_t maxSz, std::vector<uint8_t> &buffer, size_t pos);
+
+    sColumnarHeader m_header;
+    std::vector<sColumnarBlock> m_blocks;
+    std::vector<sColumnarFrame> m_frames;
+    // Next block and frame
+    uint32_t m_blockPos, m_framePos;
+
+    // Buffers for the decoded block and frame
+    std::vector<sDVSEvent> m_blockEvents;
+    std::vector<int64_t> m_blockTs;
+    // Decompressed block, reused between blocks
+    std::vector<uint8_t> m_rawBuffer;
+    // Next event of the decoded block
+    size_t m_eventPos;
+    std::vector<uint8_t> m_frameBuffer;
+};
+
+#endif // COLUMNARREADER_H
@@ -0,0 +1,175 @@
+#include "columnarwriter.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include <string.h>
+
+#include <libcaer/events/frame.h>
+
+#include "eventsource.h"
+#include "settings.h"
+
+ColumnarWriter::ColumnarWriter():
+    m_ok(false)
+{
+    memset(&m_header,0,sizeof(m_header));
+}
+
+ColumnarWriter::~ColumnarWriter()
+{
+    if(m_file.isOpen())
+        close();
+}
+
+bool ColumnarWriter::open(QString fileName, uint16_t sx, uint16_t sy)
+{
+    m_file.setFileName(fileName);
+    if(!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    memset(&m_header,0,sizeof(m_header));
+    m_header.magic = COLUMNAR_MAGIC;
+    m_header.version = COLUMNAR_VERSION;
+    m_header.sx = sx;
+    m_header.sy = sy;
+    m_blocks.clear();
+    m_frames.clear();
+    m_addr.clear();
+    m_ts.clear();
+    m_addr.reserve(COLUMNAR_BLOCK_EVENTS);
+    m_ts.reserve(COLUMNAR_BLOCK_EVENTS);
+
+    // Rewritten with the final values on close
+    m_ok = true;
+    write(&m_header,sizeof(m_header));
+    return m_ok;
+}
+
+bool ColumnarWriter::close()
+{
+    flushBlock();
+
+    m_header.blockCnt = m_blocks.size();
+    m_header.frameCnt = m_frames.size();
+    m_header.blockTableOffset = m_file.pos();
+    write(m_blocks.data(),m_blocks.size()*sizeof(sColumnarBlock));
+    m_header.frameTableOffset = m_file.pos();
+    write(m_frames.data(),m_frames.size()*sizeof(sColumnarFrame));
+
+    m_ok = m_ok && m_file.seek(0);
+    write(&m_header,sizeof(m_header));
+    m_file.close();
+    return m_ok;
+}
+
+void ColumnarWriter::addEvents(const sDVSEvent *events, size_t cnt, const int64_t *ts)
+{
+    for(size_t i = 0; i < cnt; i++) {
+        m_addr.push_back(events[i].addr);
+        m_ts.push_back(ts[i]);
+        if(m_addr.size() == COLUMNAR_BLOCK_EVENTS)
+            flushBlock();
+    }
+}
+
+void ColumnarWriter::addFrame(const uint16_t *pixels, uint16_t sx, uint16_t sy, int64_t ts)
+{
+    QByteArray data = qCompress((const uchar*)pixels,sx*sy*sizeof(uint16_t),COLUMNAR_COMPRESSION_LEVEL);
+
+    sColumnarFrame f;
+    f.offset = m_file.pos();
+    f.size = data.size();
+    f.sx = sx;
+    f.sy = sy;
+    f.ts = ts;
+    m_frames.push_back(f);
+    write(data.constData(),data.size());
+}
+
+void ColumnarWriter::flushBlock()
+{
+    size_t cnt = m_addr.size();
+    if(cnt == 0)
+        return;
+
+    // Address column, followed by the timestamp column
+    // with at most 10 bytes per varint
+    m_raw.resize(cnt*sizeof(uint32_t) + cnt*10);
+    memcpy(m_raw.data(),m_addr.data(),cnt*sizeof(uint32_t));
+    uint8_t* p = m_raw.data() + cnt*sizeof(uint32_t);
+
+    int64_t prevTs = m_ts[0];
+    for(size_t i = 0; i < cnt; i++) {
+        int64_t d = m_ts[i] - prevTs;
+        prevTs = m_ts[i];
+        uint64_t v = ((uint64_t)d << 1) ^ (uint64_t)(d >> 63);
+        while(v >= 0x80) {
+            *p++ = (uint8_t)(v | 0x80);
+            v >>= 7;
+        }
+        *p++ = (uint8_t)v;
+    }
+    QByteArray data = qCompress(m_raw.data(),p - m_raw.data(),COLUMNAR_COMPRESSION_LEVEL);
+
+    sColumnarBlock b;
+    b.offset = m_file.pos();
+    b.size = data.size();
+    b.eventCnt = cnt;
+    b.firstTs = m_ts.front();
+    b.lastTs = m_ts.back();
+    m_blocks.push_back(b);
+    m_header.eventCnt += cnt;
+    write(data.constData(),data.size());
+
+    m_addr.clear();
+    m_ts.clear();
+}
+
+void ColumnarWriter::write(const void *data, qint64 size)
+{
+    if(size > 0 && m_file.write((const char*)data,size) != size)
+        m_ok = false;
+}
+
+bool ColumnarWriter::convert(QString inFile, QString outFile)
+{
+    EventSource* source = EventSource::create(inFile);
+    if(source == NULL) {
+        printf("Can't read %s, the format is not supported.\n", inFile.toStdString().c_str());
+        return false;
+    }
+    ColumnarWriter writer;
+    if(!writer.open(outFile,source->getWidth(),source->getHeight())) {
+        printf("Can't create %s\n", outFile.toStdString().c_str());
+        delete source;
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<sDVSEvent> events(EVENT_SOURCE_CHUNK);
+    std::vector<int64_t> ts(EVENT_SOURCE_CHUNK);
+    size_t cnt;
+    do {
+        cnt = source->nextEvents(events.data(),ts.data(),events.size());
+        // Frames up to the current events
+        int64_t frameTs;
+        while(source->nextFrameTime(frameTs) && (cnt == 0 || frameTs <= ts[0])) {
+            caerFrameEvent frame = source->nextFrame();
+            if(frame != NULL)
+                writer.addFrame(caerFrameEventGetPixelArrayUnsafe(frame),caerFrameEventGetLengthX(frame),
+                                caerFrameEventGetLengthY(frame),frameTs);
+        }
+        if(cnt > 0)
+            writer.addEvents(events.data(),cnt,ts.data());
+    } while(cnt > 0);
+    delete source;
+
+    bool ok = writer.close();
+    QFile in(inFile), out(outFile);
+    printf("Converted %" PRIu64 " events and %u frames in %lld ms, %lld -> %lld bytes\n",
+           writer.m_header.eventCnt, writer.m_header.frameCnt, timer.elapsed(),
+           in.size(), out.size());
+    return ok;
+}
@@ -0,0 +1,93 @@
+#ifndef COLUMNARWRITER_H
+#define COLUMNARWRITER_H
+
+#include <vector>
+
+#include <QFile>
+#include <QString>
+
+#include "columnarformat.h"
+#include "datatypes.h"
+
+/**
+ * @brief The ColumnarWriter class writes events and frames in the compact
+ * columnar format, see columnarformat.h. Events are collected in blocks,
+ * which are delta encoded and compressed when they are full.
+ */
+class ColumnarWriter
+{
+public:
+    ColumnarWriter();
+    ~ColumnarWriter();
+
+    /**
+     * @brief open Creates the file and writes a preliminary header.
+     * @param fileName
+     * @param sx
+     * @param sy
+     * @return
+     */
+    bool open(QString fileName, uint16_t sx, uint16_t sy);
+    /**
+     * @brief close Writes the remaining events and the tables and closes the file.
+     * @return False if any write failed
+     */
+    bool close();
+    bool isOpen() const
+    {
+        return m_file.isOpen();
+    }
+    /**
+     * @brief getFileSize Returns the number of bytes written so far.
+     * @return
+     */
+    qint64 getFileSize() const
+    {
+        return m_file.pos();
+    }
+
+    /**
+     * @brief addEvents Appends events, ordered from old to new.
+     * @param events
+     * @param cnt
+     * @param ts Full 64 bit timestamps of the events
+     */
+    void addEvents(const sDVSEvent* events, size_t cnt, const int64_t* ts);
+    /**
+     * @brief addFrame Appends a frame.
+     * @param pixels
+     * @param sx
+     * @param sy
+     * @param ts
+     */
+    void addFrame(const uint16_t* pixels, uint16_t sx, uint16_t sy, int64_t ts);
+
+    /**
+     * @brief convert Converts a recording in any format supported by EventSource into the columnar format.
+     * @param inFile
+     * @param outFile
+     * @return
+     */
+    static bool convert(QString inFile, QString outFile);
+
+private:
+    /**
+     * @brief flushBlock Encodes, compresses and writes the current block.
+     */
+    void flushBlock();
+    void write(const void* data, qint64 size);
+
+    QFile m_file;
+    bool m_ok;
+    sColumnarHeader m_header;
+    std::vector<sColumnarBlock> m_blocks;
+    std::vector<sColumnarFrame> m_frames;
+
+    // Events of the current block
+    std::vector<uint32_t> m_addr;
+    std::vector<int64_t> m_ts;
+    // Encoding buffer
+    std::vector<uint8_t> m_raw;
+};
+
+#endif // COLUMNARWRITER_H
@@ -0,0 +1,116 @@
+#include "componentlabeler.h"
+
+#include <algorithm>
+#include <cstring>
+
+ComponentLabeler::ComponentLabeler()
+{
+
+}
+
+const std::vector<ComponentLabeler::sComponent> &ComponentLabeler::label(const cv::Mat &mask)
+{
+    m_runs.clear();
+    m_parent.clear();
+    m_components.clear();
+
+    // Runs of the previous row
+    size_t prevBegin = 0, prevEnd = 0;
+    for(int y = 0; y < mask.rows; y++) {
+        const uchar* row = mask.ptr(y);
+        size_t rowBegin = m_runs.size();
+        size_t prev = prevBegin;
+
+        int x = 0;
+        while(x < mask.cols) {
+            // Skip empty blocks
+            if(x + 8 <= mask.cols) {
+                uint64_t block;
+                memcpy(&block,row + x,8);
+                if(block == 0) {
+                    x += 8;
+                    continue;
+                }
+            }
+            if(!row[x]) {
+                x++;
+                continue;
+            }
+            sRun run;
+            run.x0 = x;
+            while(x < mask.cols && row[x])
+                x++;
+            run.x1 = x - 1;
+            run.y = y;
+
+            int idx = m_runs.size();
+            m_runs.push_back(run);
+            m_parent.push_back(idx);
+
+            // Runs of the previous row are sorted, skip those left of the run
+            // and merge with all runs that overlap the run or touch it diagonally.
+            // The last merged run can also touch the next run of this row.
+            while(prev < prevEnd && m_runs[prev].x1 < run.x0 - 1)
+                prev++;
+            for(size_t p = prev; p < prevEnd && m_runs[p].x0 <= run.x1 + 1; p++)
+                unite(idx,p);
+        }
+        prevBegin = rowBegin;
+        prevEnd = m_runs.size();
+    }
+
+    // Accumulate the run statistics per root,
+    // roots are the first runs of their components
+    m_componentIdx.assign(m_runs.size(),-1);
+    for(size_t i = 0; i < m_runs.size(); i++) {
+        int root = find(i);
+        if(m_componentIdx[root] < 0) {
+            m_componentIdx[root] = m_components.size();
+            sComponent c;
+            c.bbox = cv::Rect(m_runs[i].x0,m_runs[i].y,0,0);
+            c.moments = sMoments();
+            m_components.push_back(c);
+        }
+        const sRun &r = m_runs[i];
+        sComponent &c = m_components[m_componentIdx[root]];
+        int64_t n = r.x1 - r.x0 + 1;
+        // Sums over x0..x1 in closed form
+        int64_t sx = (int64_t)r.x1*(r.x1 + 1)/2 - (int64_t)(r.x0 - 1)*r.x0/2;
+        int64_t sxx = (int64_t)r.x1*(r.x1 + 1)*(2*r.x1 + 1)/6 - (int64_t)(r.x0 - 1)*r.x0*(2*r.x0 - 1)/6;
+        c.moments.n += n;
+        c.moments.x += sx;
+        c.moments.y += n*r.y;
+        c.moments.xx += sxx;
+        c.moments.yy += n*r.y*r.y;
+
+        // Grow the bbox, the root run is the topmost one
+        int bx0 = std::min(c.bbox.x,r.x0);
+        int bx1 = std::max(c.bbox.x + c.bbox.width,r.x1 + 1);
+        int by1 = std::max(c.bbox.y + c.bbox.height,r.y + 1);
+        c.bbox = cv::Rect(bx0,c.bbox.y,bx1 - bx0,by1 - c.bbox.y);
+    }
+    return m_components;
+}
+
+int ComponentLabeler::find(int run)
+{
+    int root = run;
+    while(m_parent[root] != root)
+        root = m_parent[root];
+    while(m_parent[run] != root) {
+        int next = m_parent[run];
+        m_parent[run] = root;
+        run = next;
+    }
+    return root;
+}
+
+void ComponentLabeler::unite(int a, int b)
+{
+    a = find(a);
+    b = find(b);
+    if(a < b)
+        m_parent[b] = a;
+    else if(b < a)
+        m_parent[a] = b;
+}
@@ -0,0 +1,69 @@
+#ifndef COMPONENTLABELER_H
+#define COMPONENTLABELER_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "summedareatable.h"
+
+/**
+ * @brief The ComponentLabeler class finds the 8-connected components of a binary mask
+ * in a single pass over the image. Each row is split into runs of non zero pixels,
+ * runs touching a run of the previous row are merged with a union find structure.
+ * The statistics of each component are accumulated per run, so the cost depends
+ * on the number of runs and not on the shape of the components.
+ */
+class ComponentLabeler
+{
+public:
+    /**
+     * Statistics of a connected component.
+     **/
+    typedef struct sComponent {
+        cv::Rect bbox;
+        // Moments of the pixel coordinates, n is the number of pixels
+        sMoments moments;
+    } sComponent;
+
+    ComponentLabeler();
+
+    /**
+     * @brief label Finds all components of the non zero pixels in the mask.
+     * The mask is not modified and may be a region of a larger image.
+     * @param mask 8 bit single channel image
+     * @return Components in the order of their topmost, leftmost run
+     */
+    const std::vector<sComponent> &label(const cv::Mat &mask);
+
+    const std::vector<sComponent> &getComponents() const
+    {
+        return m_components;
+    }
+
+private:
+    typedef struct sRun {
+        // First and last pixel of the run
+        int x0, x1;
+        int y;
+    } sRun;
+
+    /**
+     * @brief find Returns the root of the run and compresses the path.
+     */
+    int find(int run);
+    /**
+     * @brief unite Merges the sets of two runs, the smaller root becomes the new root.
+     */
+    void unite(int a, int b);
+
+    std::vector<sRun> m_runs;
+    // Union find parent of each run
+    std::vector<int> m_parent;
+    // Component index of each root run
+    std::vector<int> m_componentIdx;
+    std::vector<sComponent> m_components;
+};
+
+#endif // COMPONENTLABELER_H
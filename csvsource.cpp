@@ -0,0 +1,180 @@
+#include "csvsource.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include "settings.h"
+
+// Maximum number of columns per line, further columns are ignored
+#define CSV_MAX_COLUMNS 8
+
+static inline bool isSeparator(char c)
+{
+    return c == ',' || c == ';' || c == ' ' || c == '\t' || c == '\r';
+}
+
+CsvSource::CsvSource():
+    m_dataOffset(0),
+    m_pos(0)
+{
+    for(int i = 0; i < COL_CNT; i++)
+        m_columns[i] = i;
+}
+
+CsvSource::~CsvSource()
+{
+    close();
+}
+
+bool CsvSource::open(QString fileName)
+{
+    close();
+    if(!mapFile(fileName))
+        return false;
+
+    // Skip comments and the optional header line in front of the first event
+    const char* text = (const char*)m_data;
+    qint64 pos = 0;
+    while(pos < m_size) {
+        const char* line = text + pos;
+        const char* eol = (const char*)memchr(line,'\n',m_size - pos);
+        if(eol == NULL)
+            eol = text + m_size;
+        int64_t t;
+        int x, y;
+        bool pol;
+        if(parseLine(line,eol,t,x,y,pol))
+            break;
+        if(line < eol && *line != '#')
+            parseColumns(line,eol);
+        pos = eol - text + 1;
+    }
+    m_dataOffset = qMin(pos,m_size);
+
+    if(!probeStream()) {
+        printf("No events in %s\n", fileName.toStdString().c_str());
+        close();
+        return false;
+    }
+    printf("CSV file: %dx%d\n", m_sx, m_sy);
+    return true;
+}
+
+void CsvSource::close()
+{
+    EventSource::close();
+    m_dataOffset = m_pos = 0;
+    for(int i = 0; i < COL_CNT; i++)
+        m_columns[i] = i;
+}
+
+void CsvSource::setRange(int64_t t0, int64_t t1)
+{
+    // There is no index, the file is parsed from the beginning
+    m_t0 = t0;
+    m_t1 = t1;
+    m_pos = m_dataOffset;
+}
+
+size_t CsvSource::nextEvents(sDVSEvent *events, int64_t *ts, size_t maxCnt)
+{
+    const char* text = (const char*)m_data;
+    size_t n = 0;
+    while(n < maxCnt && m_pos < m_size) {
+        const char* line = text + m_pos;
+        const char* eol = (const char*)memchr(line,'\n',m_size - m_pos);
+        if(eol == NULL)
+            eol = text + m_size;
+        m_pos = eol - text + 1;
+
+        int64_t t;
+        int x, y;
+        bool pol;
+        if(!parseLine(line,eol,t,x,y,pol) || x < 0 || y < 0 || x > DVS_EVENT_X_MASK || y > DVS_EVENT_Y_MASK)
+            continue;
+        if(!pushEvent(x,y,pol,t,events,ts,n)) {
+            m_pos = m_size;
+            break;
+        }
+    }
+    return n;
+}
+
+void CsvSource::parseColumns(const char *begin, const char *end)
+{
+    int columns[COL_CNT] = {-1,-1,-1,-1};
+    int idx = 0;
+    const char* p = begin;
+    while(p < end && idx < CSV_MAX_COLUMNS) {
+        while(p < end && isSeparator(*p))
+            p++;
+        const char* start = p;
+        while(p < end && !isSeparator(*p))
+            p++;
+        if(p == start)
+            break;
+
+        QString name = QString::fromLatin1(start,p - start).toLower();
+        if(name == "t" || name == "ts" || name == "time" || name == "timestamp")
+            columns[COL_T] = idx;
+        else if(name == "x")
+            columns[COL_X] = idx;
+        else if(name == "y")
+            columns[COL_Y] = idx;
+        else if(name == "p" || name == "pol" || name == "polarity")
+            columns[COL_P] = idx;
+        idx++;
+    }
+    // Keep the default order unless all columns are named
+    for(int i = 0; i < COL_CNT; i++) {
+        if(columns[i] < 0)
+            return;
+    }
+    memcpy(m_columns,columns,sizeof(m_columns));
+}
+
+bool CsvSource::parseLine(const char *p, const char *end, int64_t &t, int &x, int &y, bool &pol) const
+{
+    // Integer and fractional part (in us) of each column
+    int64_t intPart[CSV_MAX_COLUMNS];
+    int64_t fracUs[CSV_MAX_COLUMNS];
+    bool hasPoint[CSV_MAX_COLUMNS];
+    int needed = 1 + std::max(std::max(m_columns[COL_T],m_columns[COL_X]),std::max(m_columns[COL_Y],m_columns[COL_P]));
+
+    for(int i = 0; i < needed; i++) {
+        while(p < end && isSeparator(*p))
+            p++;
+        bool negative = p < end && *p == '-';
+        if(p < end && (*p == '-' || *p == '+'))
+            p++;
+
+        int64_t v = 0, frac = 0;
+        int digits = 0;
+        while(p < end && *p >= '0' && *p <= '9') {
+            v = 10*v + (*p++ - '0');
+            digits++;
+        }
+        hasPoint[i] = p < end && *p == '.';
+        if(hasPoint[i]) {
+            p++;
+            int64_t scale = 100000;
+            while(p < end && *p >= '0' && *p <= '9') {
+                frac += scale*(*p++ - '0');
+                scale /= 10;
+                digits++;
+            }
+        }
+        if(digits == 0 || (p < end && !isSeparator(*p)))
+            return false;
+        intPart[i] = negative ? -v : v;
+        fracUs[i] = negative ? -frac : frac;
+    }
+
+    int c = m_columns[COL_T];
+    t = hasPoint[c] ? intPart[c]*1000000 + fracUs[c] : intPart[c];
+    x = intPart[m_columns[COL_X]];
+    y = intPart[m_columns[COL_Y]];
+    c = m_columns[COL_P];
+    pol = intPart[c] > 0 || fracUs[c] > 0;
+    return true;
+}
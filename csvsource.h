@@ -0,0 +1,57 @@
+#ifndef CSVSOURCE_H
+#define CSVSOURCE_H
+
+#include <inttypes.h>
+
+#include <QString>
+
+#include "eventsource.h"
+
+/**
+ * @brief The CsvSource class streams events from text files with one event per line.
+ * The columns are separated by commas, semicolons, spaces or tabs and are
+ * ordered "t,x,y,p" unless a header line names them (t/ts/timestamp, x, y, p/pol/polarity).
+ * Integer timestamps are in us, timestamps with a decimal point in seconds.
+ * Polarities above zero are ON events. Lines starting with '#' are ignored.
+ * The sensor size is determined from the events.
+ */
+class CsvSource : public EventSource
+{
+public:
+    CsvSource();
+    ~CsvSource();
+
+    bool open(QString fileName);
+    void close();
+
+    void setRange(int64_t t0, int64_t t1);
+    size_t nextEvents(sDVSEvent* events, int64_t* ts, size_t maxCnt);
+
+private:
+    typedef enum tColumn {COL_T, COL_X, COL_Y, COL_P, COL_CNT} tColumn;
+
+    /**
+     * @brief parseColumns Sets the column order from a header line.
+     * @param begin
+     * @param end
+     */
+    void parseColumns(const char* begin, const char* end);
+    /**
+     * @brief parseLine Parses the columns of a data line.
+     * @param p Start of the line
+     * @param end End of the line
+     * @param t Timestamp in us
+     * @param x
+     * @param y
+     * @param pol
+     * @return False if the line is no event, e.g. a comment or a header
+     */
+    bool parseLine(const char* p, const char* end, int64_t &t, int &x, int &y, bool &pol) const;
+
+    // File offsets of the first data line and the next line
+    qint64 m_dataOffset, m_pos;
+    // Index of each column in a line
+    int m_columns[COL_CNT];
+};
+
+#endif // CSVSOURCE_H
@@ -3,11 +3,37 @@
 
 #include <inttypes.h>
 
-typedef struct sDVSEventDepacked {
-    int32_t ts;
-    uint16_t x;
-    uint16_t y;
-    bool pol;
-} sDVSEventDepacked;
+/**
+ * Packed DVS event (8 bytes).
+ * ts holds the lower 32 bits of the 64 bit timestamp in microseconds,
+ * the upper bits are reconstructed by the consumer (see EventBuffer).
+ * addr holds x (bits 0-15), y (bits 16-30) and the polarity (bit 31).
+ */
+typedef struct sDVSEvent {
+    uint32_t ts;
+    uint32_t addr;
+} sDVSEvent;
+
+#define DVS_EVENT_X_MASK 0x0000FFFF
+#define DVS_EVENT_Y_SHIFT 16
+#define DVS_EVENT_Y_MASK 0x00007FFF
+#define DVS_EVENT_POL_SHIFT 31
+
+inline uint32_t dvsEventPackAddr(uint16_t x, uint16_t y, bool pol)
+{
+    return (uint32_t)x | ((uint32_t)y << DVS_EVENT_Y_SHIFT) | ((uint32_t)pol << DVS_EVENT_POL_SHIFT);
+}
+inline uint16_t dvsEventX(uint32_t addr)
+{
+    return addr & DVS_EVENT_X_MASK;
+}
+inline uint16_t dvsEventY(uint32_t addr)
+{
+    return (addr >> DVS_EVENT_Y_SHIFT) & DVS_EVENT_Y_MASK;
+}
+inline bool dvsEventPol(uint32_t addr)
+{
+    return addr >> DVS_EVENT_POL_SHIFT;
+}
 
 #endif // DATATYPES_H
@@ -1,89 +1,284 @@
 #include "eventbuffer.h"
-#include <QMutexLocker>
+
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <algorithm>
 
 #include "settings.h"
 
-EventBuffer::EventBuffer():m_timeWindow(0),m_sx(0),m_sy(0)
+#define EVENT_BUFFER_UNPINNED UINT64_MAX
+
+EventBuffer::Snapshot::Snapshot(const EventBuffer *buffer):
+    m_buffer(buffer),m_slot(-1),m_begin(0),m_end(0),m_currTime(0)
+{
+    // Acquire a free pin slot
+    while(m_slot < 0) {
+        for(int i = 0; i < EVENT_BUFFER_MAX_SNAPSHOTS; i++) {
+            uint64_t expected = EVENT_BUFFER_UNPINNED;
+            // Pin position 0 until the real position is known
+            if(buffer->m_pins[i].compare_exchange_strong(expected,0)) {
+                m_slot = i;
+                break;
+            }
+        }
+        if(m_slot < 0)
+            QThread::yieldCurrentThread();
+    }
+
+    // Pin the oldest published position. The writer publishes a new begin
+    // before it overwrites any memory and checks the pins afterwards.
+    // If it missed our pin, the begin has changed and we retry.
+    uint64_t begin = buffer->m_pubBegin.load();
+    for(;;) {
+        buffer->m_pins[m_slot].store(begin);
+        uint64_t check = buffer->m_pubBegin.load();
+        if(check == begin)
+            break;
+        begin = check;
+    }
+    m_end = buffer->m_pubEnd.load();
+    m_begin = qMin(begin,m_end);
+    if(m_end > m_begin)
+        m_currTime = buffer->m_ts[(m_end-1) % buffer->m_capacity];
+}
+
+EventBuffer::Snapshot::Snapshot(EventBuffer::Snapshot &&other):
+    m_buffer(other.m_buffer),m_slot(other.m_slot),
+    m_begin(other.m_begin),m_end(other.m_end),m_currTime(other.m_currTime)
 {
+    other.m_slot = -1;
+}
+
+EventBuffer::Snapshot::~Snapshot()
+{
+    if(m_slot < 0)
+        return;
+    m_buffer->m_pins[m_slot].store(EVENT_BUFFER_UNPINNED);
+    // The writer sets the flag before it checks the pins under the mutex,
+    // so either it sees the released pin or it is woken up
+    if(m_buffer->m_writerWaiting.load()) {
+        QMutexLocker locker(&m_buffer->m_pinMutex);
+        m_buffer->m_pinReleased.wakeAll();
+    }
+}
+
+int EventBuffer::Snapshot::getSpans(sEventSpan spans[2]) const
+{
+    int cnt = 0;
+    size_t size = m_end - m_begin;
+    size_t cap = m_buffer->m_capacity;
+    if(size == 0)
+        return 0;
+
+    size_t start = m_begin % cap;
+    size_t first = qMin(size, cap - start);
+    spans[cnt].ts = &m_buffer->m_ts[start];
+    spans[cnt].addr = &m_buffer->m_addr[start];
+    spans[cnt].size = first;
+    cnt++;
+    if(size > first) {
+        spans[cnt].ts = &m_buffer->m_ts[0];
+        spans[cnt].addr = &m_buffer->m_addr[0];
+        spans[cnt].size = size - first;
+        cnt++;
+    }
+    return cnt;
+}
+
+EventBuffer::EventBuffer():m_capacity(0),m_begin(0),m_end(0),m_overflowCnt(0),m_droppedCnt(0),
+    m_timeBase(0),m_lastTs(0),
+    m_pubBegin(0),m_pubEnd(0),m_pubCurrTime(0),m_writerWaiting(false),
+    m_activePixelCnt(0),m_timeWindow(0),m_sx(0),m_sy(0)
+{
+    for(int i = 0; i < EVENT_BUFFER_MAX_SNAPSHOTS; i++)
+        m_pins[i].store(EVENT_BUFFER_UNPINNED);
 }
 
 
 void EventBuffer::clear()
 {
-    QMutexLocker locker(&m_lock);
-    m_buffer.clear();
+    m_begin = 0;
+    m_end = 0;
+    m_overflowCnt = 0;
+    m_droppedCnt = 0;
+    m_timeBase = 0;
+    m_lastTs = 0;
+    m_pubBegin.store(0);
+    m_pubEnd.store(0);
+    m_pubCurrTime.store(0);
+    std::fill(m_pixelCount.begin(),m_pixelCount.end(),0);
+    std::fill(m_occupancy.begin(),m_occupancy.end(),0);
+    m_activePixelCnt = 0;
 }
 
 void EventBuffer::setup(const uint32_t timewindow, const uint16_t sx, const uint16_t sy)
 {
-    QMutexLocker locker(&m_lock);
     m_timeWindow = timewindow;
     m_sx = sx;
     m_sy = sy;
-    m_buffer.clear();
+
+    // Preallocate enough memory for the whole time window at the maximum event rate.
+    // The additional headroom allows readers to keep snapshots while the writer continues.
+    m_capacity = qMax((size_t)1,(size_t)((uint64_t)timewindow*EVENT_BUFFER_MAX_EVENT_RATE/1000000));
+    m_capacity *= EVENT_BUFFER_SNAPSHOT_HEADROOM;
+    m_ts.resize(m_capacity);
+    m_addr.resize(m_capacity);
+
+    m_pixelCount.assign(sx*sy,0);
+    m_pixelLastTs.assign(sx*sy,0);
+    m_occupancy.assign(sx*sy,0);
+
+    clear();
 }
 
-void EventBuffer::addEvent(const sDVSEventDepacked &event)
+uint64_t EventBuffer::getMinPinnedPosition() const
 {
-    QMutexLocker locker(&m_lock);
-    // Remove all old events
-    while (m_buffer.size() > 0 &&
-            event.ts - m_buffer.back().ts > m_timeWindow) {
-        m_buffer.pop_back();
-    }
+    uint64_t minPos = EVENT_BUFFER_UNPINNED;
+    for(int i = 0; i < EVENT_BUFFER_MAX_SNAPSHOTS; i++)
+        minPos = qMin(minPos,(uint64_t)m_pins[i].load());
+    return minPos;
+}
 
-    // Add new event
-    m_buffer.push_front(event);
+void EventBuffer::evictOlderThan(uint32_t ts)
+{
+    // The used region consists of at most two contiguous parts.
+    // Find the first event inside the time window
+    // and move the head in a single step.
+    while(m_begin < m_end) {
+        size_t start = m_begin % m_capacity;
+        size_t end = qMin(m_capacity, start + (size_t)(m_end - m_begin));
+        const uint32_t* tsPtr = m_ts.data();
+        size_t i = start;
+        // Timestamp differences modulo 2^32 are valid across overflows
+        while(i < end && ts - tsPtr[i] > m_timeWindow) {
+            removeFromPixel(i);
+            i++;
+        }
+        m_begin += i - start;
+
+        // Stop if the first event in the window was found
+        if(i < end)
+            break;
+    }
+    m_pubBegin.store(m_begin);
 }
-void EventBuffer::addEvents(std::queue<sDVSEventDepacked> & events)
+
+size_t EventBuffer::reserve(size_t cnt)
 {
-    if(events.size() == 0)
-        return;
+    if(m_end + cnt <= m_capacity)
+        return cnt;
 
-    uint32_t newTsStart = events.back().ts;
-    QMutexLocker locker(&m_lock);
+    // All positions before this one are overwritten
+    uint64_t overwritten = m_end + cnt - m_capacity;
+    if(overwritten > m_begin) {
+        // Buffer full: Evict the oldest events
+        if(m_overflowCnt == 0)
+            printf("Event buffer overflow: Increase EVENT_BUFFER_MAX_EVENT_RATE\n");
+        m_overflowCnt += overwritten - m_begin;
+        for(; m_begin < overwritten; m_begin++)
+            removeFromPixel(m_begin % m_capacity);
+        m_pubBegin.store(m_begin);
+    }
 
-    // Remove all old events
-    // Here, we have to lock for the whole period
+    // Wait until no snapshot uses the memory anymore.
+    // This is only possible if a reader keeps its snapshot for a long time.
+    uint64_t pinned = getMinPinnedPosition();
+    if(pinned >= overwritten)
+        return cnt;
+
+    QElapsedTimer timer;
+    timer.start();
+    m_writerWaiting.store(true);
+    {
+        QMutexLocker locker(&m_pinMutex);
+        for(;;) {
+            pinned = getMinPinnedPosition();
+            qint64 remainingMs = EVENT_BUFFER_PIN_WAIT_MS - timer.elapsed();
+            if(pinned >= overwritten || remainingMs <= 0)
+                break;
+            m_pinReleased.wait(&m_pinMutex,remainingMs);
+        }
+    }
+    m_writerWaiting.store(false);
+    if(pinned >= overwritten)
+        return cnt;
 
-    while (m_buffer.size() > 0 &&
-            newTsStart - m_buffer.back().ts > m_timeWindow) {
-        m_buffer.pop_back();
+    // Only fill the memory in front of the snapshot, newer snapshots
+    // can't pin anything older because the begin was published before
+    size_t n = pinned + m_capacity - m_end;
+    if(m_droppedCnt == 0)
+        printf("Event buffer: Snapshot kept too long, dropping new events\n");
+    m_droppedCnt += cnt - n;
+    return n;
+}
+
+void EventBuffer::push(const sDVSEvent &event)
+{
+    size_t idx = m_end % m_capacity;
+    m_ts[idx] = event.ts;
+    m_addr[idx] = event.addr;
+    m_end++;
+
+    size_t p = dvsEventY(event.addr)*m_sx + dvsEventX(event.addr);
+    if(m_pixelCount[p]++ == 0) {
+        m_occupancy[p] = 255;
+        m_activePixelCnt++;
     }
+    m_pixelLastTs[p] = event.ts;
+}
 
+void EventBuffer::addEvent(const sDVSEvent &event)
+{
+    addEvents(&event,1);
+}
 
-    // Add events
-    while(!events.empty()) {
-        const sDVSEventDepacked &ev = events.front();
-        // Don't block for the whole function or other threads are slowed down
+void EventBuffer::addEvents(const sDVSEvent *events, size_t cnt)
+{
+    if(cnt == 0)
+        return;
+
+    // Remove all old events
+    evictOlderThan(events[cnt-1].ts);
+
+    // Add events in parts that fit into the buffer
+    while(cnt > 0) {
+        size_t part = qMin(cnt,m_capacity);
+        size_t n = reserve(part);
+        for(size_t i = 0; i < n; i++) {
+            const sDVSEvent &ev = events[i];
 
-        if(m_buffer.size() > 0 && m_buffer.front().ts > events.front().ts)
-            printf("Time jump: %d to %d\n", m_buffer.front().ts,events.front().ts);
+            if(m_end > 0 && ev.ts < m_lastTs) {
+                // Large backward steps are overflows of the lower timestamp bits
+                if(m_lastTs - ev.ts > 0x80000000u)
+                    m_timeBase += 1ULL << 32;
+                else
+                    printf("Time jump: %u to %u\n", m_lastTs,ev.ts);
+            }
+            m_lastTs = ev.ts;
 
-        {
-            m_buffer.push_front(ev);
+            push(ev);
         }
+        // Events that don't fit in front of a pinned snapshot are dropped
+        events += part;
+        cnt -= part;
 
-        events.pop();
+        // Publish the new events
+        m_pubCurrTime.store(m_timeBase + m_lastTs);
+        m_pubEnd.store(m_end);
     }
 
-    //printf("Buff: %zu\n",m_buffer.size());
+    //printf("Buff: %zu\n",m_end-m_begin);
 }
 
-QImage EventBuffer::toImage()
+sPixelView EventBuffer::getPixelView() const
 {
-    QImage img(m_sx,m_sy,QImage::Format_RGB888);
-
-    img.fill(Qt::white);
-    QMutexLocker locker(&m_lock);
-    // Get current time and color according to temporal distance
-    uint32_t currTime = m_buffer.front().ts;
-
-    for(sDVSEventDepacked e:m_buffer) {
-        uchar c = 255*(currTime-e.ts)/m_timeWindow;
-        *(img.scanLine(e.y) + 3*e.x) = c;
-        *(img.scanLine(e.y) + 3*e.x + 1) = c;
-        *(img.scanLine(e.y) + 3*e.x + 2) = c;
-    }
-    return img;
+    sPixelView view;
+    view.occupancy = m_occupancy.data();
+    view.count = m_pixelCount.data();
+    view.lastTs = m_pixelLastTs.data();
+    view.activeCnt = m_activePixelCnt;
+    view.sx = m_sx;
+    view.sy = m_sy;
+    return view;
 }
@@ -1,25 +1,123 @@
 #ifndef EVENTFIFO_H
 #define EVENTFIFO_H
 
-#include <QMutex>
-#include <QImage>
+#include <atomic>
+#include <vector>
 
-#include <deque>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include <libcaer/events/polarity.h>
 
 #include "datatypes.h"
 
-#include <queue>
+// Maximum number of snapshots that can exist at the same time
+#define EVENT_BUFFER_MAX_SNAPSHOTS 8
+
+/**
+ * Contiguous view on a range of buffered events.
+ * All arrays have the same length and are ordered from old to new.
+ */
+typedef struct sEventSpan {
+    // Lower 32 bits of the timestamps
+    const uint32_t* ts;
+    // Packed addresses, see sDVSEvent
+    const uint32_t* addr;
+    size_t size;
+} sEventSpan;
 
+/**
+ * Read only per pixel view of the buffered events.
+ * All arrays are stored row by row with sx*sy elements.
+ */
+typedef struct sPixelView {
+    // 255 for pixels with at least one event in the buffer, 0 otherwise
+    const uint8_t* occupancy;
+    // Number of buffered events per pixel
+    const uint32_t* count;
+    // Timestamp of the newest buffered event per pixel, only valid if count > 0
+    const uint32_t* lastTs;
+    // Number of pixels with at least one event
+    size_t activeCnt;
+    uint16_t sx,sy;
+} sPixelView;
+
+/**
+ * @brief The EventBuffer class holds all events of a sliding time window.
+ * It has a single writer (the thread calling addEvents) and any number of
+ * readers, which access the events through immutable snapshots
+ * without blocking the writer.
+ */
 class EventBuffer
 {
 public:
+    /**
+     * @brief The Snapshot class is an immutable view on the buffered events
+     * at the time of its creation. The writer never overwrites events
+     * of existing snapshots and drops new events instead if it can't wait
+     * any longer, so keep them only as long as necessary.
+     */
+    class Snapshot
+    {
+    public:
+        Snapshot(Snapshot && other);
+        ~Snapshot();
+
+        /**
+         * @brief getSpans Returns the events of the snapshot
+         * as at most two contiguous spans, ordered from old to new.
+         * @param spans
+         * @return Number of valid spans
+         */
+        int getSpans(sEventSpan spans[2]) const;
+        /**
+         * @brief size Returns the number of events in the snapshot.
+         * @return
+         */
+        size_t size() const
+        {
+            return m_end - m_begin;
+        }
+        /**
+         * @brief getCurrTime Returns the lower 32 bits of the time of the newest event in the snapshot.
+         * Differences to event timestamps have to be computed modulo 2^32.
+         * @return
+         */
+        uint32_t getCurrTime() const
+        {
+            return m_currTime;
+        }
+        /**
+         * @brief getPositions Returns the absolute position of the oldest event and
+         * the position behind the newest event. Positions increase with each added event.
+         * @param begin
+         * @param end
+         */
+        void getPositions(uint64_t &begin, uint64_t &end) const
+        {
+            begin = m_begin;
+            end = m_end;
+        }
+
+    private:
+        friend class EventBuffer;
+        Snapshot(const EventBuffer* buffer);
+        Snapshot(const Snapshot&);
+        Snapshot &operator=(const Snapshot&);
+
+        const EventBuffer* m_buffer;
+        int m_slot;
+        uint64_t m_begin, m_end;
+        uint32_t m_currTime;
+    };
+
     EventBuffer();
 
     /**
     * @brief setup Creates an empty event buffer that
     *        holds all events in the specified timewindow.
+    *        The storage is preallocated for EVENT_BUFFER_MAX_EVENT_RATE.
+    *        Must not be called while snapshots exist or events are added.
     * @param timewindow
     */
     void setup(const uint32_t timewindow, const uint16_t sx, const uint16_t sy);
@@ -29,66 +127,149 @@ public:
      *        buffer and removes all old events
      * @param event
      */
-    void addEvent(const sDVSEventDepacked & event);
-    void addEvents(std::queue<sDVSEventDepacked> &events);
+    void addEvent(const sDVSEvent & event);
+    /**
+     * @brief addEvents Adds a batch of new events, ordered from old to new,
+     *        and removes all events that are outside the time window.
+     *        The upper 32 bits of the timestamps are reconstructed by
+     *        detecting overflows of the lower 32 bits.
+     * @param events
+     * @param cnt
+     */
+    void addEvents(const sDVSEvent* events, size_t cnt);
 
     /**
      * @brief clear removes all events from its memory.
+     * Must not be called while snapshots exist or events are added.
      */
     void clear();
     /**
      * @brief getSize Returns the number of events in the buffer
      * @return
      */
-    int getSize()
+    int getSize() const
     {
-        QMutexLocker locker(&m_lock);
-        return m_buffer.size();
+        uint64_t end = m_pubEnd.load();
+        uint64_t begin = m_pubBegin.load();
+        return begin < end ? end - begin : 0;
     }
     /**
-     * @brief getCurrTime Returns the time of the newest event in the buffer
+     * @brief getCurrTime Returns the full 64 bit time of the newest event in the buffer
      * @return
      */
-    uint32_t getCurrTime()
+    uint64_t getCurrTime() const
+    {
+        return m_pubCurrTime.load();
+    }
+    uint32_t getTimeWindow() const
+    {
+        return m_timeWindow;
+    }
+    uint16_t getWidth() const
     {
-        QMutexLocker locker(&m_lock);
-        if(m_buffer.size() > 0)
-            return m_buffer.front().ts;
-        else
-            return 0;
+        return m_sx;
+    }
+    uint16_t getHeight() const
+    {
+        return m_sy;
     }
     /**
-     * @brief getLockedBuffer Locks and returns the internal deque.
-     * Make sure to release the buffer after acessing the deque!
+     * @brief getSnapshot Returns a consistent view on the current buffer content.
      * @return
      */
-    std::deque<sDVSEventDepacked> &getLockedBuffer()
+    Snapshot getSnapshot() const
     {
-        // Lock the buffer
-        m_lock.lock();
-        return m_buffer;
+        return Snapshot(this);
     }
     /**
-     * @brief releaseLockedBuffer Releases the previously locked buffer.
+     * @brief getPixelView Returns the per pixel event counters and the
+     * occupancy image, which are updated incrementally on insertion and eviction.
+     * The view changes with each added event and must only be used
+     * by the thread that adds events.
+     * @return
+     */
+    sPixelView getPixelView() const;
+
+protected:
+    /**
+     * @brief evictOlderThan Removes all events that are older than
+     * the timewindow relative to the provided timestamp by advancing the head.
+     * @param ts
+     */
+    void evictOlderThan(uint32_t ts);
+    /**
+     * @brief reserve Makes room for cnt new events. Evicts the oldest events
+     * if the buffer is full and waits for snapshots that still use the
+     * memory that gets overwritten. The writer, i.e. the processing thread or
+     * pool worker running the step, sleeps until a snapshot is released, but
+     * at most EVENT_BUFFER_PIN_WAIT_MS. Afterwards only the events that fit
+     * in front of the oldest pinned position are accepted.
+     * @param cnt
+     * @return Number of events that can be pushed, at most cnt
      */
-    void releaseLockedBuffer()
+    size_t reserve(size_t cnt);
+    /**
+     * @brief push Appends a single event to the unpublished part of the buffer.
+     * Requires a prior call to reserve.
+     * @param event
+     */
+    void push(const sDVSEvent & event);
+    /**
+     * @brief removeFromPixel Updates the per pixel data of an evicted event.
+     * @param idx Ring buffer index of the event
+     */
+    void removeFromPixel(size_t idx)
     {
-        m_lock.unlock();
+        uint32_t addr = m_addr[idx];
+        size_t p = dvsEventY(addr)*m_sx + dvsEventX(addr);
+        if(--m_pixelCount[p] == 0) {
+            m_occupancy[p] = 0;
+            m_activePixelCnt--;
+        }
     }
     /**
-     * @brief toImage Converts the current buffer state into a grayscale image.
+     * @brief getMinPinnedPosition Returns the oldest position used by any snapshot.
      * @return
      */
-    QImage toImage();
+    uint64_t getMinPinnedPosition() const;
 
-protected:
-    // Queue used as event buffer
-    // deque provides fast insert and delete operataions.
-    std::deque<sDVSEventDepacked> m_buffer;
+    // Ring buffer used as event buffer, stored as structure of arrays
+    // with lower 32 timestamp bits and packed addresses (8 bytes per event).
+    // Events are addressed by absolute positions, index = position % capacity.
+    std::vector<uint32_t> m_ts;
+    std::vector<uint32_t> m_addr;
+    size_t m_capacity;
+    // Writer state: Position of the oldest event and behind the newest event
+    uint64_t m_begin;
+    uint64_t m_end;
+    // Number of events that were evicted because the buffer was full
+    size_t m_overflowCnt;
+    // Number of new events dropped because a snapshot was kept too long
+    size_t m_droppedCnt;
+    // Upper timestamp bits, advanced on each overflow of the lower 32 bits
+    uint64_t m_timeBase;
+    // Lower 32 bits of the newest timestamp, valid if m_end > 0
+    uint32_t m_lastTs;
+
+    // Published state for readers
+    std::atomic<uint64_t> m_pubBegin;
+    std::atomic<uint64_t> m_pubEnd;
+    std::atomic<uint64_t> m_pubCurrTime;
+    // Oldest position used by each snapshot, UINT64_MAX if unused
+    mutable std::atomic<uint64_t> m_pins[EVENT_BUFFER_MAX_SNAPSHOTS];
+    // Set while the writer waits for a snapshot, released snapshots wake it
+    mutable std::atomic_bool m_writerWaiting;
+    mutable QMutex m_pinMutex;
+    mutable QWaitCondition m_pinReleased;
+
+    // Per pixel data, kept in sync with the ring buffer content
+    std::vector<uint32_t> m_pixelCount;
+    std::vector<uint32_t> m_pixelLastTs;
+    std::vector<uint8_t> m_occupancy;
+    size_t m_activePixelCnt;
 
     uint32_t m_timeWindow;
     uint16_t m_sx,m_sy;
-    QMutex m_lock;
 };
 
 #endif // EVENTFIFO_H
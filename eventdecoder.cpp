@@ -0,0 +1,104 @@
+#include "eventdecoder.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief decodeScalar Decodes a range of events with the libcaer accessors.
+ * @return Number of decoded events
+ */
+static size_t decodeScalar(caerPolarityEventPacketConst packet, int32_t begin, int32_t end, sDVSEvent* out)
+{
+    size_t n = 0;
+    for(int32_t i = begin; i < end; i++) {
+        caerPolarityEventConst ev = &packet->events[i];
+        if(!caerPolarityEventIsValid(ev))
+            continue;
+        out[n].ts = (uint32_t)caerPolarityEventGetTimestamp64(ev, packet);
+        out[n].addr = dvsEventPackAddr(caerPolarityEventGetX(ev),
+                                       caerPolarityEventGetY(ev),
+                                       caerPolarityEventGetPolarity(ev));
+        n++;
+    }
+    return n;
+}
+
+size_t decodePolarityPacket(caerPolarityEventPacketConst packet, sDVSEvent *out)
+{
+    return decodePolarityRange(packet, 0, packet->packetHeader.eventNumber, out);
+}
+
+size_t decodePolarityRange(caerPolarityEventPacketConst packet, int32_t begin, int32_t end, sDVSEvent *out)
+{
+    size_t n = 0;
+    int32_t i = begin;
+
+#ifdef __SSE2__
+    // Raw event words are little endian: data (valid bit 0, polarity bit 1,
+    // y bits 2-16, x bits 17-31) followed by the 31 bit timestamp.
+    // The lower 32 bits of the 64 bit timestamp only need the lowest overflow bit.
+    const __m128i tsHigh = _mm_set1_epi32((uint32_t)packet->packetHeader.eventTSOverflow << TS_OVERFLOW_SHIFT);
+    const __m128i xMask = _mm_set1_epi32(POLARITY_X_ADDR_MASK);
+    const __m128i yMask = _mm_set1_epi32(POLARITY_Y_ADDR_MASK << DVS_EVENT_Y_SHIFT);
+    const __m128i polMask = _mm_set1_epi32(1u << DVS_EVENT_POL_SHIFT);
+    const __m128i validMask = _mm_set1_epi32(VALID_MARK_MASK);
+    const __m128i* in = (const __m128i*)&packet->events[begin];
+
+    // Four events per iteration. If all four are valid, they are written with
+    // two full stores. Otherwise the valid lanes are compacted with scalar
+    // stores, so nothing is written beyond the valid events.
+    for(; i + 4 <= end; i += 4) {
+        __m128i v0 = _mm_loadu_si128(in++); // d0 t0 d1 t1
+        __m128i v1 = _mm_loadu_si128(in++); // d2 t2 d3 t3
+        __m128i a = _mm_shuffle_epi32(v0, _MM_SHUFFLE(3,1,2,0)); // d0 d1 t0 t1
+        __m128i b = _mm_shuffle_epi32(v1, _MM_SHUFFLE(3,1,2,0)); // d2 d3 t2 t3
+        __m128i data = _mm_unpacklo_epi64(a, b);
+        __m128i ts = _mm_or_si128(_mm_unpackhi_epi64(a, b), tsHigh);
+
+        __m128i addr = _mm_and_si128(_mm_srli_epi32(data, POLARITY_X_ADDR_SHIFT), xMask);
+        addr = _mm_or_si128(addr, _mm_and_si128(_mm_slli_epi32(data, DVS_EVENT_Y_SHIFT - POLARITY_Y_ADDR_SHIFT), yMask));
+        addr = _mm_or_si128(addr, _mm_and_si128(_mm_slli_epi32(data, DVS_EVENT_POL_SHIFT - POLARITY_SHIFT), polMask));
+
+        __m128i valid = _mm_cmpeq_epi32(_mm_and_si128(data, validMask), validMask);
+        int validBits = _mm_movemask_ps(_mm_castsi128_ps(valid));
+
+        if(validBits == 0xF) {
+            __m128i* o = (__m128i*)(out + n);
+            _mm_storeu_si128(o, _mm_unpacklo_epi32(ts, addr));
+            _mm_storeu_si128(o + 1, _mm_unpackhi_epi32(ts, addr));
+            n += 4;
+        } else if(validBits != 0) {
+            uint32_t tsArr[4], addrArr[4];
+            _mm_storeu_si128((__m128i*)tsArr, ts);
+            _mm_storeu_si128((__m128i*)addrArr, addr);
+            for(int k = 0; k < 4; k++) {
+                if(validBits & (1 << k)) {
+                    out[n].ts = tsArr[k];
+                    out[n].addr = addrArr[k];
+                    n++;
+                }
+            }
+        }
+    }
+#endif
+
+    // Remaining events
+    n += decodeScalar(packet, i, end, out + n);
+    return n;
+}
+
+void convertFramePixels(const uint16_t *in, uint8_t *out, size_t cnt)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    // 16 pixels per step: Keep the upper byte of each pixel and pack both halves
+    for(; i + 16 <= cnt; i += 16) {
+        __m128i lo = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(in + i)), 8);
+        __m128i hi = _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(in + i + 8)), 8);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for(; i < cnt; i++)
+        out[i] = in[i] >> 8;
+}
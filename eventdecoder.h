@@ -0,0 +1,40 @@
+#ifndef EVENTDECODER_H
+#define EVENTDECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <libcaer/events/polarity.h>
+
+#include "datatypes.h"
+
+/**
+ * @brief decodePolarityPacket Converts all valid events of a libcaer polarity packet
+ * into packed events in a single pass. Invalid events are skipped by their valid mark.
+ * The raw 64 bit event words are decoded with SSE2 shifts and masks if available.
+ * Only the lower 32 bits of the timestamps are kept, see sDVSEvent.
+ * @param packet
+ * @param out Destination array, has to hold at least eventNumber events of the packet
+ * @return Number of decoded events
+ */
+size_t decodePolarityPacket(caerPolarityEventPacketConst packet, sDVSEvent* out);
+/**
+ * @brief decodePolarityRange Same as decodePolarityPacket, but only
+ * for the events with index begin to end-1.
+ * @param packet
+ * @param begin
+ * @param end
+ * @param out Destination array, has to hold at least end-begin events
+ * @return Number of decoded events
+ */
+size_t decodePolarityRange(caerPolarityEventPacketConst packet, int32_t begin, int32_t end, sDVSEvent* out);
+/**
+ * @brief convertFramePixels Converts 16 bit APS pixels to 8 bit by keeping the upper byte,
+ * with SSE2 if available.
+ * @param in
+ * @param out
+ * @param cnt Number of pixels
+ */
+void convertFramePixels(const uint16_t* in, uint8_t* out, size_t cnt);
+
+#endif // EVENTDECODER_H
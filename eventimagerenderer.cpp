@@ -0,0 +1,100 @@
+#include "eventimagerenderer.h"
+
+#include <algorithm>
+
+EventImageRenderer::EventImageRenderer():
+    m_sx(0),m_sy(0),m_timeWindow(0),m_lutScale(0),
+    m_renderedEnd(0),m_renderedTime(0)
+{
+}
+
+void EventImageRenderer::setup(uint16_t sx, uint16_t sy, uint32_t timewindow)
+{
+    m_sx = sx;
+    m_sy = sy;
+    m_timeWindow = qMax(1u,timewindow);
+
+    // Gray value increases linearly with the age of an event
+    for(int i = 0; i < EVENT_RENDERER_LUT_SZ; i++)
+        m_lut[i] = 255*i/EVENT_RENDERER_LUT_SZ;
+    m_lutScale = ((uint64_t)EVENT_RENDERER_LUT_SZ << 32)/m_timeWindow;
+
+    m_img = QImage(sx,sy,QImage::Format_Grayscale8);
+    m_lastTs.assign(sx*sy,0);
+    m_isActive.assign(sx*sy,0);
+    m_activePixels.clear();
+    m_activePixels.reserve(sx*sy);
+    reset();
+}
+
+void EventImageRenderer::reset()
+{
+    m_img.fill(255);
+    std::fill(m_isActive.begin(),m_isActive.end(),0);
+    m_activePixels.clear();
+    m_renderedEnd = 0;
+    m_renderedTime = 0;
+}
+
+const QImage &EventImageRenderer::render(const EventBuffer &buffer)
+{
+    if(buffer.getWidth() != m_sx || buffer.getHeight() != m_sy ||
+            buffer.getTimeWindow() != m_timeWindow)
+        setup(buffer.getWidth(),buffer.getHeight(),buffer.getTimeWindow());
+
+    EventBuffer::Snapshot snapshot = buffer.getSnapshot();
+    uint64_t begin, end;
+    snapshot.getPositions(begin,end);
+
+    // Buffer was cleared: Start from scratch
+    if(end < m_renderedEnd)
+        reset();
+
+    uint32_t currTime = snapshot.getCurrTime();
+    if(end == m_renderedEnd && currTime == m_renderedTime)
+        return m_img;
+
+    // Remember the newest event per pixel for all events since the last frame
+    uint64_t skip = m_renderedEnd > begin ? m_renderedEnd - begin : 0;
+    sEventSpan spans[2];
+    int spanCnt = snapshot.getSpans(spans);
+    for(int s = 0; s < spanCnt; s++) {
+        const sEventSpan &sp = spans[s];
+        if(skip >= sp.size) {
+            skip -= sp.size;
+            continue;
+        }
+        for(size_t i = skip; i < sp.size; i++) {
+            uint32_t p = dvsEventY(sp.addr[i])*m_sx + dvsEventX(sp.addr[i]);
+            m_lastTs[p] = sp.ts[i];
+            if(!m_isActive[p]) {
+                m_isActive[p] = 1;
+                m_activePixels.push_back(p);
+            }
+        }
+        skip = 0;
+    }
+    m_renderedEnd = end;
+    m_renderedTime = currTime;
+
+    // Update all fading pixels, remove pixels that are older than the time window
+    uchar* img = m_img.bits();
+    int bpl = m_img.bytesPerLine();
+    size_t i = 0;
+    while(i < m_activePixels.size()) {
+        uint32_t p = m_activePixels[i];
+        // Modulo 2^32 difference, valid across timestamp overflows
+        uint32_t age = currTime - m_lastTs[p];
+        uchar* px = img + (p/m_sx)*bpl + p%m_sx;
+        if(age >= m_timeWindow) {
+            *px = 255;
+            m_isActive[p] = 0;
+            m_activePixels[i] = m_activePixels.back();
+            m_activePixels.pop_back();
+        } else {
+            *px = m_lut[(age*m_lutScale) >> 32];
+            i++;
+        }
+    }
+    return m_img;
+}
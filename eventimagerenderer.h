@@ -0,0 +1,66 @@
+#ifndef EVENTIMAGERENDERER_H
+#define EVENTIMAGERENDERER_H
+
+#include <QImage>
+
+#include <vector>
+
+#include "eventbuffer.h"
+
+// Number of gray levels in the age lookup table
+#define EVENT_RENDERER_LUT_SZ 256
+
+/**
+ * @brief The EventImageRenderer class renders the content of an event buffer
+ * into a persistent grayscale image. New events are black and fade to white with age.
+ * Each call only processes events added since the previous call and pixels
+ * that are still fading, so a quiet scene costs almost nothing.
+ * The renderer works on snapshots and is meant to be used by a single (GUI) thread.
+ */
+class EventImageRenderer
+{
+public:
+    EventImageRenderer();
+
+    /**
+     * @brief render Updates the image with the current buffer content.
+     * @param buffer
+     * @return The persistent render target
+     */
+    const QImage &render(const EventBuffer &buffer);
+
+    /**
+     * @brief reset Clears the image and forgets all rendered events.
+     */
+    void reset();
+
+private:
+    /**
+     * @brief setup Allocates the render target and the lookup table.
+     * @param sx
+     * @param sy
+     * @param timewindow
+     */
+    void setup(uint16_t sx, uint16_t sy, uint32_t timewindow);
+
+    QImage m_img;
+    uint16_t m_sx,m_sy;
+    uint32_t m_timeWindow;
+
+    // Age to gray value lookup table and scale from age to table index (32.32 fixed point)
+    uchar m_lut[EVENT_RENDERER_LUT_SZ];
+    uint64_t m_lutScale;
+
+    // Timestamp of the newest rendered event per pixel
+    std::vector<uint32_t> m_lastTs;
+    // Pixels that are not white, unordered
+    std::vector<uint32_t> m_activePixels;
+    std::vector<uint8_t> m_isActive;
+
+    // Buffer position behind the last rendered event
+    uint64_t m_renderedEnd;
+    // Time of the last rendered frame
+    uint32_t m_renderedTime;
+};
+
+#endif // EVENTIMAGERENDERER_H
@@ -0,0 +1,135 @@
+#include "eventsource.h"
+
+#include <QByteArray>
+
+#include <algorithm>
+#include <string.h>
+
+#include "settings.h"
+#include "aedatreader.h"
+#include "aedat4source.h"
+#include "columnarreader.h"
+#include "propheseerawsource.h"
+#include "csvsource.h"
+#include "syntheticsource.h"
+
+EventSource::EventSource():
+    m_data(NULL),
+    m_size(0),
+    m_sx(0),
+    m_sy(0),
+    m_startTs(0),
+    m_t0(INT64_MIN),
+    m_t1(INT64_MAX)
+{
+}
+
+EventSource::~EventSource()
+{
+    close();
+}
+
+EventSource* EventSource::create(QString fileName)
+{
+    if(fileName.startsWith(SYNTHETIC_SOURCE_PREFIX)) {
+        EventSource* source = new SyntheticSource();
+        if(!source->open(fileName)) {
+            delete source;
+            source = NULL;
+        }
+        return source;
+    }
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return NULL;
+    QByteArray head = file.read(16);
+    file.close();
+
+    uint32_t magic = 0;
+    if(head.size() >= (int)sizeof(magic))
+        memcpy(&magic,head.constData(),sizeof(magic));
+
+    EventSource* source = NULL;
+    if(head.startsWith("#!AER-DAT3."))
+        source = new AedatReader();
+    else if(head.startsWith("#!AER-DAT4."))
+        source = new Aedat4Source();
+    else if(magic == COLUMNAR_MAGIC)
+        source = new ColumnarReader();
+    else if(head.startsWith("%") || fileName.endsWith(".raw"))
+        source = new PropheseeRawSource();
+    else if(fileName.endsWith(".csv") || fileName.endsWith(".txt"))
+        source = new CsvSource();
+
+    if(source != NULL && !source->open(fileName)) {
+        delete source;
+        source = NULL;
+    }
+    return source;
+}
+
+void EventSource::close()
+{
+    if(m_data != NULL)
+        m_file.unmap((uchar*)m_data);
+    m_data = NULL;
+    if(m_file.isOpen())
+        m_file.close();
+    m_size = 0;
+    m_sx = m_sy = 0;
+    m_startTs = 0;
+    m_t0 = INT64_MIN;
+    m_t1 = INT64_MAX;
+}
+
+bool EventSource::mapFile(QString fileName)
+{
+    m_file.setFileName(fileName);
+    if(!m_file.open(QIODevice::ReadOnly))
+        return false;
+    m_size = m_file.size();
+    m_data = m_size > 0 ? m_file.map(0,m_size) : NULL;
+    if(m_data == NULL) {
+        m_file.close();
+        m_size = 0;
+        return false;
+    }
+    return true;
+}
+
+bool EventSource::probeStream()
+{
+    // Accept all addresses while probing an unknown sensor
+    bool findSize = m_sx == 0 || m_sy == 0;
+    if(findSize) {
+        m_sx = DVS_EVENT_X_MASK;
+        m_sy = DVS_EVENT_Y_MASK;
+    }
+    setRange(INT64_MIN,INT64_MAX);
+
+    const size_t batchSz = 256;
+    sDVSEvent events[batchSz];
+    int64_t ts[batchSz];
+    size_t total = 0, n;
+    int maxX = -1, maxY = -1;
+    while((n = nextEvents(events,ts,batchSz)) > 0) {
+        if(total == 0)
+            m_startTs = ts[0];
+        total += n;
+        if(!findSize)
+            break;
+        for(size_t i = 0; i < n; i++) {
+            maxX = std::max(maxX,(int)dvsEventX(events[i].addr));
+            maxY = std::max(maxY,(int)dvsEventY(events[i].addr));
+        }
+        if(total >= EVENT_SOURCE_SIZE_PROBE_EVENTS)
+            break;
+    }
+    if(findSize) {
+        m_sx = maxX + 1;
+        m_sy = maxY + 1;
+    }
+    setRange(INT64_MIN,INT64_MAX);
+    return total > 0;
+}
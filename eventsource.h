@@ -0,0 +1,140 @@
+#ifndef EVENTSOURCE_H
+#define EVENTSOURCE_H
+
+#include <inttypes.h>
+
+#include <QFile>
+#include <QString>
+
+#include <libcaer/events/frame.h>
+
+#include "datatypes.h"
+
+/**
+ * @brief The EventSource class is the interface of all recording readers.
+ * A source memory maps its file and decodes it in chunks directly into
+ * caller provided batches of packed events, ordered from old to new.
+ * Decoding buffers are reused, so no memory is allocated while streaming
+ * events once they have grown to the largest block of the file.
+ * Use create to open a file with the matching reader.
+ */
+class EventSource
+{
+public:
+    EventSource();
+    virtual ~EventSource();
+
+    /**
+     * @brief create Opens a recording with the reader for its format.
+     * The format is detected from the file content and the suffix.
+     * Names starting with SYNTHETIC_SOURCE_PREFIX open a synthetic scene.
+     * @param fileName
+     * @return Opened source, owned by the caller, or NULL if the format is unsupported
+     */
+    static EventSource* create(QString fileName);
+
+    /**
+     * @brief open Maps the file and parses its header.
+     * @param fileName
+     * @return False if the file can't be opened or has another format
+     */
+    virtual bool open(QString fileName) = 0;
+    virtual void close();
+    virtual bool isOpen() const
+    {
+        return m_data != NULL;
+    }
+
+    uint16_t getWidth() const
+    {
+        return m_sx;
+    }
+    uint16_t getHeight() const
+    {
+        return m_sy;
+    }
+    /**
+     * @brief getStartTime Returns the time of the first event or frame in the recording.
+     * @return
+     */
+    int64_t getStartTime() const
+    {
+        return m_startTs;
+    }
+
+    /**
+     * @brief setRange Restricts the events and frames to [t0,t1] and seeks to t0.
+     * @param t0 Absolute time in us
+     * @param t1 Absolute time in us
+     */
+    virtual void setRange(int64_t t0, int64_t t1) = 0;
+    /**
+     * @brief nextEvents Decodes the next events in the range.
+     * @param events Receives up to maxCnt events
+     * @param ts Receives the full 64 bit timestamps
+     * @param maxCnt
+     * @return Number of events, 0 at the end of the range
+     */
+    virtual size_t nextEvents(sDVSEvent* events, int64_t* ts, size_t maxCnt) = 0;
+    /**
+     * @brief nextFrameTime Returns the timestamp of the next frame in the range.
+     * @param ts
+     * @return False if there are no more frames or the format has no frames
+     */
+    virtual bool nextFrameTime(int64_t &ts) const
+    {
+        Q_UNUSED(ts);
+        return false;
+    }
+    /**
+     * @brief nextFrame Returns the next frame. The frame stays valid
+     * until the next call or until the source is closed.
+     * @return Frame or NULL if there are no more frames
+     */
+    virtual caerFrameEvent nextFrame()
+    {
+        return NULL;
+    }
+    /**
+     * @brief skipFrame Advances to the next frame without decoding the current one.
+     */
+    virtual void skipFrame()
+    {
+        nextFrame();
+    }
+
+protected:
+    bool mapFile(QString fileName);
+    /**
+     * @brief probeStream Determines the start time and, if it is unknown,
+     * the sensor size from the first events. Resets the range afterwards.
+     * @return False if there are no events
+     */
+    bool probeStream();
+    /**
+     * @brief pushEvent Appends an event if it is inside the range and the sensor.
+     * @return False if the event is behind the range
+     */
+    inline bool pushEvent(uint16_t x, uint16_t y, bool pol, int64_t t,
+                          sDVSEvent* events, int64_t* ts, size_t &n) const
+    {
+        if(t > m_t1)
+            return false;
+        if(t >= m_t0 && x < m_sx && y < m_sy) {
+            events[n].ts = (uint32_t)t;
+            events[n].addr = dvsEventPackAddr(x,y,pol);
+            ts[n] = t;
+            n++;
+        }
+        return true;
+    }
+
+    QFile m_file;
+    const uchar* m_data;
+    qint64 m_size;
+    uint16_t m_sx, m_sy;
+    int64_t m_startTs;
+    int64_t m_t0, m_t1;
+};
+
+#endif // EVENTSOURCE_H
@@ -0,0 +1,211 @@
+#include "hotpixelfilter.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+#include "settings.h"
+
+// Identifies mask files, followed by the sensor size, the zero padded
+// serial number of the camera and one byte per pixel
+#define HOT_PIXEL_MASK_MAGIC 0x32585048
+#define HOT_PIXEL_MASK_SERIAL_SZ 16
+
+HotPixelFilter::HotPixelFilter():
+    m_sx(0),
+    m_sy(0),
+    m_saveMask(false),
+    m_initialized(false),
+    m_calibrationStart(0),
+    m_calibrating(false),
+    m_maskPending(false),
+    m_refractory(HOT_PIXEL_REFRACTORY_US),
+    m_hotPixelCnt(0),
+    m_maskedCnt(0),
+    m_refractoryCnt(0)
+{
+}
+
+void HotPixelFilter::setup(uint16_t sx, uint16_t sy, QString serial, QString maskFile, bool saveMask)
+{
+    m_sx = sx;
+    m_sy = sy;
+    m_serial = serial;
+    m_maskFile = maskFile;
+    m_saveMask = saveMask;
+    m_mask.assign(sx*sy,0);
+    m_lastTs.resize(sx*sy);
+    m_initialized = false;
+    m_maskedCnt = 0;
+    m_refractoryCnt = 0;
+    m_maskPending = false;
+
+    if(loadMask()) {
+        m_counts.clear();
+        m_calibrating = false;
+        printf("Loaded hot pixel mask with %zu pixels from %s\n",
+               (size_t)m_hotPixelCnt, m_maskFile.toStdString().c_str());
+    } else {
+        recalibrate();
+    }
+}
+
+void HotPixelFilter::recalibrate()
+{
+    std::fill(m_mask.begin(),m_mask.end(),0);
+    m_counts.assign(m_sx*m_sy,0);
+    m_hotPixelCnt = 0;
+    m_initialized = false;
+    m_calibrating = true;
+}
+
+size_t HotPixelFilter::filterEvents(sDVSEvent *events, size_t cnt)
+{
+    if(cnt == 0 || m_mask.empty())
+        return cnt;
+
+    const uint32_t refractory = m_refractory;
+    if(!m_initialized) {
+        m_calibrationStart = events[0].ts;
+        std::fill(m_lastTs.begin(),m_lastTs.end(),events[0].ts - refractory);
+        m_initialized = true;
+    }
+
+    if(m_calibrating) {
+        // Count all events, including the ones removed by the refractory period
+        for(size_t i = 0; i < cnt; i++) {
+            const uint16_t x = dvsEventX(events[i].addr);
+            const uint16_t y = dvsEventY(events[i].addr);
+            if(x < m_sx && y < m_sy)
+                m_counts[y*m_sx + x]++;
+        }
+        uint32_t duration = events[cnt-1].ts - m_calibrationStart;
+        if(duration >= HOT_PIXEL_CALIBRATION_US)
+            finishCalibration(duration);
+    }
+
+    size_t n = 0;
+    uint64_t masked = 0;
+    for(size_t i = 0; i < cnt; i++) {
+        const uint32_t ts = events[i].ts;
+        const uint16_t x = dvsEventX(events[i].addr);
+        const uint16_t y = dvsEventY(events[i].addr);
+        if(x >= m_sx || y >= m_sy)
+            continue;
+
+        size_t p = y*m_sx + x;
+        if(m_mask[p]) {
+            masked++;
+            continue;
+        }
+        if(ts - m_lastTs[p] < refractory)
+            continue;
+        m_lastTs[p] = ts;
+        events[n++] = events[i];
+    }
+
+    m_maskedCnt += masked;
+    m_refractoryCnt += cnt - n - masked;
+    return n;
+}
+
+void HotPixelFilter::finishCalibration(uint32_t duration)
+{
+    // Statistics of the per pixel counts
+    double sum = 0, sqSum = 0;
+    for(uint32_t c:m_counts) {
+        sum += c;
+        sqSum += (double)c*c;
+    }
+    double mean = sum/m_counts.size();
+    double std = std::sqrt(qMax(0.0,sqSum/m_counts.size() - mean*mean));
+
+    // In static scenes the deviation is small, the minimum rate
+    // prevents masking of pixels with only a few events
+    double threshold = qMax(mean + HOT_PIXEL_THRESHOLD_STD*std,
+                            HOT_PIXEL_MIN_RATE_HZ*duration/1000000.0);
+
+    size_t hotCnt = 0;
+    for(size_t i = 0; i < m_counts.size(); i++) {
+        m_mask[i] = m_counts[i] > threshold;
+        hotCnt += m_mask[i];
+    }
+    m_hotPixelCnt = hotCnt;
+    m_counts.clear();
+    m_calibrating = false;
+    // No file I/O on the camera thread
+    m_maskPending = m_saveMask && !m_maskFile.isEmpty();
+
+    printf("Hot pixel calibration finished: %zu pixels masked (mean %.1f, std %.1f events in %u us)\n",
+           hotCnt, mean, std, duration);
+}
+
+bool HotPixelFilter::saveLearnedMask()
+{
+    if(!m_maskPending.exchange(false))
+        return true;
+    if(!saveMask()) {
+        printf("Can't write hot pixel mask to %s\n", m_maskFile.toStdString().c_str());
+        return false;
+    }
+    printf("Saved hot pixel mask to %s\n", m_maskFile.toStdString().c_str());
+    return true;
+}
+
+bool HotPixelFilter::loadMask()
+{
+    if(m_maskFile.isEmpty())
+        return false;
+
+    QFile file(m_maskFile);
+    if(!file.exists() || !file.open(QIODevice::ReadOnly))
+        return false;
+
+    uint32_t magic = 0;
+    uint16_t sx = 0, sy = 0;
+    char serialBuf[HOT_PIXEL_MASK_SERIAL_SZ + 1] = {0};
+    if(file.read((char*)&magic,sizeof(magic)) != sizeof(magic) ||
+            file.read((char*)&sx,sizeof(sx)) != sizeof(sx) ||
+            file.read((char*)&sy,sizeof(sy)) != sizeof(sy) ||
+            file.read(serialBuf,HOT_PIXEL_MASK_SERIAL_SZ) != HOT_PIXEL_MASK_SERIAL_SZ ||
+            magic != HOT_PIXEL_MASK_MAGIC || sx != m_sx || sy != m_sy) {
+        printf("Ignoring invalid hot pixel mask %s\n", m_maskFile.toStdString().c_str());
+        return false;
+    }
+    // Another unit of the same model has different hot pixels
+    QString serial(serialBuf);
+    if(!m_serial.isEmpty() && serial != m_serial) {
+        printf("Ignoring hot pixel mask %s of camera %s\n",
+               m_maskFile.toStdString().c_str(), serial.toStdString().c_str());
+        return false;
+    }
+    if(file.read((char*)m_mask.data(),m_mask.size()) != (qint64)m_mask.size()) {
+        std::fill(m_mask.begin(),m_mask.end(),0);
+        return false;
+    }
+
+    size_t hotCnt = 0;
+    for(uint8_t m:m_mask)
+        hotCnt += m != 0;
+    m_hotPixelCnt = hotCnt;
+    return true;
+}
+
+bool HotPixelFilter::saveMask()
+{
+    QFile file(m_maskFile);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    uint32_t magic = HOT_PIXEL_MASK_MAGIC;
+    char serialBuf[HOT_PIXEL_MASK_SERIAL_SZ] = {0};
+    std::string serial = m_serial.toStdString();
+    memcpy(serialBuf,serial.c_str(),qMin(serial.size(),(size_t)HOT_PIXEL_MASK_SERIAL_SZ));
+    return file.write((const char*)&magic,sizeof(magic)) == sizeof(magic) &&
+           file.write((const char*)&m_sx,sizeof(m_sx)) == sizeof(m_sx) &&
+           file.write((const char*)&m_sy,sizeof(m_sy)) == sizeof(m_sy) &&
+           file.write(serialBuf,HOT_PIXEL_MASK_SERIAL_SZ) == HOT_PIXEL_MASK_SERIAL_SZ &&
+           file.write((const char*)m_mask.data(),m_mask.size()) == (qint64)m_mask.size();
+}
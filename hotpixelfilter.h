@@ -0,0 +1,133 @@
+#ifndef HOTPIXELFILTER_H
+#define HOTPIXELFILTER_H
+
+#include <atomic>
+#include <vector>
+
+#include <QString>
+
+#include "camerahandler.h"
+#include "datatypes.h"
+
+/**
+ * @brief The HotPixelFilter class removes events of hot pixels and
+ * limits the event rate of all other pixels by a refractory period.
+ * Hot pixels are learned from the firing rates during a calibration period:
+ * Pixels with a count above mean + k*std are masked. The mask of a live camera
+ * is stored in a file and loaded on the next start instead of calibrating again.
+ * Runs on the camera thread.
+ */
+class HotPixelFilter: public CameraHandler::IEventFilter
+{
+public:
+    HotPixelFilter();
+
+    /**
+     * @brief setup Prepares the filter for a sensor. Loads the mask from the file
+     * if it exists and matches the sensor size and serial number, otherwise
+     * a new calibration is started. Must not be called while streaming.
+     * @param sx
+     * @param sy
+     * @param serial Serial number of the camera, stored in the mask. Masks of other
+     * cameras are rejected. Empty for recordings, which accept the mask of any camera.
+     * @param maskFile File for the learned mask, no persistence if empty
+     * @param saveMask Write a learned mask to the file, otherwise the file is only read
+     */
+    void setup(uint16_t sx, uint16_t sy, QString serial, QString maskFile, bool saveMask = true);
+    /**
+     * @brief recalibrate Discards the current mask and learns a new one
+     * from the next events. Must not be called while streaming.
+     */
+    void recalibrate();
+    /**
+     * @brief filterEvents Implements the filter interface of the camera handler.
+     * @param events
+     * @param cnt
+     * @return
+     */
+    size_t filterEvents(sDVSEvent* events, size_t cnt);
+
+    /**
+     * @brief setRefractoryPeriod Sets the minimum time between two events of a pixel,
+     * 0 disables the refractory period. Can be changed while streaming.
+     * @param us
+     */
+    void setRefractoryPeriod(uint32_t us)
+    {
+        m_refractory = us;
+    }
+    /**
+     * @brief isCalibrating Returns true while the firing rates are learned.
+     * @return
+     */
+    bool isCalibrating()
+    {
+        return m_calibrating;
+    }
+    /**
+     * @brief getHotPixelCnt Returns the number of masked pixels.
+     * @return
+     */
+    size_t getHotPixelCnt()
+    {
+        return m_hotPixelCnt;
+    }
+    /**
+     * @brief getMaskedCnt Returns the number of events removed by the mask.
+     * @return
+     */
+    uint64_t getMaskedCnt()
+    {
+        return m_maskedCnt;
+    }
+    /**
+     * @brief saveLearnedMask Writes a mask that was learned since the last call to the file.
+     * The calibration only keeps the mask in memory, so the file is written outside
+     * of the camera thread, e.g. by a periodic poll and after streaming stopped.
+     * @return False if the mask could not be written
+     */
+    bool saveLearnedMask();
+    /**
+     * @brief getRefractoryCnt Returns the number of events removed by the refractory period.
+     * @return
+     */
+    uint64_t getRefractoryCnt()
+    {
+        return m_refractoryCnt;
+    }
+
+private:
+    /**
+     * @brief finishCalibration Computes the mask from the collected counts
+     * and marks it for saveLearnedMask.
+     * @param duration Calibration time in us
+     */
+    void finishCalibration(uint32_t duration);
+    bool loadMask();
+    bool saveMask();
+
+    // Nonzero for masked pixels
+    std::vector<uint8_t> m_mask;
+    // Events per pixel during the calibration
+    std::vector<uint32_t> m_counts;
+    // Time of the last passed event per pixel
+    std::vector<uint32_t> m_lastTs;
+    uint16_t m_sx,m_sy;
+    QString m_serial;
+    QString m_maskFile;
+    bool m_saveMask;
+
+    // True after the first event, timestamps are initialized relative to it
+    bool m_initialized;
+    uint32_t m_calibrationStart;
+    std::atomic_bool m_calibrating;
+    // Set when a learned mask waits to be written, the mask is not changed afterwards
+    std::atomic_bool m_maskPending;
+
+    std::atomic<uint32_t> m_refractory;
+    std::atomic<size_t> m_hotPixelCnt;
+    std::atomic<uint64_t> m_maskedCnt;
+    std::atomic<uint64_t> m_refractoryCnt;
+};
+
+#endif // HOTPIXELFILTER_H
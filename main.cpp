@@ -6,6 +6,7 @@
 
 #include "camerahandler.h"
 #include "processor.h"
+#include "columnarwriter.h"
 
 int main(int argc, char *argv[])
 {
@@ -13,7 +14,7 @@ int main(int argc, char *argv[])
     QApplication a(argc, argv);
 
     QCommandLineParser parser;
-    parser.addPositionalArgument("playback file",".aedat file to be played.");
+    parser.addPositionalArgument("playback files","Recordings to be played in parallel (.aedat, .aedat4, .raw, .csv, .txt or " COLUMNAR_FILE_SUFFIX ").");
 
     QCommandLineOption minimizeOption("min","Minimize application on start.");
     parser.addOption(minimizeOption);
@@ -29,14 +30,74 @@ int main(int argc, char *argv[])
     parser.addOption(fallYCenterThresholdOpt);
     QCommandLineOption unfallYCenterThresholdOpt("unfallY","Lower bound for y coordinate to undo a fall (Y axis points down!)", "unfallY");
     parser.addOption(unfallYCenterThresholdOpt);
+    QCommandLineOption binningOpt("bin","Spatial binning factor (1, 2 or 4) for detection and tracking.", "bin");
+    parser.addOption(binningOpt);
+    QCommandLineOption detectorOpt("detector","Detection engine: dense, timesurface or pyramid.", "detector");
+    parser.addOption(detectorOpt);
+    QCommandLineOption benchDetectOpt("benchDetect","Run the dense or pyramid detector as shadow of the active one and print times and box overlaps on exit.");
+    parser.addOption(benchDetectOpt);
+    QCommandLineOption noiseFilterOpt("noiseDt","Enables the background activity filter with a time window in us, 0 disables the filter.", "noiseDt");
+    parser.addOption(noiseFilterOpt);
+    QCommandLineOption hotPixelMaskOpt("hotPixelMask","File of the learned hot pixel mask for the camera. Recordings only read it if given, otherwise they learn a mask in memory.", "hotPixelMask");
+    parser.addOption(hotPixelMaskOpt);
+    QCommandLineOption recalibrateOpt("recalibrate","Learn a new hot pixel mask on start.");
+    parser.addOption(recalibrateOpt);
+    QCommandLineOption refractoryOpt("refractory","Refractory period per pixel in us, 0 disables it.", "refractory");
+    parser.addOption(refractoryOpt);
+    QCommandLineOption noHotPixelOpt("noHotPixelFilter","Disable the hot pixel and refractory filter.");
+    parser.addOption(noHotPixelOpt);
+    QCommandLineOption fromOpt("from","Start of the playback in seconds after the beginning of the recording.", "from");
+    parser.addOption(fromOpt);
+    QCommandLineOption toOpt("to","End of the playback in seconds after the beginning of the recording.", "to");
+    parser.addOption(toOpt);
+    QCommandLineOption recordOpt("record","Record the live camera stream to files with this base name.", "record");
+    parser.addOption(recordOpt);
+    QCommandLineOption camerasOpt("cameras","Number of live cameras, each gets its own pipeline.", "cameras");
+    parser.addOption(camerasOpt);
+    QCommandLineOption serialsOpt("serials","Comma separated serial numbers of the live cameras.", "serials");
+    parser.addOption(serialsOpt);
+    QCommandLineOption threadsOpt("threads","Processing threads shared by all cameras, 0 for the number of cores.", "threads");
+    parser.addOption(threadsOpt);
+    QCommandLineOption speedOpt("speed","Playback speed, 0 to play as fast as possible.", "speed");
+    parser.addOption(speedOpt);
+    QCommandLineOption syntheticOpt("synthetic","Play a synthetic scene, can be repeated, e.g. \"rate=20e6,people=2,fall=5,flicker=1,gt=gt.csv\". "
+                                    "Keys: size, rate, noise, people, fall, flicker, flickerHz, duration, seed, gt. "
+                                    "Without gt, repeated scenes write numbered ground truth files.", "spec");
+    parser.addOption(syntheticOpt);
+    QCommandLineOption recordFormatOpt("recordFormat","Format of the recording: aedat or columnar.", "recordFormat");
+    parser.addOption(recordFormatOpt);
+    QCommandLineOption recordMaxOpt("recordMaxMB","Size in MB at which a new recording file is started, 0 for a single file.", "recordMaxMB");
+    parser.addOption(recordMaxOpt);
+    QCommandLineOption convertOpt("convert","Convert the playback file into the columnar format and exit.", "output file");
+    parser.addOption(convertOpt);
 
     parser.process(a);
 
     const QStringList args = parser.positionalArguments();
+    if(parser.isSet(convertOpt)) {
+        if(args.size() < 1) {
+            printf("No playback file to convert.\n");
+            return 1;
+        }
+        return ColumnarWriter::convert(args.at(0),parser.value(convertOpt)) ? 0 : 1;
+    }
     QString minYSpeed = parser.value(minYSpeedThresholdOpt);
     QString maxYSpeed = parser.value(maxYSpeedThresholdOpt);
     QString fallYCenter = parser.value(fallYCenterThresholdOpt);
     QString unfallYCenter = parser.value(unfallYCenterThresholdOpt);
+    QString binning = parser.value(binningOpt);
+    QString detector = parser.value(detectorOpt);
+    QString noiseDt = parser.value(noiseFilterOpt);
+    QString hotPixelMask = parser.value(hotPixelMaskOpt);
+    QString refractory = parser.value(refractoryOpt);
+    QString from = parser.value(fromOpt);
+    QString to = parser.value(toOpt);
+    QString recordFormat = parser.value(recordFormatOpt);
+    QString recordMax = parser.value(recordMaxOpt);
+    QString cameras = parser.value(camerasOpt);
+    QString serials = parser.value(serialsOpt);
+    QString threads = parser.value(threadsOpt);
+    QString speed = parser.value(speedOpt);
     bool minimized = parser.isSet(minimizeOption);
     bool maximized = parser.isSet(maximizeOption);
 
@@ -53,10 +114,77 @@ int main(int argc, char *argv[])
     if(!unfallYCenter.isEmpty()) {
         settings.fall_detector_y_center_threshold_unfall = unfallYCenter.toDouble();
     }
+    if(!binning.isEmpty()) {
+        settings.binning = binning.toInt();
+    }
+    if(!noiseDt.isEmpty()) {
+        settings.noise_filter_time_window_us = noiseDt.toInt();
+        settings.noise_filter_enabled = settings.noise_filter_time_window_us > 0;
+    }
+    if(!hotPixelMask.isEmpty()) {
+        settings.hot_pixel_mask_file = hotPixelMask;
+        settings.playback_hot_pixel_mask_file = hotPixelMask;
+    }
+    if(!refractory.isEmpty()) {
+        settings.hot_pixel_refractory_us = refractory.toInt();
+    }
+    if(!from.isEmpty()) {
+        settings.playback_from_us = from.toDouble()*1000000;
+    }
+    if(!to.isEmpty()) {
+        settings.playback_to_us = to.toDouble()*1000000;
+    }
+    settings.record_file = parser.value(recordOpt);
+    if(!recordMax.isEmpty()) {
+        settings.record_max_file_mb = recordMax.toInt();
+    }
+    if(recordFormat == "columnar") {
+        settings.record_format = RECORDING_COLUMNAR;
+    } else if(recordFormat == "aedat") {
+        settings.record_format = RECORDING_AEDAT;
+    } else if(!recordFormat.isEmpty()) {
+        qWarning("Unknown recording format %s, using default.", qPrintable(recordFormat));
+    }
+    if(!serials.isEmpty()) {
+        settings.camera_serials = serials.split(",");
+    } else if(!cameras.isEmpty()) {
+        settings.camera_serials.clear();
+        for(int i = 0; i < qMax(1,cameras.toInt()); i++)
+            settings.camera_serials << QString();
+    }
+    if(!threads.isEmpty()) {
+        settings.processing_threads = threads.toInt();
+    }
+    if(!speed.isEmpty()) {
+        settings.playback_speed = speed.toFloat();
+    }
+    settings.hot_pixel_recalibrate = parser.isSet(recalibrateOpt);
+    settings.hot_pixel_filter_enabled = !parser.isSet(noHotPixelOpt);
+    if(parser.isSet(benchDetectOpt)) {
+        settings.benchmark_detectors = true;
+    }
+    if(detector == "timesurface") {
+        settings.detector = DETECTOR_TIME_SURFACE;
+    } else if(detector == "dense") {
+        settings.detector = DETECTOR_DENSE;
+    } else if(detector == "pyramid") {
+        settings.detector = DETECTOR_PYRAMID;
+    } else if(!detector.isEmpty()) {
+        qWarning("Unknown detector %s, using default.", qPrintable(detector));
+    }
     qDebug("y_speed_max_threshold: %f", settings.fall_detector_y_speed_max_threshold);
     qDebug("y_speed_min_threshold: %f", settings.fall_detector_y_speed_min_threshold);
     qDebug("y_center_threshold_fall: %f", settings.fall_detector_y_center_threshold_fall);
     qDebug("y_center_threshold_unfall: %f", settings.fall_detector_y_center_threshold_unfall);
+    qDebug("binning: %d", settings.binning);
+    qDebug("detector: %d", settings.detector);
+    qDebug("benchmark_detectors: %d", settings.benchmark_detectors);
+    qDebug("noise_filter: %d, %u us", settings.noise_filter_enabled, settings.noise_filter_time_window_us);
+    qDebug("playback range: %lld - %lld us", (long long)settings.playback_from_us, (long long)settings.playback_to_us);
+    qDebug("hot_pixel_filter: %d, refractory %u us", settings.hot_pixel_filter_enabled, settings.hot_pixel_refractory_us);
+    qDebug("recording: '%s', format %d, max %u MB", qPrintable(settings.record_file), settings.record_format, settings.record_max_file_mb);
+    qDebug("cameras: %d, processing threads: %d", settings.camera_serials.size(), settings.processing_threads);
+    qDebug("playback speed: %f", settings.playback_speed);
 
     MainWindow w(settings,nullptr);
 
@@ -67,8 +195,13 @@ int main(int argc, char *argv[])
     else
         w.show();
 
-    if(args.size() >= 1) {
-        w.playFile(args.at(0));
+    // Each file and synthetic scene is played by its own pipeline
+    QStringList files = args;
+    QStringList scenes = parser.values(syntheticOpt);
+    for(int i = 0; i < scenes.size(); i++)
+        files << SYNTHETIC_SOURCE_PREFIX + scenes.at(i);
+    if(!files.isEmpty()) {
+        w.playFiles(files);
     }
 
     w.setSettings(settings);
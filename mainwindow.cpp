@@ -7,14 +7,9 @@
 #include <QFileDialog>
 
 #include "settings.h"
+#include "columnarformat.h"
 
 
-void callbackPlaybackStopped(void * p)
-{
-    MainWindow *w = (MainWindow*)p;
-    w->callbackProcessingStopped();
-}
-
 MainWindow::MainWindow(tSettings settings, QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
@@ -30,13 +25,18 @@ MainWindow::MainWindow(tSettings settings, QWidget *parent) :
     connect(ui->b_playback_connect,SIGNAL(clicked()),this,SLOT(onClickPlaybackConnect()));
     connect(ui->b_playback_browse,SIGNAL(clicked()),this,SLOT(onClickBrowsePlaybackFile()));
     connect(ui->dsb_playspeed,SIGNAL(editingFinished()),this,SLOT(onPlayspeedChanged()));
+    ui->cb_timeSurfaceDetector->setChecked(settings.detector == DETECTOR_TIME_SURFACE);
+    connect(ui->cb_timeSurfaceDetector,SIGNAL(toggled(bool)),this,SLOT(onDetectorChanged()));
+    ui->cb_noiseFilter->setChecked(settings.noise_filter_enabled);
+    connect(ui->cb_noiseFilter,SIGNAL(toggled(bool)),this,SLOT(onNoiseFilterChanged()));
+    connect(ui->cb_pipeline,SIGNAL(currentIndexChanged(int)),this,SLOT(onPipelineChanged()));
+    ui->dsb_playspeed->setValue(settings.playback_speed);
 
-    processingStopped = false;
     exitAfterPlayback = false;
+    lastObjId = -1;
+    m_playbackFiles << ui->l_playback_file->text();
 
-    camHandler.setDVSEventReciever(&proc);
-    camHandler.setFrameReciever(&proc);
-    proc.setSettings(settings);
+    m_pipelines.setSettings(settings);
 
     timer = new QTimer(this);
     connect(timer,SIGNAL(timeout()),this,SLOT(redrawUI()));
@@ -49,8 +49,7 @@ MainWindow::~MainWindow()
 }
 void MainWindow::closeEvent (QCloseEvent *event)
 {
-    camHandler.disconnect();
-    proc.stop();
+    m_pipelines.stop();
 }
 
 void MainWindow::setupUI()
@@ -77,83 +76,111 @@ void MainWindow::setupUI()
 
 void MainWindow::onPlayspeedChanged()
 {
-    camHandler.changePlaybackSpeed(ui->dsb_playspeed->value());
+    m_pipelines.setPlaybackSpeed(ui->dsb_playspeed->value());
+}
+
+void MainWindow::onDetectorChanged()
+{
+    // Unchecked returns to the dense or pyramid path selected on startup
+    tDetector denseDetector = settings.detector == DETECTOR_PYRAMID ? DETECTOR_PYRAMID : DETECTOR_DENSE;
+    m_pipelines.setDetector(ui->cb_timeSurfaceDetector->isChecked()?DETECTOR_TIME_SURFACE:denseDetector);
+}
+
+void MainWindow::onNoiseFilterChanged()
+{
+    m_pipelines.setNoiseFilterEnabled(ui->cb_noiseFilter->isChecked());
+}
+
+void MainWindow::onPipelineChanged()
+{
+    plotEventsInWindow->clear();
+    plotSpeed->clear();
+    plotVerticalCentroid->clear();
+    lastObjId = -1;
+    // The rendered range belongs to the buffer of the previous pipeline
+    m_eventRenderer.reset();
+
+    int idx = ui->cb_pipeline->currentIndex();
+    if(idx >= 0 && idx < m_pipelines.getPipelineCnt()) {
+        QVector2D sz = m_pipelines.getPipeline(idx)->getCameraHandler().getFrameSize();
+        plotVerticalCentroid->setYRange(0,sz.y());
+    }
+}
+
+void MainWindow::startProcessing()
+{
+    onPlayspeedChanged();
+    m_pipelines.start();
+
+    ui->cb_pipeline->blockSignals(true);
+    ui->cb_pipeline->clear();
+    for(int i = 0; i < m_pipelines.getPipelineCnt(); i++)
+        ui->cb_pipeline->addItem(m_pipelines.getPipeline(i)->getName());
+    ui->cb_pipeline->blockSignals(false);
+    onPipelineChanged();
+}
+
+void MainWindow::stopProcessing()
+{
+    m_pipelines.stop();
+    ui->cb_pipeline->blockSignals(true);
+    ui->cb_pipeline->clear();
+    ui->cb_pipeline->blockSignals(false);
+    ui->b_playback_connect->setEnabled(true);
+    ui->b_online_connect->setEnabled(true);
+    ui->b_playback_connect->setText("playback");
+    ui->b_online_connect->setText("online");
 }
 
 void MainWindow::onClickPlaybackConnect()
 {
-    if(camHandler.isConnected()) {
-        camHandler.disconnect();
-        proc.stop();
-        ui->b_playback_connect->setEnabled(true);
-        ui->b_online_connect->setEnabled(true);
-        ui->b_playback_connect->setText("playback");
-        ui->b_online_connect->setText("online");
+    if(m_pipelines.isRunning()) {
+        stopProcessing();
     } else {
-        if(!camHandler.connect(ui->l_playback_file->text(),callbackPlaybackStopped,this)) {
+        if(!m_pipelines.connectFiles(m_playbackFiles)) {
             QMessageBox::critical(this,"Error","Can't open file!");
             return;
         }
-        onPlayspeedChanged();
         ui->b_online_connect->setEnabled(false);
         ui->b_playback_connect->setText("stop");
-        plotEventsInWindow->clear();
-        plotSpeed->clear();
-        plotVerticalCentroid->clear();
-
-        QVector2D sz = camHandler.getFrameSize();
-        proc.start(sz.x(),sz.y());
-        camHandler.startStreaming();
+        startProcessing();
     }
 
 }
 void MainWindow::onClickOnlineConnect()
 {
-    if(camHandler.isConnected()) {
-        camHandler.disconnect();
-        proc.stop();
-        ui->b_playback_connect->setEnabled(true);
-        ui->b_online_connect->setEnabled(true);
-        ui->b_playback_connect->setText("playback");
-        ui->b_online_connect->setText("online");
+    if(m_pipelines.isRunning()) {
+        stopProcessing();
     } else {
-        if(!camHandler.connect(1)) {
+        if(!m_pipelines.connectCameras(settings.camera_serials)) {
             QMessageBox::critical(this,"Error","Can't connect to camera!");
             return;
         }
         ui->b_playback_connect->setEnabled(false);
         ui->b_online_connect->setText("stop");
-        plotEventsInWindow->clear();
-        plotSpeed->clear();
-        plotVerticalCentroid->clear();
-
-        QVector2D sz = camHandler.getFrameSize();
-        proc.start(sz.x(),sz.y());
-        camHandler.startStreaming();
+        startProcessing();
     }
 }
 
 void MainWindow::onClickBrowsePlaybackFile()
 {
-    QString fileName = QFileDialog::getOpenFileName(this,
-                       tr("Open Playback file"), "/tausch/FallDetectionProjectRecords", tr("AEDAT files (*.aedat)"));
-    if(!fileName.isEmpty())
-        ui->l_playback_file->setText(fileName);
+    QStringList fileNames = QFileDialog::getOpenFileNames(this,
+                            tr("Open Playback files"), "/tausch/FallDetectionProjectRecords", tr("Recordings (*.aedat *.aedat4 *.raw *.csv *.txt *" COLUMNAR_FILE_SUFFIX ");;All files (*)"));
+    if(!fileNames.isEmpty()) {
+        m_playbackFiles = fileNames;
+        ui->l_playback_file->setText(fileNames.join("; "));
+    }
 }
 
 void MainWindow::redrawUI()
 {
-    if(processingStopped) {
-        processingStopped = false;
-        camHandler.disconnect();
-        proc.stop();
-        ui->b_playback_connect->setEnabled(true);
-        ui->b_online_connect->setEnabled(true);
-        ui->b_playback_connect->setText("playback");
-        ui->b_online_connect->setText("online");
+    if(m_pipelines.isPlaybackFinished()) {
+        stopProcessing();
         if(exitAfterPlayback)
             QApplication::quit();
     }
+    // Learned masks are written here to keep file I/O off the camera threads
+    m_pipelines.saveHotPixelMasks();
 
     uint32_t elapsedTime = m_realRedrawTimer.nsecsElapsed()/1000;
     m_realRedrawTimer.restart();
@@ -176,14 +203,46 @@ void MainWindow::redrawUI()
     plotVerticalCentroid->setLineGroupActive(1,ui->cb_showLostTrackingInGraph->isChecked());
     plotSpeed->setLineGroupActive(1,ui->cb_showLostTrackingInGraph->isChecked());
 
-    if(camHandler.isStreaming()) {
-
+    int pipelineIdx = ui->cb_pipeline->currentIndex();
+    // Frames are only converted for the shown camera while the window is visible
+    for(int i = 0; i < m_pipelines.getPipelineCnt(); i++)
+        m_pipelines.getPipeline(i)->getProcessor().setFrameViewerActive(i == pipelineIdx && isVisible() && !isMinimized());
+    if(m_pipelines.isRunning() && pipelineIdx >= 0 && pipelineIdx < m_pipelines.getPipelineCnt() &&
+            m_pipelines.getPipeline(pipelineIdx)->getCameraHandler().isStreaming()) {
+
+        Pipeline* pipeline = m_pipelines.getPipeline(pipelineIdx);
+        CameraHandler &camHandler = pipeline->getCameraHandler();
+        Processor &proc = pipeline->getProcessor();
+        BackgroundActivityFilter &noiseFilter = pipeline->getNoiseFilter();
+        HotPixelFilter &hotPixelFilter = pipeline->getHotPixelFilter();
         EventBuffer & buff = proc.getBuffer();
         QVector<Processor::sObjectStats> statsList = proc.getStats();
-        int time = buff.getCurrTime();
+        uint64_t time = buff.getCurrTime();
 
         int evCnt = buff.getSize();
-        ui->l_status->setText(QString("Events: %1 GUI FPS: %2").arg(evCnt).arg(m_uiRedrawFPS,0,'g',3));
+        float jitterAvg;
+        uint32_t jitterMax;
+        proc.getTickJitter(jitterAvg,jitterMax);
+        QString status = QString("Events: %1 GUI FPS: %2 Queue peak: %3 Dropped: %4 Detection: %5 us Jitter: %6/%7 us Noise: %8 % Hot pixels: %9")
+                         .arg(evCnt).arg(m_uiRedrawFPS,0,'g',3)
+                         .arg(proc.getQueueHighWaterMark()).arg(proc.getQueueDroppedCnt())
+                         .arg(proc.getDetectionTimeUs(),0,'f',0)
+                         .arg(jitterAvg,0,'f',0).arg(jitterMax)
+                         .arg(noiseFilter.getTotalCnt() > 0 ?
+                              100.0*noiseFilter.getDroppedCnt()/noiseFilter.getTotalCnt() : 0.0,0,'f',1)
+                         .arg(hotPixelFilter.isCalibrating() ? QString("calibrating") :
+                              QString::number(hotPixelFilter.getHotPixelCnt()));
+        const RecordingTee &tee = camHandler.getRecordingTee();
+        if(tee.isRecording())
+            status += QString(" Recording: %1 MB Dropped packets: %2")
+                      .arg(tee.getWrittenBytes()/1048576.0,0,'f',1).arg(tee.getDroppedCnt());
+        if(m_pipelines.getPipelineCnt() > 1 || m_pipelines.getAlertCnt() > 0)
+            status += QString(" Cameras: %1 Alerts: %2").arg(m_pipelines.getPipelineCnt()).arg(m_pipelines.getAlertCnt());
+        QVector<PipelineManager::sAlert> alerts = m_pipelines.getAlerts();
+        if(!alerts.isEmpty())
+            status += QString(" Last alert: %1 at %2 s").arg(alerts.last().name)
+                      .arg(alerts.last().time/1000000.0,0,'f',1);
+        ui->l_status->setText(status);
 
         if(statsList.size() > 0) {
             Processor::sObjectStats stats = statsList.at(0);
@@ -217,8 +276,10 @@ void MainWindow::redrawUI()
         plotSpeed->update();
 
         QImage grayImg = proc.getImg();
-        QImage bufferImg = buff.toImage();
-        QPixmap pix = QPixmap::fromImage(bufferImg);
+        QPixmap pix = QPixmap::fromImage(m_eventRenderer.render(buff));
+        // The event buffer may be binned, show it at sensor resolution
+        if(pix.size() != grayImg.size())
+            pix = pix.scaled(grayImg.size());
         QPainter painterEventImg(&pix);
 
         if(ui->cb_showHelpLines->isChecked()) {
@@ -300,10 +361,12 @@ void MainWindow::redrawUI()
         ui->l_status->setText(QString("GUI FPS: %2").arg(m_uiRedrawFPS,0,'g',3));
     }
 }
-void MainWindow::playFile(QString fileName)
+void MainWindow::playFiles(QStringList fileNames)
 {
-    if(!fileName.isEmpty())
-        ui->l_playback_file->setText(fileName);
+    if(!fileNames.isEmpty()) {
+        m_playbackFiles = fileNames;
+        ui->l_playback_file->setText(fileNames.join("; "));
+    }
     exitAfterPlayback = true;
 
     onClickPlaybackConnect();
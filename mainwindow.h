@@ -9,8 +9,8 @@
 
 #include "simpletimeplot.h"
 
-#include "camerahandler.h"
-#include "processor.h"
+#include "pipelinemanager.h"
+#include "eventimagerenderer.h"
 
 #include "aspectratiopixmap.h"
 
@@ -29,12 +29,13 @@ public:
 
     void closeEvent (QCloseEvent *event);
 
-    void playFile(QString fileName);
+    /**
+     * @brief playFiles Plays the recordings in parallel, one pipeline per file,
+     * and quits the application when all have ended.
+     * @param fileNames
+     */
+    void playFiles(QStringList fileNames);
 
-    void callbackProcessingStopped()
-    {
-        processingStopped = true;
-    }
     void setSettings(tSettings &settings)
     {
     }
@@ -46,14 +47,26 @@ public slots:
     void onClickOnlineConnect();
     void onClickBrowsePlaybackFile();
     void onPlayspeedChanged();
+    void onDetectorChanged();
+    void onNoiseFilterChanged();
+    void onPipelineChanged();
 
 private:
     void setupUI();
+    /**
+     * @brief startProcessing Starts all connected pipelines and lists them in the selector.
+     */
+    void startProcessing();
+    /**
+     * @brief stopProcessing Stops all pipelines and resets the connection buttons.
+     */
+    void stopProcessing();
 private:
     Ui::MainWindow *ui;
     QTimer* timer;
-    CameraHandler camHandler;
-    Processor proc;
+    PipelineManager m_pipelines;
+    QStringList m_playbackFiles;
+    EventImageRenderer m_eventRenderer;
     float m_uiRedrawFPS;
     QElapsedTimer m_realRedrawTimer;
     SimpleTimePlot *plotEventsInWindow;
@@ -61,7 +74,6 @@ private:
     SimpleTimePlot *plotSpeed;
     int lastObjId;
     bool  exitAfterPlayback;
-    bool processingStopped;
     tSettings settings;
 
 };
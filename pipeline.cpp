@@ -0,0 +1,101 @@
+#include "pipeline.h"
+
+#include "pipelinemanager.h"
+
+Pipeline::Pipeline(PipelineManager *manager, int index, const tSettings &settings):
+    m_manager(manager),
+    m_index(index),
+    m_settings(settings),
+    m_saveHotPixelMask(false),
+    m_playbackFinished(false)
+{
+    m_camHandler.setDVSEventReciever(&m_proc);
+    m_camHandler.setFrameReciever(&m_proc);
+    m_proc.setSettings(m_settings);
+    m_proc.setFallReciever(this);
+
+    // Hot pixels have to be removed first, they would support their neighbours
+    if(m_settings.hot_pixel_filter_enabled) {
+        m_hotPixelFilter.setRefractoryPeriod(m_settings.hot_pixel_refractory_us);
+        m_camHandler.addEventFilter(&m_hotPixelFilter);
+    }
+    m_noiseFilter.setEnabled(m_settings.noise_filter_enabled);
+    m_noiseFilter.setTimeWindow(m_settings.noise_filter_time_window_us);
+    m_camHandler.addEventFilter(&m_noiseFilter);
+}
+
+Pipeline::~Pipeline()
+{
+    stop();
+}
+
+bool Pipeline::connectCamera(QString serial, QString hotPixelMaskFile, QString recordFile)
+{
+    m_name = serial.isEmpty() ? QString("Camera %1").arg(m_index + 1) : QString("Camera %1").arg(serial);
+    m_hotPixelMaskFile = hotPixelMaskFile;
+    m_saveHotPixelMask = true;
+    m_playbackFinished = false;
+    m_camHandler.setRecording(recordFile,m_settings.record_format,
+                              (qint64)m_settings.record_max_file_mb*1024*1024);
+    return m_camHandler.connect(m_index + 1,serial);
+}
+
+bool Pipeline::connectFile(QString fileName)
+{
+    int pos = fileName.lastIndexOf("/");
+    m_name = pos >= 0 ? fileName.mid(pos + 1) : fileName;
+    // Recordings are never written to, the mask is only read if given explicitly.
+    // Synthetic scenes have no hot pixels.
+    m_hotPixelMaskFile = fileName.startsWith(SYNTHETIC_SOURCE_PREFIX) ? QString() : m_settings.playback_hot_pixel_mask_file;
+    m_saveHotPixelMask = false;
+    m_playbackFinished = false;
+    m_camHandler.setPlaybackRange(m_settings.playback_from_us,m_settings.playback_to_us);
+    return m_camHandler.connect(fileName,playbackFinished,this);
+}
+
+void Pipeline::start(ProcessingPool *pool)
+{
+    QVector2D sz = m_camHandler.getFrameSize();
+    m_noiseFilter.setup(sz.x(),sz.y());
+    if(m_settings.hot_pixel_filter_enabled) {
+        m_hotPixelFilter.setup(sz.x(),sz.y(),m_camHandler.getSerialNumber(),
+                               m_hotPixelMaskFile,m_saveHotPixelMask);
+        if(m_settings.hot_pixel_recalibrate)
+            m_hotPixelFilter.recalibrate();
+    }
+    m_proc.start(sz.x(),sz.y(),pool);
+    m_camHandler.startStreaming();
+}
+
+void Pipeline::stop()
+{
+    if(m_camHandler.isConnected())
+        m_camHandler.disconnect();
+    m_proc.stop();
+    // A mask learned shortly before the stop
+    saveHotPixelMask();
+}
+
+void Pipeline::saveHotPixelMask()
+{
+    if(m_settings.hot_pixel_filter_enabled)
+        m_hotPixelFilter.saveLearnedMask();
+}
+
+void Pipeline::newFall(uint32_t id, uint64_t time, const QRectF &bbox, Processor::FallState state)
+{
+    m_manager->addAlert(m_index,id,time,bbox,state);
+}
+
+void Pipeline::printStats()
+{
+    printf("%s: %zu events, queue high-water mark: %zu, dropped: %zu, detection: %.0f us, falls: %zu\n",
+           m_name.toStdString().c_str(), m_proc.getProcessedEventCnt(), m_proc.getQueueHighWaterMark(),
+           m_proc.getQueueDroppedCnt(), m_proc.getDetectionTimeUs(), m_proc.getFallCnt());
+}
+
+void Pipeline::playbackFinished(void *p)
+{
+    Pipeline* pipeline = (Pipeline*)p;
+    pipeline->m_playbackFinished = true;
+}
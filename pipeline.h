@@ -0,0 +1,126 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+
+#include <QString>
+
+#include "camerahandler.h"
+#include "processor.h"
+#include "backgroundactivityfilter.h"
+#include "hotpixelfilter.h"
+#include "settings.h"
+
+class PipelineManager;
+class ProcessingPool;
+
+/**
+ * @brief The Pipeline class connects one camera or recording through the
+ * event filters to its own processor. The camera thread of each pipeline
+ * only decodes and filters, the processing steps run on a shared ProcessingPool.
+ * Detected falls are forwarded to the PipelineManager.
+ */
+class Pipeline: public Processor::IFallReciever
+{
+public:
+    /**
+     * @brief Pipeline Creates an unconnected pipeline.
+     * @param manager Receives the falls of the pipeline
+     * @param index Index of the pipeline in the manager
+     * @param settings
+     */
+    Pipeline(PipelineManager* manager, int index, const tSettings &settings);
+    virtual ~Pipeline();
+
+    /**
+     * @brief connectCamera Opens a live camera.
+     * @param serial Serial number of the camera, empty for the first free camera
+     * @param hotPixelMaskFile Hot pixel mask of this camera
+     * @param recordFile Base name of the recording, empty to disable the recording
+     * @return
+     */
+    bool connectCamera(QString serial, QString hotPixelMaskFile, QString recordFile);
+    /**
+     * @brief connectFile Opens a recording or synthetic scene for playback.
+     * @param fileName
+     * @return
+     */
+    bool connectFile(QString fileName);
+    /**
+     * @brief start Prepares the filters and the processor and starts streaming.
+     * @param pool Shared workers of the processing steps, NULL for a dedicated processing thread
+     */
+    void start(ProcessingPool* pool);
+    /**
+     * @brief stop Stops streaming and processing and disconnects the camera or file.
+     */
+    void stop();
+
+    /**
+     * @brief saveHotPixelMask Writes a newly learned hot pixel mask of the camera.
+     * Polled from the GUI thread, the camera thread only keeps the mask in memory.
+     */
+    void saveHotPixelMask();
+
+    /**
+     * @brief isPlaybackFinished Returns true when the played file has ended.
+     * @return
+     */
+    bool isPlaybackFinished()
+    {
+        return m_playbackFinished;
+    }
+    QString getName()
+    {
+        return m_name;
+    }
+    int getIndex()
+    {
+        return m_index;
+    }
+
+    CameraHandler &getCameraHandler()
+    {
+        return m_camHandler;
+    }
+    Processor &getProcessor()
+    {
+        return m_proc;
+    }
+    BackgroundActivityFilter &getNoiseFilter()
+    {
+        return m_noiseFilter;
+    }
+    HotPixelFilter &getHotPixelFilter()
+    {
+        return m_hotPixelFilter;
+    }
+
+    /**
+     * @brief newFall Implements the fall receiver of the processor.
+     */
+    void newFall(uint32_t id, uint64_t time, const QRectF &bbox, Processor::FallState state);
+    /**
+     * @brief printStats Prints the event, queue and fall statistics of the pipeline.
+     */
+    void printStats();
+
+private:
+    static void playbackFinished(void* p);
+
+    PipelineManager* m_manager;
+    int m_index;
+    QString m_name;
+    tSettings m_settings;
+    QString m_hotPixelMaskFile;
+    // Only the masks of live cameras are written
+    bool m_saveHotPixelMask;
+    std::atomic_bool m_playbackFinished;
+
+    CameraHandler m_camHandler;
+    Processor m_proc;
+    BackgroundActivityFilter m_noiseFilter;
+    HotPixelFilter m_hotPixelFilter;
+};
+
+#endif // PIPELINE_H
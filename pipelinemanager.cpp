@@ -0,0 +1,185 @@
+#include "pipelinemanager.h"
+
+#include <QThreadPool>
+
+PipelineManager::PipelineManager():
+    m_isStarted(false),
+    m_alertCnt(0)
+{
+}
+
+PipelineManager::~PipelineManager()
+{
+    stop();
+}
+
+bool PipelineManager::connectCameras(QStringList serials)
+{
+    stop();
+    for(int i = 0; i < serials.size(); i++) {
+        Pipeline* pipeline = new Pipeline(this,i,m_settings);
+        m_pipelines.push_back(pipeline);
+        QString suffix = serials.at(i).isEmpty() ? QString::number(i + 1) : serials.at(i);
+        if(!pipeline->connectCamera(serials.at(i),
+                                    numberedName(m_settings.hot_pixel_mask_file,suffix,serials.size()),
+                                    numberedName(m_settings.record_file,suffix,serials.size()))) {
+            stop();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PipelineManager::connectFiles(QStringList files)
+{
+    stop();
+    int sceneCnt = 0;
+    for(int i = 0; i < files.size(); i++)
+        if(files.at(i).startsWith(SYNTHETIC_SOURCE_PREFIX))
+            sceneCnt++;
+
+    int sceneIdx = 0;
+    for(int i = 0; i < files.size(); i++) {
+        QString file = files.at(i);
+        // Repeated synthetic scenes without their own ground truth file
+        // would all write the default file from different threads
+        if(file.startsWith(SYNTHETIC_SOURCE_PREFIX)) {
+            sceneIdx++;
+            if(!hasGroundTruthFile(file))
+                file += ",gt=" + numberedName(SYNTHETIC_GT_FILE,QString::number(sceneIdx),sceneCnt);
+        }
+        Pipeline* pipeline = new Pipeline(this,i,m_settings);
+        m_pipelines.push_back(pipeline);
+        if(!pipeline->connectFile(file)) {
+            printf("Can't open %s\n", files.at(i).toStdString().c_str());
+            stop();
+            return false;
+        }
+    }
+    return true;
+}
+
+void PipelineManager::start()
+{
+    {
+        QMutexLocker locker(&m_alertMutex);
+        m_alerts.clear();
+    }
+    m_alertCnt = 0;
+
+    // Each pipeline runs its camera thread and possibly a recording thread on the global pool
+    QThreadPool* globalPool = QThreadPool::globalInstance();
+    int threadCnt = 2*m_pipelines.size();
+    if(globalPool->maxThreadCount() < threadCnt)
+        globalPool->setMaxThreadCount(threadCnt);
+
+    m_isStarted = true;
+    m_pool.start(m_settings.processing_threads);
+    for(size_t i = 0; i < m_pipelines.size(); i++)
+        m_pipelines[i]->start(&m_pool);
+    // Only once per application start
+    m_settings.hot_pixel_recalibrate = false;
+}
+
+void PipelineManager::stop()
+{
+    if(m_pipelines.empty())
+        return;
+    for(size_t i = 0; i < m_pipelines.size(); i++)
+        m_pipelines[i]->stop();
+    m_pool.stop();
+
+    for(size_t i = 0; i < m_pipelines.size(); i++) {
+        if(m_isStarted)
+            m_pipelines[i]->printStats();
+        delete m_pipelines[i];
+    }
+    m_pipelines.clear();
+    if(m_isStarted)
+        printf("Alerts: %zu\n", getAlertCnt());
+    m_isStarted = false;
+}
+
+bool PipelineManager::isPlaybackFinished()
+{
+    if(m_pipelines.empty())
+        return false;
+    for(size_t i = 0; i < m_pipelines.size(); i++) {
+        if(!m_pipelines[i]->isPlaybackFinished())
+            return false;
+    }
+    return true;
+}
+
+void PipelineManager::saveHotPixelMasks()
+{
+    for(size_t i = 0; i < m_pipelines.size(); i++)
+        m_pipelines[i]->saveHotPixelMask();
+}
+
+void PipelineManager::setPlaybackSpeed(float speed)
+{
+    for(size_t i = 0; i < m_pipelines.size(); i++)
+        m_pipelines[i]->getCameraHandler().changePlaybackSpeed(speed);
+}
+
+void PipelineManager::setDetector(tDetector detector)
+{
+    m_settings.detector = detector;
+    for(size_t i = 0; i < m_pipelines.size(); i++)
+        m_pipelines[i]->getProcessor().setDetector(detector);
+}
+
+void PipelineManager::setNoiseFilterEnabled(bool enabled)
+{
+    m_settings.noise_filter_enabled = enabled;
+    for(size_t i = 0; i < m_pipelines.size(); i++)
+        m_pipelines[i]->getNoiseFilter().setEnabled(enabled);
+}
+
+void PipelineManager::addAlert(int pipeline, uint32_t id, uint64_t time, const QRectF &bbox, Processor::FallState state)
+{
+    sAlert alert;
+    alert.pipeline = pipeline;
+    alert.name = m_pipelines.at(pipeline)->getName();
+    alert.id = id;
+    alert.time = time;
+    alert.bbox = bbox;
+    alert.state = state;
+
+    printf("[Alert] %s: Object %04u %s, Time: %llu\n", alert.name.toStdString().c_str(), id,
+           state == Processor::FALL_CONFIRMED ? "fell" : "possibly fell", (unsigned long long)time);
+
+    QMutexLocker locker(&m_alertMutex);
+    m_alerts.push_back(alert);
+    if(m_alerts.size() > ALERT_HISTORY_SZ)
+        m_alerts.pop_front();
+    m_alertCnt.fetch_add(1,std::memory_order_relaxed);
+}
+
+QVector<PipelineManager::sAlert> PipelineManager::getAlerts()
+{
+    QMutexLocker locker(&m_alertMutex);
+    QVector<sAlert> alerts;
+    alerts.reserve(m_alerts.size());
+    for(size_t i = 0; i < m_alerts.size(); i++)
+        alerts.push_back(m_alerts[i]);
+    return alerts;
+}
+
+bool PipelineManager::hasGroundTruthFile(QString spec)
+{
+    spec = spec.mid(QString(SYNTHETIC_SOURCE_PREFIX).length());
+    QStringList entries = spec.split(",",QString::SkipEmptyParts);
+    for(int i = 0; i < entries.size(); i++)
+        if(entries.at(i).section('=',0,0).trimmed() == "gt")
+            return true;
+    return false;
+}
+
+QString PipelineManager::numberedName(QString name, QString suffix, int cameraCnt)
+{
+    if(name.isEmpty() || cameraCnt <= 1)
+        return name;
+    return name + "_" + suffix;
+}
@@ -0,0 +1,139 @@
+#ifndef PIPELINEMANAGER_H
+#define PIPELINEMANAGER_H
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include <QMutex>
+#include <QRectF>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "pipeline.h"
+#include "processingpool.h"
+#include "processor.h"
+#include "settings.h"
+
+/**
+ * @brief The PipelineManager class runs several camera or playback pipelines
+ * in one process. All processors share one bounded ProcessingPool, so each
+ * additional camera only adds its camera thread. The falls of all pipelines
+ * are merged into one alert stream.
+ */
+class PipelineManager
+{
+public:
+    /**
+     * Fall alert of one of the pipelines.
+     **/
+    typedef struct sAlert {
+        // Index and name of the pipeline
+        int pipeline;
+        QString name;
+        // Object ID in the pipeline
+        uint32_t id;
+        // Event time of the detection in us
+        uint64_t time;
+        QRectF bbox;
+        Processor::FallState state;
+    } sAlert;
+
+    PipelineManager();
+    ~PipelineManager();
+
+    void setSettings(const tSettings &settings)
+    {
+        m_settings = settings;
+    }
+
+    /**
+     * @brief connectCameras Creates one pipeline per camera. With more than one camera,
+     * the serial number or index is appended to the hot pixel mask and recording names.
+     * @param serials Serial numbers of the cameras, empty entries for the next free camera
+     * @return False if a camera can't be opened, no pipeline is left in this case
+     */
+    bool connectCameras(QStringList serials);
+    /**
+     * @brief connectFiles Creates one pipeline per recording or synthetic scene.
+     * @param files
+     * @return False if a file can't be opened, no pipeline is left in this case
+     */
+    bool connectFiles(QStringList files);
+    /**
+     * @brief start Starts the processing pool and all pipelines.
+     */
+    void start();
+    /**
+     * @brief stop Stops all pipelines, prints their statistics and deletes them.
+     */
+    void stop();
+    bool isRunning()
+    {
+        return !m_pipelines.empty();
+    }
+    /**
+     * @brief isPlaybackFinished Returns true if all pipelines played files that have ended.
+     * @return
+     */
+    bool isPlaybackFinished();
+
+    int getPipelineCnt()
+    {
+        return m_pipelines.size();
+    }
+    Pipeline* getPipeline(int idx)
+    {
+        return m_pipelines.at(idx);
+    }
+
+    /**
+     * @brief saveHotPixelMasks Writes the newly learned hot pixel masks of all pipelines.
+     * Called periodically from the GUI thread.
+     */
+    void saveHotPixelMasks();
+
+    void setPlaybackSpeed(float speed);
+    void setDetector(tDetector detector);
+    void setNoiseFilterEnabled(bool enabled);
+
+    /**
+     * @brief addAlert Adds a fall to the alert stream. Called by the processing threads.
+     */
+    void addAlert(int pipeline, uint32_t id, uint64_t time, const QRectF &bbox, Processor::FallState state);
+    /**
+     * @brief getAlerts Returns the latest alerts of all pipelines, ordered from old to new.
+     * @return
+     */
+    QVector<sAlert> getAlerts();
+    /**
+     * @brief getAlertCnt Returns the number of alerts since the last start.
+     * @return
+     */
+    size_t getAlertCnt()
+    {
+        return m_alertCnt.load(std::memory_order_relaxed);
+    }
+
+private:
+    /**
+     * @brief numberedName Appends the suffix to a file name if more than one camera is used.
+     */
+    QString numberedName(QString name, QString suffix, int cameraCnt);
+    /**
+     * @brief hasGroundTruthFile Returns true if a synthetic scene spec sets its ground truth file.
+     */
+    bool hasGroundTruthFile(QString spec);
+
+    tSettings m_settings;
+    std::vector<Pipeline*> m_pipelines;
+    bool m_isStarted;
+    ProcessingPool m_pool;
+
+    QMutex m_alertMutex;
+    std::deque<sAlert> m_alerts;
+    std::atomic<size_t> m_alertCnt;
+};
+
+#endif // PIPELINEMANAGER_H
@@ -0,0 +1,128 @@
+#include "processingpool.h"
+
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+
+#include "processor.h"
+#include "settings.h"
+
+ProcessingPool::ProcessingPool():
+    m_isRunning(false),
+    m_nextSlot(0),
+    m_idleCnt(0)
+{
+}
+
+ProcessingPool::~ProcessingPool()
+{
+    stop();
+}
+
+void ProcessingPool::start(int workerCnt)
+{
+    stop();
+    if(workerCnt <= 0)
+        workerCnt = qMax(1,QThread::idealThreadCount());
+
+    m_threadPool.setMaxThreadCount(workerCnt);
+    m_isRunning = true;
+    for(int i = 0; i < workerCnt; i++)
+        m_workers.push_back(QtConcurrent::run(&m_threadPool,this,&ProcessingPool::run));
+    printf("Processing pool started with %d workers\n", workerCnt);
+}
+
+void ProcessingPool::stop()
+{
+    if(!m_isRunning)
+        return;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_isRunning = false;
+        m_wakeCondition.wakeAll();
+    }
+    for(size_t i = 0; i < m_workers.size(); i++)
+        m_workers[i].waitForFinished();
+    m_workers.clear();
+}
+
+void ProcessingPool::addProcessor(Processor *proc)
+{
+    QMutexLocker locker(&m_mutex);
+    sSlot slot;
+    slot.proc = proc;
+    slot.busy = false;
+    m_slots.push_back(slot);
+    m_wakeCondition.wakeOne();
+}
+
+void ProcessingPool::removeProcessor(Processor *proc)
+{
+    QMutexLocker locker(&m_mutex);
+    for(size_t i = 0; i < m_slots.size(); i++) {
+        if(m_slots[i].proc != proc)
+            continue;
+        while(m_slots[i].busy)
+            m_stepCondition.wait(&m_mutex);
+        m_slots.erase(m_slots.begin() + i);
+        if(m_nextSlot > i)
+            m_nextSlot--;
+        return;
+    }
+}
+
+void ProcessingPool::wake()
+{
+    // Orders the queue insertion before reading the counter, see run
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_idleCnt.load(std::memory_order_relaxed) > 0) {
+        QMutexLocker locker(&m_mutex);
+        m_wakeCondition.wakeOne();
+    }
+}
+
+void ProcessingPool::run()
+{
+    QMutexLocker locker(&m_mutex);
+    while(m_isRunning) {
+        // Orders the counter before checking for data. Either the producer sees the
+        // counter and signals after we wait (it needs the mutex), or we see its data here.
+        m_idleCnt.fetch_add(1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        size_t idx = m_slots.size();
+        qint64 waitUs = PROCESSING_POOL_MAX_IDLE_US;
+        for(size_t i = 0; i < m_slots.size(); i++) {
+            size_t k = (m_nextSlot + i) % m_slots.size();
+            if(m_slots[k].busy)
+                continue;
+            if(m_slots[k].proc->hasWork()) {
+                idx = k;
+                break;
+            }
+            waitUs = qMin(waitUs,m_slots[k].proc->getTimeToNextUpdateUs());
+        }
+
+        if(idx == m_slots.size()) {
+            // Round up to not wake before the deadline
+            m_wakeCondition.wait(&m_mutex,qMax((qint64)1,(waitUs+999)/1000));
+            m_idleCnt.fetch_sub(1,std::memory_order_relaxed);
+            continue;
+        }
+        m_idleCnt.fetch_sub(1,std::memory_order_relaxed);
+
+        // The next search starts behind this processor to share the workers fairly
+        m_nextSlot = idx + 1;
+        m_slots[idx].busy = true;
+        Processor* proc = m_slots[idx].proc;
+        locker.unlock();
+        proc->step();
+        locker.relock();
+
+        // Slots may have been removed in the meantime
+        for(size_t i = 0; i < m_slots.size(); i++) {
+            if(m_slots[i].proc == proc)
+                m_slots[i].busy = false;
+        }
+        m_stepCondition.wakeAll();
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef PROCESSINGPOOL_H
+#define PROCESSINGPOOL_H
+
+#include <atomic>
+#include <vector>
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFuture>
+#include <QThreadPool>
+
+class Processor;
+
+/**
+ * @brief The ProcessingPool class runs the processing steps of several processors
+ * on a fixed number of worker threads instead of one thread per processor.
+ * Workers visit the processors round robin and run one step of each processor
+ * that has work, a processor is never stepped by two workers at once.
+ * Idle workers sleep until new data arrives or the next update step is due.
+ */
+class ProcessingPool
+{
+public:
+    ProcessingPool();
+    ~ProcessingPool();
+
+    /**
+     * @brief start Starts the worker threads.
+     * @param workerCnt Number of workers, 0 for the number of cores
+     */
+    void start(int workerCnt);
+    /**
+     * @brief stop Stops the worker threads. All processors have to be removed before.
+     */
+    void stop();
+    bool isRunning() const
+    {
+        return m_isRunning;
+    }
+    int getWorkerCnt() const
+    {
+        return m_workers.size();
+    }
+
+    /**
+     * @brief addProcessor Starts running the steps of a started processor.
+     * @param proc
+     */
+    void addProcessor(Processor* proc);
+    /**
+     * @brief removeProcessor Stops running the steps of the processor
+     * and waits until the current step has finished.
+     * @param proc
+     */
+    void removeProcessor(Processor* proc);
+    /**
+     * @brief wake Wakes an idle worker. Called by the producer threads after queuing data.
+     */
+    void wake();
+
+private:
+    typedef struct sSlot {
+        Processor* proc;
+        // Set while a worker runs a step of the processor
+        bool busy;
+    } sSlot;
+
+    /**
+     * @brief run Worker thread.
+     */
+    void run();
+
+    std::atomic_bool m_isRunning;
+    // Owns the worker threads, separate from the global pool of the camera threads
+    QThreadPool m_threadPool;
+    std::vector<QFuture<void> > m_workers;
+    // Protects the slots, the round robin position and the busy flags
+    QMutex m_mutex;
+    // Signaled on new data and when a step finishes
+    QWaitCondition m_wakeCondition;
+    QWaitCondition m_stepCondition;
+    std::vector<sSlot> m_slots;
+    size_t m_nextSlot;
+    // Number of sleeping workers, producers only signal if it is non zero
+    std::atomic<int> m_idleCnt;
+};
+
+#endif // PROCESSINGPOOL_H
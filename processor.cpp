@@ -6,18 +6,50 @@
 
 #include <assert.h>
 
+#include <limits>
+#include <random>
 #include <sstream>
 
+#include "eventdecoder.h"
+#include "processingpool.h"
+#include "temporalsmoothing.h"
+
 
 Processor::Processor():
     m_timewindow(TIME_WINDOW_US),
     m_updateStatsInterval(UPDATE_INTERVAL_COMP_US)
 {
     m_newFrameAvailable = false;
+    m_rawFrameCnt = 0;
+    m_convertedFrameCnt = 0;
+    m_frameViewerActive = true;
     m_nextId = 0;
 
     m_currProcFPS = 0;
     m_currFrameFPS = 0;
+    m_detectTimeUs = 0;
+    m_tickJitterAvgUs = 0;
+    m_tickJitterMaxUs = 0;
+    m_consumerWaiting = false;
+    m_isRunning = false;
+    m_pool = NULL;
+    m_fallReciever = NULL;
+    m_processedCnt = 0;
+    m_fallCnt = 0;
+    m_detector = settings.detector;
+    m_activeDetector = settings.detector;
+    m_sparseCrossover = 0;
+    m_sparseStepCnt = m_detectStepCnt = 0;
+    m_vectorizedSmoothing = false;
+    m_pyrScale = 1;
+    m_pyrSigma = 1;
+    m_benchmarkDetectors = false;
+    m_benchShadowDetector = DETECTOR_DENSE;
+    m_benchStepCnt = m_benchBoxCnt = 0;
+    m_benchActiveTimeUs = m_benchShadowTimeUs = m_benchIoUSum = 0;
+
+    m_eventQueue.setup(EVENT_QUEUE_CAPACITY);
+    m_eventBatch.resize(EVENT_QUEUE_BATCH_SZ);
 
 #if FALL_DETECTOR_POSTCLASSIFY_HUMANS
     if(!m_cascadeClassifier.load("cascade.xml")) {
@@ -27,50 +59,149 @@ Processor::Processor():
 #endif
 
 }
-void Processor::start(uint16_t sx, uint16_t sy)
+void Processor::start(uint16_t sx, uint16_t sy, ProcessingPool *pool)
 {
     if(m_isRunning)
         stop();
 
-    // Clear event queue
-    {
-        QMutexLocker locker(&m_queueMutex);
-        while (!m_eventQueue.empty())
-            m_eventQueue.pop();
-    }
+    // Clear event queue, no producer is active at this point
+    m_eventQueue.clear();
 
     m_sx = sx;
     m_sy = sy;
-    m_currFrame = QImage(sx,sy,QImage::Format_Grayscale8);
-    m_currFrame.fill(0);
+    {
+        QMutexLocker convertLocker(&m_convertMutex);
+        QMutexLocker locker(&m_frameMutex);
+        m_currFrame = QImage(sx,sy,QImage::Format_Grayscale8);
+        m_currFrame.fill(0);
+        m_backFrame = QImage(sx,sy,QImage::Format_Grayscale8);
+        m_rawFrame.reset();
+        m_rawFrameCnt = m_convertedFrameCnt = 0;
+    }
+
+    m_binning = settings.binning;
+    if(m_binning != 1 && m_binning != 2 && m_binning != 4) {
+        printf("Invalid binning factor %d, binning disabled.\n",m_binning);
+        m_binning = 1;
+    }
+    m_binningShift = m_binning == 4 ? 2 : m_binning - 1;
+    m_binnedSx = (sx + m_binning - 1) >> m_binningShift;
+    m_binnedSy = (sy + m_binning - 1) >> m_binningShift;
+    // Geometric detection parameters are defined for sensor coordinates
+    m_borderH = TRACK_IMG_BORDER_SIZE_HORIZONTAL/m_binning;
+    m_borderV = TRACK_IMG_BORDER_SIZE_VERTICAL/m_binning;
+    m_minArea = TRACK_MIN_AREA/(m_binning*m_binning);
+    m_gaussSigma = qMax(1,TRACK_BOX_DETECTOR_GAUSS_SIGMA/m_binning);
+    // Person sized blobs are much larger than the kernel, the blur still covers
+    // at least one pixel on the pyramid level
+    m_pyrScale = 1 << TRACK_PYRAMID_LEVEL;
+    while(m_pyrScale > 1 && m_gaussSigma < m_pyrScale)
+        m_pyrScale >>= 1;
+    m_pyrSigma = (float)m_gaussSigma/m_pyrScale;
 
-    m_eventBuffer.setup(m_timewindow,sx,sy);
+    m_eventBuffer.setup(m_timewindow,m_binnedSx,m_binnedSy);
+    m_timeSurface.setup(m_binnedSx,m_binnedSy,qMax(1,TIME_SURFACE_CELL_SZ/m_binning),
+                        TIME_SURFACE_TAU_US,TIME_SURFACE_PIXEL_REFRACTORY_US);
+    m_activeDetector = (tDetector)m_detector.load();
     m_stats.clear();
+    m_smoothBufferImg = cv::Mat();
+    m_pyrSmoothImg = cv::Mat();
+    m_pyrPrevSmoothImg = cv::Mat();
+    m_vectorizedSmoothing = checkSmoothAndThreshold();
+    if(!m_vectorizedSmoothing)
+        printf("Vectorized temporal smoothing differs from the original blend and threshold, using the scalar kernel.\n");
+    setupSparseDetector();
+
+    m_benchmarkDetectors = settings.benchmark_detectors;
+    m_benchStepCnt = m_benchBoxCnt = 0;
+    m_benchActiveTimeUs = m_benchShadowTimeUs = m_benchIoUSum = 0;
 
     m_currFrameFPS = 0;
     m_currProcFPS = 0;
+    m_detectTimeUs = 0;
+    m_tickJitterAvgUs = 0;
+    m_tickJitterMaxUs = 0;
     m_nextId = 0;
     m_newFrameAvailable = false;
+    m_processedCnt = 0;
+    m_fallCnt = 0;
     m_isRunning = true;
 
-    m_future = QtConcurrent::run(this, &Processor::run);
+    m_pool = pool;
+    if(m_pool != NULL) {
+        m_updateStatsTimer.restart();
+        m_pool->addProcessor(this);
+    } else {
+        m_future = QtConcurrent::run(this, &Processor::run);
+    }
 }
 
 void Processor::stop()
 {
+    if(m_pool != NULL) {
+        // Waits until no worker is running a step of this processor
+        m_pool->removeProcessor(this);
+        m_pool = NULL;
+        if(m_isRunning) {
+            m_isRunning = false;
+            printSummary();
+        }
+        return;
+    }
     m_isRunning = false;
+    {
+        QMutexLocker locker(&m_wakeMutex);
+        m_wakeCondition.wakeAll();
+    }
     m_future.waitForFinished();
 }
 
-void Processor::newEvent(const sDVSEventDepacked & event)
+void Processor::newEvent(const sDVSEvent & event)
 {
-    {
-        QMutexLocker locker(&m_queueMutex);
-        m_eventQueue.push(event);
+    // Drops the event if the queue is full, never blocks the camera thread
+    m_eventQueue.push(event);
+    wakeConsumer();
+}
+
+void Processor::newEvents(const sDVSEvent *events, size_t cnt)
+{
+    m_eventQueue.push(events,cnt);
+    wakeConsumer();
+}
+
+void Processor::wakeConsumer()
+{
+    if(m_pool != NULL) {
+        m_pool->wake();
+        return;
+    }
+    // Orders the queue insertion before reading the flag, see waitForWork
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_consumerWaiting.load(std::memory_order_relaxed)) {
+        QMutexLocker locker(&m_wakeMutex);
+        m_wakeCondition.wakeOne();
+    }
+}
+
+void Processor::waitForWork()
+{
+    qint64 remainingUs = m_updateStatsInterval - m_updateStatsTimer.nsecsElapsed()/1000;
+    if(remainingUs <= 0)
+        return;
+
+    QMutexLocker locker(&m_wakeMutex);
+    m_consumerWaiting.store(true, std::memory_order_relaxed);
+    // Orders the flag before checking for data. Either the producer sees the flag
+    // and signals after we wait (it needs the mutex), or we see its data here.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_isRunning && m_eventQueue.empty() && !m_newFrameAvailable) {
+        // Round up to not wake before the deadline
+        m_wakeCondition.wait(&m_wakeMutex,(remainingUs+999)/1000);
     }
+    m_consumerWaiting.store(false, std::memory_order_relaxed);
 }
 
-void Processor::newFrame(const caerFrameEvent &frame)
+void Processor::newFrame(const tFrameRef &frame)
 {
     if(frame->lengthX != m_sx ||
             frame->lengthY != m_sy) {
@@ -78,15 +209,40 @@ void Processor::newFrame(const caerFrameEvent &frame)
         return;
     }
     {
+        // The previous frame is released if it was never requested
         QMutexLocker locker(&m_frameMutex);
         m_newFrameAvailable = true;
-        // Convert to qt image
-        uchar* ptr = m_currFrame.bits();
-        u_int16_t* inPtr = frame->pixels;
-        for(int i = 0; i < m_sx*m_sy; i++) {
-            ptr[i] = inPtr[i]>>8;
-        }
+        m_rawFrame = frame;
+        m_rawFrameCnt++;
+    }
+    wakeConsumer();
+}
+
+void Processor::updateFrameImage()
+{
+    QMutexLocker convertLocker(&m_convertMutex);
+    tFrameRef frame;
+    uint64_t frameCnt;
+    {
+        QMutexLocker locker(&m_frameMutex);
+        if(m_rawFrameCnt == m_convertedFrameCnt || !m_rawFrame)
+            return;
+        frame = m_rawFrame;
+        frameCnt = m_rawFrameCnt;
+    }
+
+    // Lines of the image are padded to 4 bytes
+    const uint16_t* in = frame->pixels;
+    if(m_backFrame.bytesPerLine() == m_sx) {
+        convertFramePixels(in,m_backFrame.bits(),(size_t)m_sx*m_sy);
+    } else {
+        for(int y = 0; y < m_sy; y++)
+            convertFramePixels(in + (size_t)y*m_sx,m_backFrame.scanLine(y),m_sx);
     }
+
+    QMutexLocker locker(&m_frameMutex);
+    m_currFrame.swap(m_backFrame);
+    m_convertedFrameCnt = frameCnt;
 }
 
 void Processor::run()
@@ -97,57 +253,188 @@ void Processor::run()
         // Check if anything has to be done
         // New events available ?
         // New frames avalibale ?
-        // Only sleep if we don't have to process the data
-        if(m_eventQueue.size() == 0 && !m_newFrameAvailable) {
-            // Don't waist resources: Sleep until next update step
-            QThread::usleep(qMax(0LL,m_updateStatsInterval-m_updateStatsTimer.nsecsElapsed()/1000));
+        // Only wait if we don't have to process the data
+        if(m_eventQueue.empty() && !m_newFrameAvailable) {
+            // Don't waist resources: Block until new data arrives or the next update step is due
+            waitForWork();
         }
+        step();
+    }
+    printSummary();
+}
 
-        // Process events and add them to the buffer
-        // Remove old ones if necessary
-        if(m_eventQueue.size()>0) {
-            QMutexLocker locker(&m_queueMutex);
-            m_eventBuffer.addEvents(m_eventQueue);
-        }
-        // Recompute buffer stats
-        if(m_updateStatsTimer.nsecsElapsed()/1000 > m_updateStatsInterval) {
-
-            m_currProcFPS = (1.0f-FPS_LOWPASS_FILTER_COEFF)*m_currProcFPS +
-                            FPS_LOWPASS_FILTER_COEFF*1000.0f/m_updateStatsTimer.elapsed();
-            uint64_t elapsedTime = m_updateStatsTimer.nsecsElapsed()/1000;
-            m_updateStatsTimer.restart();
-            updateStatistics(elapsedTime);
+bool Processor::hasWork()
+{
+    return !m_eventQueue.empty() || m_newFrameAvailable || getTimeToNextUpdateUs() < 0;
+}
+
+void Processor::step()
+{
+    // Switch the detection engine if requested, all start from an empty state
+    tDetector detector = (tDetector)m_detector.load();
+    if(detector != m_activeDetector) {
+        m_activeDetector = detector;
+        m_timeSurface.clear();
+        m_smoothBufferImg = cv::Mat();
+        m_pyrPrevSmoothImg = cv::Mat();
+        m_pyrSmoothImg = cv::Mat();
+        m_benchStepCnt = m_benchBoxCnt = 0;
+        m_benchActiveTimeUs = m_benchShadowTimeUs = m_benchIoUSum = 0;
+    }
+
+    // Process events and add them to the buffer
+    // Remove old ones if necessary
+    // Only a limited batch per iteration to not delay the next update step
+    size_t cnt = m_eventQueue.pop(m_eventBatch.data(),m_eventBatch.size());
+    if(cnt > 0) {
+        if(m_binning > 1)
+            binEvents(m_eventBatch.data(),cnt);
+        m_eventBuffer.addEvents(m_eventBatch.data(),cnt);
+        if(m_activeDetector == DETECTOR_TIME_SURFACE)
+            m_timeSurface.addEvents(m_eventBatch.data(),cnt);
+        m_processedCnt.fetch_add(cnt,std::memory_order_relaxed);
+    }
+    // Recompute buffer stats
+    if(m_updateStatsTimer.nsecsElapsed()/1000 > m_updateStatsInterval) {
+
+        m_currProcFPS = (1.0f-FPS_LOWPASS_FILTER_COEFF)*m_currProcFPS +
+                        FPS_LOWPASS_FILTER_COEFF*1000.0f/m_updateStatsTimer.elapsed();
+        uint64_t elapsedTime = m_updateStatsTimer.nsecsElapsed()/1000;
+        m_updateStatsTimer.restart();
+        {
+            QMutexLocker locker(&m_statsMutex);
+            uint32_t jitter = elapsedTime - m_updateStatsInterval;
+            m_tickJitterAvgUs = (1.0f-FPS_LOWPASS_FILTER_COEFF)*m_tickJitterAvgUs +
+                                FPS_LOWPASS_FILTER_COEFF*jitter;
+            m_tickJitterMaxUs = qMax(m_tickJitterMaxUs,jitter);
         }
-        if(m_newFrameAvailable) {
-            {
-                QMutexLocker locker(&m_frameMutex);
-                m_currFrameFPS = (1.0f-FPS_LOWPASS_FILTER_COEFF)*m_currFrameFPS+
-                                 FPS_LOWPASS_FILTER_COEFF*1000.0f/m_frameTimer.elapsed();
-                m_frameTimer.restart();
-                m_newFrameAvailable = false;
-            }
+        updateStatistics(elapsedTime);
+    }
+    if(m_newFrameAvailable) {
+        {
+            QMutexLocker locker(&m_frameMutex);
+            m_currFrameFPS = (1.0f-FPS_LOWPASS_FILTER_COEFF)*m_currFrameFPS+
+                             FPS_LOWPASS_FILTER_COEFF*1000.0f/m_frameTimer.elapsed();
+            m_frameTimer.restart();
+            m_newFrameAvailable = false;
         }
     }
+}
+
+static const char* detectorName(tDetector detector)
+{
+    switch(detector) {
+    case DETECTOR_TIME_SURFACE:
+        return "timesurface";
+    case DETECTOR_PYRAMID:
+        return "pyramid";
+    default:
+        return "dense";
+    }
+}
+
+void Processor::printSummary()
+{
+    printf("Processor stopped. Event queue high-water mark: %zu of %zu, dropped: %zu\n",
+           m_eventQueue.getHighWaterMark(), m_eventQueue.capacity(), m_eventQueue.getDroppedCnt());
+    printf("Update step jitter: avg %.0f us, max %u us\n", m_tickJitterAvgUs, m_tickJitterMaxUs);
+    if(m_sparseCrossover > 0 && m_detectStepCnt > 0)
+        printf("Sparse detection in %zu of %zu update steps, crossover %zu active pixels\n",
+               m_sparseStepCnt, m_detectStepCnt, m_sparseCrossover);
+    if(m_benchmarkDetectors && m_benchStepCnt > 0) {
+        printf("Detector benchmark over %zu update steps: %s %.1f us, %s %.1f us, mean box IoU %.3f over %zu boxes\n",
+               m_benchStepCnt,
+               detectorName(m_activeDetector), m_benchActiveTimeUs/m_benchStepCnt,
+               detectorName(m_benchShadowDetector), m_benchShadowTimeUs/m_benchStepCnt,
+               m_benchBoxCnt > 0 ? m_benchIoUSum/m_benchBoxCnt : 1.0, m_benchBoxCnt);
+    }
+}
+
+void Processor::binEvents(sDVSEvent *events, size_t cnt)
+{
+    for(size_t i = 0; i < cnt; i++) {
+        uint32_t addr = events[i].addr;
+        events[i].addr = dvsEventPackAddr(dvsEventX(addr) >> m_binningShift,
+                                          dvsEventY(addr) >> m_binningShift,
+                                          dvsEventPol(addr));
+    }
+}
 
-    printf("Processor stopped.\n");
+cv::Rect Processor::toBinnedRect(const QRectF &r)
+{
+    int x1 = (int)r.x() >> m_binningShift;
+    int y1 = (int)r.y() >> m_binningShift;
+    int x2 = ((int)(r.x()+r.width()) + m_binning - 1) >> m_binningShift;
+    int y2 = ((int)(r.y()+r.height()) + m_binning - 1) >> m_binningShift;
+    return cv::Rect(x1,y1,x2-x1,y2-y1);
 }
 
 bool compare_rect(const cv::Rect & a, const cv::Rect &b)
 {
     return a.area() > b.area();
 }
-std::vector<cv::Rect> Processor::detect()
+std::vector<cv::Rect> Processor::detect(tDetector detector, bool exportMask)
 {
-    // Compute image of current event buffer
-    m_bufferImg = cv::Mat(cv::Size(m_sx,m_sy), CV_8UC1);
-    m_bufferImg.setTo(cv::Scalar(0));
-    uchar* p;
-    auto & buff = m_eventBuffer.getLockedBuffer();
-    for(sDVSEventDepacked & e:buff) {
-        p = m_bufferImg.ptr<uchar>(e.y,e.x);
-        *p = 255;
+    if(exportMask && m_thresholdImg.isNull())
+        m_thresholdImg = QImage(m_binnedSx,m_binnedSy,QImage::Format_Grayscale8);
+
+    if(detector == DETECTOR_PYRAMID) {
+        computePyramidMask();
+        if(exportMask) {
+            cv::Mat thresholdImg(m_binnedSy,m_binnedSx,CV_8UC1,
+                                 m_thresholdImg.bits(),m_thresholdImg.bytesPerLine());
+            cv::resize(m_pyrImg,thresholdImg,thresholdImg.size(),0,0,cv::INTER_NEAREST);
+        }
+        // Only the cells at the box edges are evaluated on the binned grid
+        std::vector<cv::Rect> boxes = findBoxes(m_pyrImg);
+        for(size_t i = 0; i < boxes.size(); i++)
+            boxes[i] = refinePyramidBox(boxes[i]);
+        return selectBoxes(boxes);
+    }
+
+    cv::Rect roi(0,0,m_bufferImg.cols,m_bufferImg.rows);
+    bool maskExported = false;
+    if(detector == DETECTOR_TIME_SURFACE) {
+        computeTimeSurfaceMask();
+    } else {
+        // Nearly empty scenes are cheaper to splat than to blur, the mask is the same
+        bool sparse = m_sparseCrossover > 0 && m_eventBuffer.getPixelView().activeCnt < m_sparseCrossover;
+        if(sparse) {
+            roi = computeSparseMask();
+        } else {
+            // The dense path exports the mask in the same pass
+            computeDenseMask(exportMask);
+            maskExported = true;
+        }
+        // Only the steps of the active detector are counted
+        if(exportMask) {
+            m_detectStepCnt++;
+            if(sparse)
+                m_sparseStepCnt++;
+        }
     }
-    m_eventBuffer.releaseLockedBuffer();
+
+    // The rows of the threshold image are padded to 4 bytes
+    if(exportMask && !maskExported) {
+        for(int y = 0; y < m_bufferImg.rows; y++)
+            memcpy(m_thresholdImg.scanLine(y),m_bufferImg.ptr(y),m_bufferImg.cols);
+    }
+
+    std::vector<cv::Rect> boxes;
+    if(roi.area() > 0) {
+        // Components are only searched in the region with mask pixels
+        cv::Mat mask = m_bufferImg(roi);
+        boxes = findBoxes(mask);
+        for(size_t i = 0; i < boxes.size(); i++) {
+            boxes[i].x += roi.x;
+            boxes[i].y += roi.y;
+        }
+    }
+    return selectBoxes(boxes);
+}
+
+void Processor::computeDenseMask(bool exportMask)
+{
     // Perform opening if requrested
 #if TRACK_OPENING_KERNEL_SZ > 1
     cv::Mat element = cv::getStructuringElement( cv::MORPH_OPEN, cv::Size( TRACK_OPENING_KERNEL_SZ, TRACK_OPENING_KERNEL_SZ ));
@@ -155,80 +442,448 @@ std::vector<cv::Rect> Processor::detect()
 #endif
     // Blur image
     cv::GaussianBlur(m_bufferImg,m_bufferImg,
-                     cv::Size(TRACK_BOX_DETECTOR_GAUSS_KERNEL_SZ,TRACK_BOX_DETECTOR_GAUSS_KERNEL_SZ),
-                     TRACK_BOX_DETECTOR_GAUSS_SIGMA,TRACK_BOX_DETECTOR_GAUSS_SIGMA,cv::BORDER_REPLICATE);
+                     cv::Size(2*m_gaussSigma+1,2*m_gaussSigma+1),
+                     m_gaussSigma,m_gaussSigma,cv::BORDER_REPLICATE);
 
     if(m_smoothBufferImg.empty()) {
-        m_smoothBufferImg = m_bufferImg;
+        // The buffer image is reused between updates, don't share its memory
+        m_smoothBufferImg = m_bufferImg.clone();
         m_smoothBufferImg.setTo(0);
     }
 
-    // Overwrite smoothbuffer and current buffer in a single pass
-    uchar* bPtr = m_bufferImg.ptr();
-    uchar* sPtr = m_smoothBufferImg.ptr();
+    // Overwrite smoothbuffer and current buffer with the thresholded result
+    // and export the mask in a single pass, row by row for the padded threshold image
+    for(int y = 0; y < m_bufferImg.rows; y++) {
+        uchar* preview = exportMask ? m_thresholdImg.scanLine(y) : NULL;
+        smoothAndThreshold(m_bufferImg.ptr(y),m_smoothBufferImg.ptr(y),m_bufferImg.ptr(y),preview,
+                           m_bufferImg.cols,(uint8_t)TRACK_BOX_DETECTOR_THRESHOLD,m_vectorizedSmoothing);
+    }
+    // The whole smoothed buffer may be non zero for the next sparse step
+    m_sparseRoi = cv::Rect(0,0,m_bufferImg.cols,m_bufferImg.rows);
+}
+
+cv::Rect Processor::computeSparseMask()
+{
+    int w = m_bufferImg.cols, h = m_bufferImg.rows;
+    int r = m_gaussSigma, kernelSz = 2*m_gaussSigma+1;
+
+    if(m_smoothBufferImg.empty()) {
+        m_smoothBufferImg = cv::Mat::zeros(h,w,CV_8UC1);
+        m_sparseRoi = cv::Rect();
+    }
+
+    // Opening: Pixels with a fully active structuring element survive the erosion,
+    // the dilation marks their neighbourhood once. Pixels outside the image
+    // don't affect either operation, like in cv::morphologyEx.
+    const uchar* occ = m_bufferImg.ptr();
+    uchar* openPtr = m_openImg.ptr();
+    m_openedPixels.clear();
+    for(int i = 0; i < w*h; i += 8) {
+        // Skip empty blocks of the occupancy image
+        int blockSz = qMin(8,w*h - i);
+        uint64_t block = 0;
+        memcpy(&block,occ + i,blockSz);
+        if(block == 0)
+            continue;
+        for(int p = i; p < i + blockSz; p++) {
+            if(!occ[p])
+                continue;
+#if TRACK_OPENING_KERNEL_SZ > 1
+            int x = p % w, y = p / w;
+            bool eroded = true;
+            for(const cv::Point &o: m_openOffsets) {
+                int nx = x + o.x, ny = y + o.y;
+                if(nx >= 0 && nx < w && ny >= 0 && ny < h && !occ[ny*w + nx]) {
+                    eroded = false;
+                    break;
+                }
+            }
+            if(!eroded)
+                continue;
+            for(const cv::Point &o: m_openOffsets) {
+                int nx = x - o.x, ny = y - o.y;
+                if(nx >= 0 && nx < w && ny >= 0 && ny < h && !openPtr[ny*w + nx]) {
+                    openPtr[ny*w + nx] = 1;
+                    m_openedPixels.push_back(ny*w + nx);
+                }
+            }
+#else
+            m_openedPixels.push_back(p);
+#endif
+        }
+    }
+
+    // Accumulate the footprints of the opened pixels
+    int minX = w, minY = h, maxX = -1, maxY = -1;
+    std::vector<float> wx(kernelSz);
+    for(int p: m_openedPixels) {
+        openPtr[p] = 0;
+        int x = p % w, y = p / w;
+        int x0 = qMax(0,x - r), x1 = qMin(w - 1,x + r);
+        int y0 = qMax(0,y - r), y1 = qMin(h - 1,y + r);
+        minX = qMin(minX,x0);
+        minY = qMin(minY,y0);
+        maxX = qMax(maxX,x1);
+        maxY = qMax(maxY,y1);
 
-    for(int i = 0; i < m_bufferImg.cols*m_bufferImg.rows; i++) {
-        *bPtr = TRACK_BOX_TEMPORAL_SMOOTHING*(*bPtr)+(1-TRACK_BOX_TEMPORAL_SMOOTHING)*(*sPtr);
-        *sPtr = *bPtr;
-        bPtr++;
-        sPtr++;
+        if(x > 0 && x < w - 1 && y > 0 && y < h - 1) {
+            for(int yy = y0; yy <= y1; yy++) {
+                float* acc = m_splatImg.ptr<float>(yy) + x0;
+                const float* fp = &m_splatFootprint[(yy - y + r)*kernelSz + x0 - x + r];
+                for(int xx = x0; xx <= x1; xx++)
+                    *acc++ += *fp++;
+            }
+        } else {
+            // Border pixels are replicated by the blur, they also
+            // receive the weights of all kernel taps outside the image
+            const std::vector<float> &kx = (x == 0 || x == w - 1) ? m_gaussKernelCum : m_gaussKernel;
+            const std::vector<float> &ky = (y == 0 || y == h - 1) ? m_gaussKernelCum : m_gaussKernel;
+            for(int xx = x0; xx <= x1; xx++)
+                wx[xx - x0] = kx[r - std::abs(xx - x)];
+            for(int yy = y0; yy <= y1; yy++) {
+                float* acc = m_splatImg.ptr<float>(yy) + x0;
+                float wy = 255.0f*ky[r - std::abs(yy - y)];
+                for(int xx = x0; xx <= x1; xx++)
+                    *acc++ += wy*wx[xx - x0];
+            }
+        }
+    }
+
+    cv::Rect roi = m_sparseRoi;
+    if(maxX >= 0) {
+        cv::Rect splatRect(minX,minY,maxX - minX + 1,maxY - minY + 1);
+        roi = roi.area() > 0 ? (roi | splatRect) : splatRect;
     }
 
-    // Treshold image
-    cv::threshold(m_bufferImg,m_bufferImg,TRACK_BOX_DETECTOR_THRESHOLD,255,CV_THRESH_BINARY);
+    // Same rounding, temporal smoothing and threshold as the dense path, the smoothed
+    // buffer is zero outside of the region and decays to zero inside
+    m_bufferImg.setTo(0);
+    minX = w, minY = h, maxX = -1, maxY = -1;
+    for(int y = roi.y; y < roi.y + roi.height; y++) {
+        float* acc = m_splatImg.ptr<float>(y) + roi.x;
+        uchar* sPtr = m_smoothBufferImg.ptr(y) + roi.x;
+        uchar* bPtr = m_bufferImg.ptr(y) + roi.x;
+        for(int x = 0; x < roi.width; x++) {
+            bPtr[x] = (uchar)qMin(255,(int)(acc[x] + 0.5f));
+            acc[x] = 0;
+        }
+        smoothAndThreshold(bPtr,sPtr,bPtr,NULL,roi.width,
+                           (uint8_t)TRACK_BOX_DETECTOR_THRESHOLD,m_vectorizedSmoothing);
 
-    if(m_thresholdImg.isNull())
-        m_thresholdImg = QImage(m_bufferImg.cols,m_bufferImg.rows,QImage::Format_Grayscale8);
-    memcpy((void*)m_thresholdImg.bits(),(void*)m_bufferImg.ptr(),m_bufferImg.cols*m_bufferImg.rows);
+        // Bounds of the non zero smoothed pixels
+        int x0 = 0, x1 = roi.width - 1;
+        while(x0 <= x1 && !sPtr[x0])
+            x0++;
+        while(x1 >= x0 && !sPtr[x1])
+            x1--;
+        if(x0 <= x1) {
+            minX = qMin(minX,roi.x + x0);
+            maxX = qMax(maxX,roi.x + x1);
+            minY = qMin(minY,y);
+            maxY = y;
+        }
+    }
+    m_sparseRoi = maxX >= 0 ? cv::Rect(minX,minY,maxX - minX + 1,maxY - minY + 1) : cv::Rect();
+    return roi;
+}
 
-    // Find outline contours only
-    std::vector<std::vector<cv::Point> > contours;
-    cv::findContours(m_bufferImg,contours,CV_RETR_EXTERNAL,CV_CHAIN_APPROX_SIMPLE);
+void Processor::setupSparseDetector()
+{
+    m_sparseCrossover = 0;
+    m_sparseStepCnt = m_detectStepCnt = 0;
 
-    // Convert contours to bounding boxes
-    std::vector<cv::Rect> tmpBoxes,tmpBoxes2,bboxes;
-    for(int i = 0; i < contours.size(); i++) {
-        cv::Rect r=cv::boundingRect(contours.at(i));
-        tmpBoxes.push_back(r);
+    // Same kernel as the dense path, the box refinement of the pyramid path also uses it
+    int kernelSz = 2*m_gaussSigma+1;
+    cv::Mat kernel = cv::getGaussianKernel(kernelSz,m_gaussSigma,CV_32FC1);
+    m_gaussKernel.resize(kernelSz);
+    m_gaussKernelCum.resize(kernelSz);
+    float sum = 0;
+    for(int i = 0; i < kernelSz; i++) {
+        m_gaussKernel[i] = kernel.at<float>(i,0);
+        sum += m_gaussKernel[i];
+        m_gaussKernelCum[i] = sum;
     }
+#if TRACK_SPARSE_DETECTOR
+    int w = m_binnedSx, h = m_binnedSy;
 
-    // Remove BBox inside others
-    size_t i, j;
-    for (i=0; i<tmpBoxes.size(); i++) {
-        cv::Rect r = tmpBoxes[i];
-        for (j=0; j<tmpBoxes.size(); j++)
-            if (j!=i && (r & tmpBoxes[j])==r)
+    // Same structuring element as the dense path
+    m_openOffsets.clear();
+#if TRACK_OPENING_KERNEL_SZ > 1
+    cv::Mat element = cv::getStructuringElement( cv::MORPH_OPEN, cv::Size( TRACK_OPENING_KERNEL_SZ, TRACK_OPENING_KERNEL_SZ ));
+    for(int y = 0; y < element.rows; y++)
+        for(int x = 0; x < element.cols; x++)
+            if(element.at<uchar>(y,x))
+                m_openOffsets.push_back(cv::Point(x - element.cols/2,y - element.rows/2));
+#endif
+    m_splatFootprint.resize(kernelSz*kernelSz);
+    for(int j = 0; j < kernelSz; j++)
+        for(int i = 0; i < kernelSz; i++)
+            m_splatFootprint[j*kernelSz + i] = 255.0f*m_gaussKernel[j]*m_gaussKernel[i];
+
+    m_splatImg = cv::Mat::zeros(h,w,CV_32FC1);
+    m_openImg = cv::Mat::zeros(h,w,CV_8UC1);
+
+    // Microbenchmark: The dense path costs the same for every image, the sparse path
+    // has a fixed cost and a cost per active pixel. Blobs of 8x8 pixels survive the opening.
+    cv::Mat emptyImg = cv::Mat::zeros(h,w,CV_8UC1);
+    cv::Mat blobImg = cv::Mat::zeros(h,w,CV_8UC1);
+    std::minstd_rand rng(1);
+    for(int i = 0; i < w*h/(8*64); i++) {
+        int bx = rng() % qMax(1,w - 8), by = rng() % qMax(1,h - 8);
+        blobImg(cv::Rect(bx,by,qMin(8,w),qMin(8,h))).setTo(255);
+    }
+    size_t blobPixelCnt = 0;
+    for(int i = 0; i < w*h; i++)
+        if(blobImg.ptr()[i])
+            blobPixelCnt++;
+
+    auto timePath = [&](const cv::Mat &occupancy, bool sparse) {
+        qint64 best = std::numeric_limits<qint64>::max();
+        for(int run = 0; run < TRACK_SPARSE_CALIBRATION_RUNS; run++) {
+            occupancy.copyTo(m_bufferImg);
+            m_smoothBufferImg = cv::Mat::zeros(h,w,CV_8UC1);
+            m_sparseRoi = cv::Rect();
+            QElapsedTimer timer;
+            timer.start();
+            if(sparse)
+                computeSparseMask();
+            else
+                computeDenseMask(false);
+            best = qMin(best,timer.nsecsElapsed());
+        }
+        return best/1000.0;
+    };
+    double denseUs = timePath(blobImg,false);
+    double sparseFixedUs = timePath(emptyImg,true);
+    double sparsePixelUs = (timePath(blobImg,true) - sparseFixedUs)/qMax((size_t)1,blobPixelCnt);
+
+    if(denseUs > sparseFixedUs)
+        m_sparseCrossover = sparsePixelUs > 0 ? (denseUs - sparseFixedUs)/sparsePixelUs : blobPixelCnt;
+    m_sparseCrossover = qMin(m_sparseCrossover,(size_t)(w*h));
+    printf("Sparse detection below %zu active pixels (dense %.0f us, sparse %.0f us + %.3f us per pixel)\n",
+           m_sparseCrossover, denseUs, sparseFixedUs, sparsePixelUs);
+
+    m_smoothBufferImg = cv::Mat();
+    m_sparseRoi = cv::Rect();
+#endif
+}
+
+void Processor::computeTimeSurfaceMask()
+{
+    // The surface already contains the temporal smoothing,
+    // only the spatial smoothing is applied on the small cell grid
+    m_timeSurface.computeDensity((uint32_t)m_eventBuffer.getCurrTime(),m_densityImg);
+
+    int cellSz = m_timeSurface.getCellSize();
+    float sigma = (float)m_gaussSigma/cellSz;
+    int kernelSz = 2*(int)std::ceil(sigma)+1;
+    if(kernelSz > 1)
+        cv::GaussianBlur(m_densityImg,m_densityImg,cv::Size(kernelSz,kernelSz),
+                         sigma,sigma,cv::BORDER_REPLICATE);
+
+    // Interpolate between cell centers to avoid blocky contours
+    cv::resize(m_densityImg,m_densityUpImg,
+               cv::Size(m_timeSurface.getCellsX()*cellSz,m_timeSurface.getCellsY()*cellSz),
+               0,0,cv::INTER_LINEAR);
+    cv::compare(m_densityUpImg(cv::Rect(0,0,m_binnedSx,m_binnedSy)),
+                TIME_SURFACE_THRESHOLD,m_bufferImg,cv::CMP_GT);
+}
+
+void Processor::computePyramidMask()
+{
+    // Opening on the binned grid, it removes the same thin structures as in the dense path
+#if TRACK_OPENING_KERNEL_SZ > 1
+    cv::Mat element = cv::getStructuringElement( cv::MORPH_OPEN, cv::Size( TRACK_OPENING_KERNEL_SZ, TRACK_OPENING_KERNEL_SZ ));
+    cv::morphologyEx( m_bufferImg, m_bufferImg, cv::MORPH_OPEN, element );
+#endif
+    // Area averaging keeps the fraction of active pixels, the threshold stays the same
+    cv::resize(m_bufferImg,m_pyrImg,
+               cv::Size((m_binnedSx + m_pyrScale - 1)/m_pyrScale,(m_binnedSy + m_pyrScale - 1)/m_pyrScale),
+               0,0,cv::INTER_AREA);
+    int kernelSz = 2*qMax(1,qRound(m_pyrSigma))+1;
+    cv::GaussianBlur(m_pyrImg,m_pyrImg,cv::Size(kernelSz,kernelSz),
+                     m_pyrSigma,m_pyrSigma,cv::BORDER_REPLICATE);
+
+    if(m_pyrSmoothImg.empty()) {
+        m_pyrSmoothImg = m_pyrImg.clone();
+        m_pyrSmoothImg.setTo(0);
+    }
+
+    // The previous state is kept for the refinement of the box edges
+    m_pyrSmoothImg.copyTo(m_pyrPrevSmoothImg);
+    smoothAndThreshold(m_pyrImg.ptr(),m_pyrSmoothImg.ptr(),m_pyrImg.ptr(),NULL,
+                       m_pyrImg.cols*m_pyrImg.rows,(uint8_t)TRACK_BOX_DETECTOR_THRESHOLD,m_vectorizedSmoothing);
+}
+
+std::vector<cv::Rect> Processor::findBoxes(const cv::Mat &mask)
+{
+    // Bounding boxes of all 8-connected blobs in a single pass
+    const std::vector<ComponentLabeler::sComponent> &components = m_labeler.label(mask);
+
+    // Sort by area, a box can only lie inside a box of at least the same size
+    m_componentOrder.resize(components.size());
+    for(size_t i = 0; i < components.size(); i++)
+        m_componentOrder[i] = i;
+    std::stable_sort(m_componentOrder.begin(),m_componentOrder.end(),[&](int a, int b) {
+        return components[a].bbox.area() > components[b].bbox.area();
+    });
+
+    // Remove BBox inside others. Boxes inside a removed box are also inside
+    // the kept box containing it, so only the kept boxes are compared.
+    // Smaller boxes than the N biggest ones are never used.
+    std::vector<cv::Rect> boxes;
+    for(size_t i = 0; i < m_componentOrder.size() && boxes.size() < TRACK_BIGGEST_N_BOXES; i++) {
+        const cv::Rect &r = components[m_componentOrder[i]].bbox;
+        size_t j;
+        for(j = 0; j < boxes.size(); j++)
+            if((r & boxes[j]) == r)
                 break;
-        if (j==tmpBoxes.size()) {
-            tmpBoxes2.push_back(r);
+        if(j == boxes.size())
+            boxes.push_back(r);
+    }
+    return boxes;
+}
+
+cv::Rect Processor::refinePyramidBox(const cv::Rect &r)
+{
+    const int scale = m_pyrScale;
+    // Cells of the coarse box on the binned grid
+    int x0 = r.x*scale, x1 = qMin((int)m_binnedSx,(r.x + r.width)*scale) - 1;
+    int y0 = r.y*scale, y1 = qMin((int)m_binnedSy,(r.y + r.height)*scale) - 1;
+    if(scale == 1)
+        return cv::Rect(x0,y0,x1 - x0 + 1,y1 - y0 + 1);
+
+    // The real edge lies within about one cell of the coarse edge. Each edge is searched
+    // in a strip of two cells along the whole box, also extended by one cell.
+    const cv::Rect img(0,0,m_binnedSx,m_binnedSy);
+    const int ext = scale;
+    cv::Rect vertical(0,y0 - ext,2*scale,y1 - y0 + 1 + 2*ext);
+    cv::Rect horizontal(x0 - ext,0,x1 - x0 + 1 + 2*ext,2*scale);
+    int left = x0, right = x1, top = y0, bottom = y1;
+
+    // Coarse edges are kept if the strip has no mask pixels
+    cv::Rect bounds;
+    vertical.x = x0 - scale;
+    if(computeStripMask(vertical & img,bounds))
+        left = bounds.x;
+    vertical.x = x1 + 1 - scale;
+    if(computeStripMask(vertical & img,bounds))
+        right = bounds.x + bounds.width - 1;
+    horizontal.y = y0 - scale;
+    if(computeStripMask(horizontal & img,bounds))
+        top = bounds.y;
+    horizontal.y = y1 + 1 - scale;
+    if(computeStripMask(horizontal & img,bounds))
+        bottom = bounds.y + bounds.height - 1;
+
+    left = qBound(0,left,m_binnedSx - 1);
+    top = qBound(0,top,m_binnedSy - 1);
+    right = qBound(left,right,m_binnedSx - 1);
+    bottom = qBound(top,bottom,m_binnedSy - 1);
+    return cv::Rect(left,top,right - left + 1,bottom - top + 1);
+}
+
+bool Processor::computeStripMask(const cv::Rect &strip, cv::Rect &bounds)
+{
+    if(strip.area() <= 0)
+        return false;
+
+    // Separable blur with the dense kernel, only the pixels of the strip are computed.
+    // The occupancy around the strip is read like in the blur of the whole image,
+    // rows and columns outside of the image are replicated.
+    const int r = m_gaussSigma;
+    m_stripCols.resize(strip.width + 2*r);
+    for(int i = 0; i < (int)m_stripCols.size(); i++)
+        m_stripCols[i] = qBound(0,strip.x + i - r,m_binnedSx - 1);
+    m_stripRows.create(strip.height + 2*r,strip.width,CV_32FC1);
+    for(int y = 0; y < m_stripRows.rows; y++) {
+        const uchar* src = m_bufferImg.ptr(qBound(0,strip.y + y - r,m_binnedSy - 1));
+        float* dst = m_stripRows.ptr<float>(y);
+        for(int x = 0; x < strip.width; x++) {
+            const int* cols = &m_stripCols[x];
+            float acc = 0;
+            for(int k = 0; k <= 2*r; k++)
+                acc += m_gaussKernel[k]*src[cols[k]];
+            dst[x] = acc;
+        }
+    }
+    m_stripImg.create(strip.height,strip.width,CV_8UC1);
+    for(int y = 0; y < strip.height; y++) {
+        uchar* dst = m_stripImg.ptr(y);
+        for(int x = 0; x < strip.width; x++) {
+            float acc = 0;
+            for(int k = 0; k <= 2*r; k++)
+                acc += m_gaussKernel[k]*m_stripRows.at<float>(y + k,x);
+            dst[x] = (uchar)qMin(255,(int)(acc + 0.5f));
+        }
+    }
+
+    // The previous temporal smoothing state is only known on the pyramid level,
+    // it is interpolated between the cell centers like cv::INTER_LINEAR
+    const cv::Mat &prev = m_pyrPrevSmoothImg;
+    m_stripState.create(strip.height,strip.width,CV_8UC1);
+    m_stripMask.create(strip.height,strip.width,CV_8UC1);
+    if(prev.empty())
+        m_stripState.setTo(0);
+    int minX = strip.width, minY = strip.height, maxX = -1, maxY = -1;
+    for(int y = 0; y < strip.height; y++) {
+        float v = qBound(0.0f,(strip.y + y + 0.5f)/m_pyrScale - 0.5f,(float)(prev.rows - 1));
+        int v0 = (int)v, v1 = qMin(v0 + 1,prev.rows - 1);
+        float fv = v - v0;
+        uchar* state = m_stripState.ptr(y);
+        for(int x = 0; x < strip.width && !prev.empty(); x++) {
+            float u = qBound(0.0f,(strip.x + x + 0.5f)/m_pyrScale - 0.5f,(float)(prev.cols - 1));
+            int u0 = (int)u, u1 = qMin(u0 + 1,prev.cols - 1);
+            float fu = u - u0;
+            float top = (1 - fu)*prev.at<uchar>(v0,u0) + fu*prev.at<uchar>(v0,u1);
+            float bottom = (1 - fu)*prev.at<uchar>(v1,u0) + fu*prev.at<uchar>(v1,u1);
+            state[x] = (uchar)qRound((1 - fv)*top + fv*bottom);
+        }
+        // Same blend and threshold as the dense path, the state is a temporary copy
+        uchar* mask = m_stripMask.ptr(y);
+        smoothAndThreshold(m_stripImg.ptr(y),state,mask,NULL,strip.width,
+                           (uint8_t)TRACK_BOX_DETECTOR_THRESHOLD,m_vectorizedSmoothing);
+        for(int x = 0; x < strip.width; x++) {
+            if(mask[x]) {
+                minX = qMin(minX,x);
+                maxX = qMax(maxX,x);
+                minY = qMin(minY,y);
+                maxY = y;
+            }
         }
     }
+    if(maxX < 0)
+        return false;
+    bounds = cv::Rect(strip.x + minX,strip.y + minY,maxX - minX + 1,maxY - minY + 1);
+    return true;
+}
+
+std::vector<cv::Rect> Processor::selectBoxes(std::vector<cv::Rect> &boxes)
+{
+    std::vector<cv::Rect> bboxes;
 
     // Sort by area
-    sort( tmpBoxes2.begin(), tmpBoxes2.end(), compare_rect );
+    sort( boxes.begin(), boxes.end(), compare_rect );
     // Check if the found bounding box is entirely located around the image border
-    cv::Rect imgWithoutBorder(TRACK_IMG_BORDER_SIZE_HORIZONTAL,TRACK_IMG_BORDER_SIZE_VERTICAL,
-                              m_bufferImg.cols-2*TRACK_IMG_BORDER_SIZE_HORIZONTAL,
-                              m_bufferImg.rows-2*TRACK_IMG_BORDER_SIZE_VERTICAL);
+    cv::Rect imgWithoutBorder(m_borderH,m_borderV,
+                              m_binnedSx-2*m_borderH,
+                              m_binnedSy-2*m_borderV);
 
-    for(int i = 0; i < qMin((int)tmpBoxes2.size(), TRACK_BIGGEST_N_BOXES); i++) {
-        cv::Rect r=tmpBoxes2.at(i);
+    for(int i = 0; i < qMin((int)boxes.size(), TRACK_BIGGEST_N_BOXES); i++) {
+        cv::Rect r=boxes.at(i);
         // Expand bounding box
         r.x = qMax(0.0,r.x-r.width*(TRACK_BOX_SCALE-1.0)/2.0);
         r.y = qMax(0.0,r.y-r.height*(TRACK_BOX_SCALE-1.0)/2.0);
-        r.width = qMin(m_sx - r.x - 1.0,r.width*TRACK_BOX_SCALE);
-        r.height = qMin(m_sy - r.y - 1.0,r.height*TRACK_BOX_SCALE);
-        if(r.area() >= TRACK_MIN_AREA && ((r & imgWithoutBorder).area() > 0)) {
-
-            auto & buff = m_eventBuffer.getLockedBuffer();
-            size_t cnt = 0;
-            for(sDVSEventDepacked & e:buff) {
-                if(r.contains(cv::Point(e.x,e.y)))
-                    cnt++;
+        r.width = qMin(m_binnedSx - r.x - 1.0,r.width*TRACK_BOX_SCALE);
+        r.height = qMin(m_binnedSy - r.y - 1.0,r.height*TRACK_BOX_SCALE);
+        if(r.area() >= m_minArea && ((r & imgWithoutBorder).area() > 0)) {
+
+            if(m_sat.getEventCount(r) >= TRACK_MIN_EVENT_CNT) {
+                // Back to sensor coordinates
+                bboxes.push_back(cv::Rect(r.x*m_binning,r.y*m_binning,
+                                          qMin(r.width*m_binning,m_sx-r.x*m_binning-1),
+                                          qMin(r.height*m_binning,m_sy-r.y*m_binning-1)));
             }
-            m_eventBuffer.releaseLockedBuffer();
-            if(cnt >= TRACK_MIN_EVENT_CNT)
-                bboxes.push_back(r);
         }
     }
     return bboxes;
@@ -317,10 +972,25 @@ void Processor::tracking(std::vector<cv::Rect> &bboxes)
 }
 void Processor::updateStatistics(uint32_t elapsedTimeUs)
 {
+    // Copy the incrementally maintained occupancy image of the event buffer
+    // and build the summed area tables for all later region queries
+    // The pixel view is only modified by this thread
+    sPixelView view = m_eventBuffer.getPixelView();
+    cv::Mat occupancy(cv::Size(view.sx,view.sy), CV_8UC1, (void*)view.occupancy);
+    occupancy.copyTo(m_bufferImg);
+    m_sat.compute(view.count,view.occupancy,view.sx,view.sy);
+
     // Update objects with new bounding box
-    std::vector<cv::Rect> bboxes = detect();
+    QElapsedTimer detectTimer;
+    detectTimer.start();
+    std::vector<cv::Rect> bboxes = detect(m_activeDetector,true);
+    float detectTimeUs = detectTimer.nsecsElapsed()/1000.0f;
+    if(m_benchmarkDetectors)
+        benchmarkDetectors(occupancy,bboxes,detectTimeUs);
 
     QMutexLocker locker(&m_statsMutex);
+    m_detectTimeUs = (1.0f-FPS_LOWPASS_FILTER_COEFF)*m_detectTimeUs +
+                     FPS_LOWPASS_FILTER_COEFF*detectTimeUs;
     tracking(bboxes);
 
     for(sObjectStats &stats:m_stats)
@@ -328,64 +998,55 @@ void Processor::updateStatistics(uint32_t elapsedTimeUs)
 
 }
 
+void Processor::benchmarkDetectors(const cv::Mat &occupancy, const std::vector<cv::Rect> &boxes, float detectTimeUs)
+{
+    // The dense and pyramid paths have their own smoothing state and can run as shadow,
+    // the time surface is only updated while it is the active detector
+    m_benchShadowDetector = m_activeDetector == DETECTOR_DENSE ? DETECTOR_PYRAMID : DETECTOR_DENSE;
+    occupancy.copyTo(m_bufferImg);
+
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<cv::Rect> shadowBoxes = detect(m_benchShadowDetector,false);
+    m_benchShadowTimeUs += timer.nsecsElapsed()/1000.0;
+    m_benchActiveTimeUs += detectTimeUs;
+    m_benchStepCnt++;
+
+    // Each box is matched with the best overlapping box of the other detector,
+    // surplus boxes of either detector count with zero overlap
+    for(const cv::Rect &a: boxes) {
+        double bestIoU = 0;
+        for(const cv::Rect &b: shadowBoxes) {
+            int intersection = (a & b).area();
+            bestIoU = qMax(bestIoU,(double)intersection/(a.area() + b.area() - intersection));
+        }
+        m_benchIoUSum += bestIoU;
+    }
+    m_benchBoxCnt += qMax(boxes.size(),shadowBoxes.size());
+}
+
 void Processor::updateObjectStats(sObjectStats &st, uint32_t elapsedTimeUs)
 {
-    QPointF tmp, newCenter, newStd, newVelocity;
-    size_t evCnt = 0, usedEvCnt = 0;
+    QPointF newCenter, newStd, newVelocity;
     newCenter.setX(0);
     newCenter.setY(0);
     newStd.setX(0);
     newStd.setY(0);
 
-    cv::Mat maskImg (cv::Size(m_sx,m_sy), CV_8UC1);
-    maskImg.setTo(cv::Scalar(0));
-    maskImg(cv::Rect(st.bbox.x(),st.bbox.y(),st.bbox.width(),st.bbox.height())).setTo(cv::Scalar(255));
-
-    uint32_t currTime = m_eventBuffer.getCurrTime();
-    auto & buff = m_eventBuffer.getLockedBuffer();
+    uint64_t currTime = m_eventBuffer.getCurrTime();
 
-#if FALL_DETECTOR_COMP_STATS_ALL_EVENTS
-    QPointF sum,sumSquared;
-    for(sDVSEventDepacked & e:buff) {
-        if(maskImg.at<uchar>(e.y,e.x) == 0)
-            continue;
-        evCnt++;
-        tmp.setX(e.x);
-        tmp.setY(e.y);
-        sum+=tmp;
-        sumSquared+=QPointF(tmp.x()*tmp.x(),tmp.y()*tmp.y());
-    }
-    if(evCnt > 0) {
-        newCenter = sum/evCnt;
-        newStd = sumSquared / evCnt - QPointF(newCenter.x()*newCenter.x(),newCenter.y()*newCenter.y());
-        newStd = QPointF(qSqrt(newStd.x()),qSqrt(newStd.y()));
-    }
-#else
-    // Mark already used pixels in a new image
-    cv::Mat markImg (cv::Size(m_sx,m_sy), CV_8UC1);
-    markImg.setTo(cv::Scalar(0));
-    QPointF sum,sumSquared;
-    for(sDVSEventDepacked & e:buff) {
-        if(maskImg.at<uchar>(e.y,e.x) == 0)
-            continue;
-        evCnt++;
-        tmp.setX(e.x);
-        tmp.setY(e.y);
-
-        if(markImg.at<uchar>(e.y,e.x) == 0) {
-            markImg.at<uchar>(e.y,e.x) = 255;
-            sum+=tmp;
-            sumSquared+=QPointF(tmp.x()*tmp.x(),tmp.y()*tmp.y());
-            usedEvCnt++;
-        }
-    }
-    if(usedEvCnt > 0) {
-        newCenter = sum/usedEvCnt;
-        newStd = sumSquared / usedEvCnt - QPointF(newCenter.x()*newCenter.x(),newCenter.y()*newCenter.y());
-        newStd = QPointF(qSqrt(newStd.x()),qSqrt(newStd.y()));
+    // Moments of the bounding box from the summed area tables of this update step
+    cv::Rect roi = toBinnedRect(st.bbox);
+    size_t evCnt = m_sat.getEventCount(roi);
+    sMoments m = m_sat.getMoments(roi,FALL_DETECTOR_COMP_STATS_ALL_EVENTS);
+    if(m.n > 0) {
+        newCenter = QPointF((double)m.x/m.n,(double)m.y/m.n);
+        newStd = QPointF((double)m.xx/m.n,(double)m.yy/m.n) - QPointF(newCenter.x()*newCenter.x(),newCenter.y()*newCenter.y());
+        newStd = QPointF(qSqrt(qMax(0.0,newStd.x())),qSqrt(qMax(0.0,newStd.y())));
+        // Back to sensor coordinates, a binned pixel covers m_binning sensor pixels
+        newCenter = newCenter*m_binning + QPointF((m_binning-1)/2.0,(m_binning-1)/2.0);
+        newStd = newStd*m_binning;
     }
-#endif
-    m_eventBuffer.releaseLockedBuffer();
 
     if(st.initialized) {
 
@@ -427,8 +1088,9 @@ void Processor::updateObjectStats(sObjectStats &st, uint32_t elapsedTimeUs)
                 st.fallState = NO_FALL;
             } else if(!st.fallState && m_newFrameAvailable) {
                 if(findFallingPersonInROI(cvRoi)) {
-                    printf("%04u, [Fall]: Delayed detected, Time: %u\n",st.id, currTime);
+                    printf("%04u, [Fall]: Delayed detected, Time: %" PRIu64 "\n",st.id, currTime);
                     st.fallState = FALL_CONFIRMED;
+                    reportFall(st,currTime);
                 }
             }
         } else if(isLocalSpeedMaximum &&
@@ -438,12 +1100,13 @@ void Processor::updateObjectStats(sObjectStats &st, uint32_t elapsedTimeUs)
                   localMaxNormVelocity <= settings.fall_detector_y_speed_max_threshold) {
             st.fallTime = st.timeHistory[FALL_DETECTOR_LOCAL_SPEED_MAX_NEIGHBORHOOD/2];
             if(findFallingPersonInROI(cvRoi)) {
-                printf("%04u, [Fall]: Directly detected, Time: %u, Speed (norm): %f, YCenter: %f\n",st.id, currTime, localMaxNormVelocity,st.centerYHistory[FALL_DETECTOR_LOCAL_SPEED_MAX_NEIGHBORHOOD/2]);
+                printf("%04u, [Fall]: Directly detected, Time: %" PRIu64 ", Speed (norm): %f, YCenter: %f\n",st.id, currTime, localMaxNormVelocity,st.centerYHistory[FALL_DETECTOR_LOCAL_SPEED_MAX_NEIGHBORHOOD/2]);
                 st.fallState = FALL_CONFIRMED;
             } else {
                 st.fallState = FALL_POSSIBLE;
-                printf("%04u, [Fall]: Possibly detected but no human found, Time: %u, Speed (norm): %f, YCenter: %f\n",st.id, currTime,localMaxNormVelocity,st.centerYHistory[FALL_DETECTOR_LOCAL_SPEED_MAX_NEIGHBORHOOD/2]);
+                printf("%04u, [Fall]: Possibly detected but no human found, Time: %" PRIu64 ", Speed (norm): %f, YCenter: %f\n",st.id, currTime,localMaxNormVelocity,st.centerYHistory[FALL_DETECTOR_LOCAL_SPEED_MAX_NEIGHBORHOOD/2]);
             }
+            reportFall(st,currTime);
         }
     } else {
         st.initialized = true;
@@ -454,10 +1117,18 @@ void Processor::updateObjectStats(sObjectStats &st, uint32_t elapsedTimeUs)
     st.evCnt = evCnt;
 }
 
+void Processor::reportFall(const sObjectStats &st, uint64_t time)
+{
+    m_fallCnt.fetch_add(1,std::memory_order_relaxed);
+    if(m_fallReciever != NULL)
+        m_fallReciever->newFall(st.id,time,st.bbox,st.fallState);
+}
+
 bool Processor::findFallingPersonInROI(cv::Rect bbox)
 {
 #if FALL_DETECTOR_POSTCLASSIFY_HUMANS
     std::vector<cv::Rect> detectedObjects;
+    updateFrameImage();
     QMutexLocker locker(&m_frameMutex);
     cv::Mat image(cv::Size(m_currFrame.width(), m_currFrame.height()),
                   CV_8UC1, m_currFrame.bits(), m_currFrame.bytesPerLine());
@@ -11,16 +11,22 @@
 #include <opencv2/opencv.hpp>
 
 #include <atomic>
-#include <queue>
+#include <vector>
 
 #include <libcaer/events/polarity.h>
 #include <libcaer/events/frame.h>
 
 #include "camerahandler.h"
+#include "componentlabeler.h"
 #include "eventbuffer.h"
+#include "spscqueue.h"
+#include "summedareatable.h"
+#include "timesurface.h"
 
 #include "settings.h"
 
+class ProcessingPool;
+
 /**
  * @brief The Processor class handles incoming event and framedata and detects falls.
  */
@@ -38,32 +44,96 @@ public:
     void setSettings(tSettings &settings)
     {
         this->settings = settings;
+        m_detector = settings.detector;
+    }
+    /**
+     * @brief setDetector Selects the detection engine. Can be changed while the processor is running.
+     * @param detector
+     */
+    void setDetector(tDetector detector)
+    {
+        settings.detector = detector;
+        m_detector = detector;
+    }
+    tDetector getDetector()
+    {
+        return (tDetector)m_detector.load();
     }
     /**
-     * @brief start Starts the processing thread and sets the expected frame dimensions
+     * @brief start Starts the processing and sets the expected frame dimensions.
+     * Detection runs on a grid that is reduced by the binning factor from the settings.
      * @param sx
      * @param sy
+     * @param pool Shared workers that run the processing steps,
+     * NULL to start a dedicated processing thread
      */
-    void start(uint16_t sx, uint16_t sy);
+    void start(uint16_t sx, uint16_t sy, ProcessingPool* pool = NULL);
     /**
-     * @brief stop Stops the processing thread.
+     * @brief stop Stops the processing thread or removes the processor from its pool.
      */
     void stop();
+    bool isRunning()
+    {
+        return m_isRunning;
+    }
     /**
      * @brief newEvent Implements callback function of the camera handler to receive events.
      * @param event
      */
-    void newEvent(const sDVSEventDepacked & event);
+    void newEvent(const sDVSEvent & event);
+    /**
+     * @brief newEvents Implements callback function of the camera handler to receive
+     * a whole packet of events with a single queue insertion.
+     * @param events
+     * @param cnt
+     */
+    void newEvents(const sDVSEvent* events, size_t cnt);
     /**
      * @brief newFrame Implements callback function of the camera handler to receive frames.
+     * Only keeps a reference to the raw frame, it is converted when the image is requested.
      * @param frame
      */
-    void newFrame(const caerFrameEvent & frame);
+    void newFrame(const tFrameRef & frame);
+    /**
+     * @brief wantsFrames Implements the frame subscription of the camera handler.
+     * Frames are needed by the human classifier or an active viewer.
+     * @return
+     */
+    bool wantsFrames()
+    {
+        return FALL_DETECTOR_POSTCLASSIFY_HUMANS || m_frameViewerActive;
+    }
+    /**
+     * @brief setFrameViewerActive Subscribes or unsubscribes a viewer of the grayscale frames.
+     * @param active
+     */
+    void setFrameViewerActive(bool active)
+    {
+        m_frameViewerActive = active;
+    }
     /**
      * @brief run Memberfunctions that executes the detection, tracking and evaluation stages.
      * This is called by the launched thread.
      */
     void run();
+    /**
+     * @brief hasWork Returns true if events or frames are queued or the next update step is due.
+     * @return
+     */
+    bool hasWork();
+    /**
+     * @brief getTimeToNextUpdateUs Returns the time until the next update step is due in us.
+     * @return
+     */
+    qint64 getTimeToNextUpdateUs()
+    {
+        return m_updateStatsInterval - m_updateStatsTimer.nsecsElapsed()/1000;
+    }
+    /**
+     * @brief step Moves a batch of queued events into the buffer and runs the update step if it is due.
+     * Called by the processing thread or, one at a time, by the workers of a ProcessingPool.
+     */
+    void step();
     /**
      * @brief getBuffer Returns a reference to the event buffer object.
      * @return
@@ -73,11 +143,12 @@ public:
         return m_eventBuffer;
     }
     /**
-     * @brief getImg Returns the current grayscale frame.
+     * @brief getImg Returns the current grayscale frame. Converts the latest raw frame first.
      * @return
      */
     QImage getImg()
     {
+        updateFrameImage();
         QMutexLocker locker(&m_frameMutex);
         return m_currFrame;
     }
@@ -145,6 +216,23 @@ public:
         }
 
     } sObjectStats;
+
+    class IFallReciever
+    {
+    public:
+        /**
+         * @brief newFall Called by the processing thread when an object is detected as fallen.
+         * @param id Object ID
+         * @param time Event time of the detection in us
+         * @param bbox Bounding box in sensor coordinates
+         * @param state FALL_CONFIRMED or FALL_POSSIBLE if no human was found
+         */
+        virtual void newFall(uint32_t id, uint64_t time, const QRectF &bbox, FallState state)= 0;
+    };
+    void setFallReciever(IFallReciever* reciever)
+    {
+        m_fallReciever = reciever;
+    }
     /**
      * @brief getStats Returns a vector of all tracked / detected objects and their states.
      * @return
@@ -172,6 +260,15 @@ public:
         QMutexLocker locker(&m_statsMutex);
         return m_currProcFPS;
     }
+    /**
+     * @brief getDetectionTimeUs Returns the smoothed computation time of the detection stage in us.
+     * @return
+     */
+    float getDetectionTimeUs()
+    {
+        QMutexLocker locker(&m_statsMutex);
+        return m_detectTimeUs;
+    }
     /**
      * @brief getFrameFPS Returns the current number of grayscale frames per second.
      * @return
@@ -181,6 +278,52 @@ public:
         QMutexLocker locker(&m_frameMutex);
         return m_currFrameFPS;
     }
+    /**
+     * @brief getQueueHighWaterMark Returns the maximum number of events
+     * waiting in the input queue since the last start.
+     * @return
+     */
+    size_t getQueueHighWaterMark()
+    {
+        return m_eventQueue.getHighWaterMark();
+    }
+    /**
+     * @brief getQueueDroppedCnt Returns the number of events dropped
+     * because the input queue was full.
+     * @return
+     */
+    size_t getQueueDroppedCnt()
+    {
+        return m_eventQueue.getDroppedCnt();
+    }
+    /**
+     * @brief getProcessedEventCnt Returns the number of events moved into the buffer since the last start.
+     * @return
+     */
+    size_t getProcessedEventCnt()
+    {
+        return m_processedCnt.load(std::memory_order_relaxed);
+    }
+    /**
+     * @brief getFallCnt Returns the number of detected falls since the last start.
+     * @return
+     */
+    size_t getFallCnt()
+    {
+        return m_fallCnt.load(std::memory_order_relaxed);
+    }
+    /**
+     * @brief getTickJitter Returns the smoothed and the maximum delay
+     * of the update steps relative to their deadline in us.
+     * @param avg
+     * @param max
+     */
+    void getTickJitter(float &avg, uint32_t &max)
+    {
+        QMutexLocker locker(&m_statsMutex);
+        avg = m_tickJitterAvgUs;
+        max = m_tickJitterMaxUs;
+    }
 
 private:
     /**
@@ -196,10 +339,103 @@ private:
      */
     void updateObjectStats(sObjectStats &st, uint32_t elapsedTimeUs);
     /**
-     * @brief detect Detects objects in the event buffer and returns a list of Bboxes.
+     * @brief detect Detects objects with the given detection engine and returns a list of Bboxes.
+     * Requires the buffer image and summed area tables of the current update step.
+     * @param detector
+     * @param exportMask Copy the binary mask into the threshold image
+     * @return
+     */
+    std::vector<cv::Rect> detect(tDetector detector, bool exportMask);
+    /**
+     * @brief computeDenseMask Binarizes the occupancy image in the buffer image
+     * by opening, gaussian smoothing and temporal smoothing.
+     * @param exportMask Copy the binary mask into the threshold image
+     */
+    void computeDenseMask(bool exportMask);
+    /**
+     * @brief computeSparseMask Computes the same mask as the dense path by accumulating
+     * gaussian footprints around the opened pixels of the occupancy image in the buffer image.
+     * Only the region of the footprints and of the remaining temporal smoothing is processed.
+     * @return Region of the buffer image that can contain mask pixels
+     */
+    cv::Rect computeSparseMask();
+    /**
+     * @brief setupSparseDetector Precomputes the gaussian kernel, the structuring element offsets
+     * and gaussian footprints and measures the number of active pixels below which the sparse path is faster.
+     */
+    void setupSparseDetector();
+    /**
+     * @brief computeTimeSurfaceMask Replaces the buffer image with the
+     * thresholded, upsampled activity of the time surface.
+     */
+    void computeTimeSurfaceMask();
+    /**
+     * @brief computePyramidMask Binarizes the occupancy image in the buffer image
+     * like the dense path, but blurs and smoothes on the pyramid level.
+     * The result is stored in the pyramid image.
+     */
+    void computePyramidMask();
+    /**
+     * @brief findBoxes Returns the bounding boxes of the biggest connected components
+     * in a binary mask, sorted by area. Boxes inside others are removed.
+     * @param mask
+     * @return At most TRACK_BIGGEST_N_BOXES boxes
+     */
+    std::vector<cv::Rect> findBoxes(const cv::Mat &mask);
+    /**
+     * @brief refinePyramidBox Converts a box on the pyramid level to the binned grid.
+     * Each edge is placed on the outermost mask pixel of a full resolution strip
+     * around the coarse edge, see computeStripMask.
+     * @param r
+     * @return
+     */
+    cv::Rect refinePyramidBox(const cv::Rect &r);
+    /**
+     * @brief computeStripMask Computes the mask of the dense path in a region of the
+     * binned grid: The opened occupancy image is blurred at full resolution with the dense
+     * kernel and blended with the interpolated previous state of the pyramid level.
+     * @param strip Region inside the binned grid
+     * @param bounds Bounding box of the mask pixels on the binned grid
+     * @return False if the region has no mask pixels
+     */
+    bool computeStripMask(const cv::Rect &strip, cv::Rect &bounds);
+    /**
+     * @brief selectBoxes Keeps the biggest boxes with enough area and events
+     * and converts them to sensor coordinates.
+     * @param boxes Boxes on the binned grid
+     * @return
+     */
+    std::vector<cv::Rect> selectBoxes(std::vector<cv::Rect> &boxes);
+    /**
+     * @brief benchmarkDetectors Runs the dense or pyramid path as shadow of the active detector
+     * on the same occupancy image and accumulates the detection times and box overlaps.
+     * @param occupancy Occupancy image of the current update step
+     * @param boxes Result of the active detector
+     * @param detectTimeUs Detection time of the active detector
+     */
+    void benchmarkDetectors(const cv::Mat &occupancy, const std::vector<cv::Rect> &boxes, float detectTimeUs);
+    /**
+     * @brief waitForWork Blocks the processing thread until new events or frames
+     * arrive, the next update step is due or the processor is stopped.
+     */
+    void waitForWork();
+    /**
+     * @brief wakeConsumer Wakes the processing thread if it is waiting.
+     * Called by the producer threads.
+     */
+    void wakeConsumer();
+    /**
+     * @brief binEvents Maps event coordinates to the binned grid.
+     * @param events
+     * @param cnt
+     */
+    void binEvents(sDVSEvent* events, size_t cnt);
+    /**
+     * @brief toBinnedRect Converts a rectangle in sensor coordinates to the binned grid.
+     * @param r
      * @return
      */
-    std::vector<cv::Rect> detect();
+    cv::Rect toBinnedRect(const QRectF &r);
     /**
      * @brief tracking Tries to map the detected bboxes to the current objects
      * and inserts new objects if necessary.
@@ -213,22 +449,111 @@ private:
      * @return
      */
     bool findFallingPersonInROI(cv::Rect bbox);
+    /**
+     * @brief updateFrameImage Converts the latest raw frame to 8 bit if it is not converted yet.
+     * The conversion runs into the back image without blocking the camera thread,
+     * the images are swapped afterwards.
+     */
+    void updateFrameImage();
+    /**
+     * @brief reportFall Counts the fall and passes it to the fall receiver.
+     */
+    void reportFall(const sObjectStats &st, uint64_t time);
+    /**
+     * @brief printSummary Prints the queue and jitter statistics after stopping.
+     */
+    void printSummary();
 
 private:
     tSettings settings;
     std::atomic_bool m_isRunning;
     QFuture<void> m_future;
+    // Shared workers running the processing steps, NULL for a dedicated thread
+    ProcessingPool* m_pool;
+    IFallReciever* m_fallReciever;
+    std::atomic<size_t> m_processedCnt;
+    std::atomic<size_t> m_fallCnt;
 
     EventBuffer m_eventBuffer;
+    // Sensor size
     uint16_t m_sx,m_sy;
+    // Size of the binned grid used for detection
+    uint16_t m_binnedSx,m_binnedSy;
+    int m_binning, m_binningShift;
+    // Detection parameters, scaled to the binned grid
+    int m_borderH, m_borderV;
+    int m_minArea;
+    int m_gaussSigma;
+
+    // Selected detection engine, written by the GUI
+    std::atomic<int> m_detector;
+    // Detection engine used by the processing thread
+    tDetector m_activeDetector;
+    TimeSurface m_timeSurface;
+    // Time surface density on the cell grid and upsampled to the binned grid
+    cv::Mat m_densityImg, m_densityUpImg;
+    // Sparse dense path: Used below the crossover number of active pixels, 0 disables it
+    size_t m_sparseCrossover;
+    // Offsets of the opening structuring element
+    std::vector<cv::Point> m_openOffsets;
+    // Normalized gaussian kernel, its cumulative sum for the replicated border
+    // and the precomputed footprint of an inner pixel, scaled to 255
+    std::vector<float> m_gaussKernel, m_gaussKernelCum;
+    std::vector<float> m_splatFootprint;
+    // Accumulated footprints, zero outside the current step
+    cv::Mat m_splatImg;
+    // Marks of the opened pixels and their positions
+    cv::Mat m_openImg;
+    std::vector<int> m_openedPixels;
+    // Region where the smoothed buffer can be non zero
+    cv::Rect m_sparseRoi;
+    size_t m_sparseStepCnt, m_detectStepCnt;
+    // Set if the vectorized smoothing kernel matches the scalar one
+    bool m_vectorizedSmoothing;
+    // Downsampling factor and gaussian sigma of the pyramid level
+    int m_pyrScale;
+    float m_pyrSigma;
+    // Binary mask and temporally smoothed image on the pyramid level
+    cv::Mat m_pyrImg, m_pyrSmoothImg;
+    // Smoothed image of the previous step and the full resolution strips of the refinement
+    cv::Mat m_pyrPrevSmoothImg;
+    cv::Mat m_stripImg, m_stripState, m_stripMask;
+    // Horizontally blurred rows of a strip and the replicated column of each kernel tap
+    cv::Mat m_stripRows;
+    std::vector<int> m_stripCols;
+
+    // Shadow detector benchmark, accumulated over all update steps
+    bool m_benchmarkDetectors;
+    tDetector m_benchShadowDetector;
+    size_t m_benchStepCnt;
+    double m_benchActiveTimeUs, m_benchShadowTimeUs;
+    double m_benchIoUSum;
+    size_t m_benchBoxCnt;
 
-    QMutex m_queueMutex;
-    std::queue<sDVSEventDepacked> m_eventQueue;
+    // Lock free queue from camera thread (producer) to processing thread (consumer)
+    SPSCQueue<sDVSEvent> m_eventQueue;
+    // Events moved from the queue into the buffer in one step
+    std::vector<sDVSEvent> m_eventBatch;
+    // Wakes the processing thread on new data
+    QMutex m_wakeMutex;
+    QWaitCondition m_wakeCondition;
+    // Set while the processing thread waits, producers only signal in this case
+    std::atomic_bool m_consumerWaiting;
 
+    // Protects the latest raw frame and the front image
     QMutex m_frameMutex;
     float m_currFrameFPS;
     QElapsedTimer m_frameTimer;
+    // Latest raw frame, counted to convert each frame at most once
+    tFrameRef m_rawFrame;
+    uint64_t m_rawFrameCnt;
+    uint64_t m_convertedFrameCnt;
+    // Converted frame and the image of the next conversion
     QImage m_currFrame;
+    QImage m_backFrame;
+    // Serializes the conversions of the processing and GUI threads
+    QMutex m_convertMutex;
+    std::atomic_bool m_frameViewerActive;
     bool m_newFrameAvailable;
     u_int32_t m_nextId;
 
@@ -244,7 +569,16 @@ private:
     QMutex m_statsMutex;
     QVector<sObjectStats> m_stats;
     float m_currProcFPS;
+    float m_detectTimeUs;
+    // Delay of the update steps relative to their deadline
+    float m_tickJitterAvgUs;
+    uint32_t m_tickJitterMaxUs;
     QImage m_thresholdImg;
     cv::Mat m_bufferImg, m_smoothBufferImg;
+    // Event counts and moments of the current update step
+    SummedAreaTable m_sat;
+    // Components of the binary mask and their order by box size
+    ComponentLabeler m_labeler;
+    std::vector<int> m_componentOrder;
 };
 #endif // PROCESSOR_H
@@ -0,0 +1,229 @@
+#include "propheseerawsource.h"
+
+#include <string.h>
+
+#include "settings.h"
+
+// EVT 2.0 word types (bits 28-31)
+#define EVT2_CD_OFF 0x0
+#define EVT2_CD_ON 0x1
+#define EVT2_TIME_HIGH 0x8
+// EVT 2.0 timestamps have 34 bits: 28 bits time high and 6 bits in each event
+#define EVT2_TIME_LOW_BITS 6
+#define EVT2_TIME_LOOP (1LL << 34)
+
+// EVT 3.0 word types (bits 12-15)
+#define EVT3_ADDR_Y 0x0
+#define EVT3_ADDR_X 0x2
+#define EVT3_VECT_BASE_X 0x3
+#define EVT3_VECT_12 0x4
+#define EVT3_VECT_8 0x5
+#define EVT3_TIME_LOW 0x6
+#define EVT3_TIME_HIGH 0x8
+// EVT 3.0 timestamps have 24 bits: 12 bits time high and 12 bits time low
+#define EVT3_TIME_LOW_BITS 12
+#define EVT3_TIME_LOOP (1LL << 24)
+
+PropheseeRawSource::PropheseeRawSource():
+    m_format(EVT_2_0),
+    m_dataOffset(0),
+    m_pos(0)
+{
+    setRange(INT64_MIN,INT64_MAX);
+}
+
+PropheseeRawSource::~PropheseeRawSource()
+{
+    close();
+}
+
+bool PropheseeRawSource::open(QString fileName)
+{
+    close();
+    if(!mapFile(fileName))
+        return false;
+    if(!parseHeader()) {
+        close();
+        return false;
+    }
+    if(!probeStream()) {
+        printf("No events in %s\n", fileName.toStdString().c_str());
+        close();
+        return false;
+    }
+    printf("Raw file: EVT %s, %dx%d\n", m_format == EVT_3_0 ? "3.0" : "2.0", m_sx, m_sy);
+    return true;
+}
+
+void PropheseeRawSource::close()
+{
+    EventSource::close();
+    m_dataOffset = 0;
+    setRange(INT64_MIN,INT64_MAX);
+}
+
+void PropheseeRawSource::setRange(int64_t t0, int64_t t1)
+{
+    // There is no index, the stream is decoded from the beginning
+    m_t0 = t0;
+    m_t1 = t1;
+    m_pos = m_dataOffset;
+    m_timeHigh = 0;
+    m_lastTimeHighRaw = 0;
+    m_timeLoops = 0;
+    m_y = m_timeLow = m_baseX = 0;
+    m_pol = false;
+    m_vectMask = 0;
+    m_vectX = 0;
+}
+
+size_t PropheseeRawSource::nextEvents(sDVSEvent *events, int64_t *ts, size_t maxCnt)
+{
+    return m_format == EVT_3_0 ? decodeEvt3(events,ts,maxCnt) : decodeEvt2(events,ts,maxCnt);
+}
+
+bool PropheseeRawSource::parseHeader()
+{
+    // Header lines start with '%', e.g. "% evt 3.0", "% geometry 640x480"
+    // or "% format EVT3;height=720;width=1280". Newer files end it with "% end".
+    const char* text = (const char*)m_data;
+    bool evt3 = false;
+    qint64 pos = 0;
+    while(pos < m_size && text[pos] == '%') {
+        qint64 lineEnd = pos;
+        while(lineEnd < m_size && text[lineEnd] != '\n')
+            lineEnd++;
+        QString line = QString::fromLatin1(text + pos + 1, lineEnd - pos - 1).trimmed();
+        pos = lineEnd + 1;
+
+        QString key = line.section(" ",0,0).toLower();
+        QString value = line.section(" ",1).trimmed();
+        if(key == "end") {
+            break;
+        } else if(key == "evt") {
+            if(value != "2.0" && value != "3.0") {
+                printf("Unsupported raw format EVT %s\n", value.toStdString().c_str());
+                return false;
+            }
+            evt3 = value == "3.0";
+        } else if(key == "format") {
+            QString format = value.section(";",0,0);
+            if(format != "EVT2" && format != "EVT3") {
+                printf("Unsupported raw format %s\n", format.toStdString().c_str());
+                return false;
+            }
+            evt3 = format == "EVT3";
+            QStringList options = value.split(";");
+            for(const QString &option:options) {
+                if(option.startsWith("width="))
+                    m_sx = option.mid(6).toInt();
+                else if(option.startsWith("height="))
+                    m_sy = option.mid(7).toInt();
+            }
+        } else if(key == "geometry") {
+            m_sx = value.section("x",0,0).toInt();
+            m_sy = value.section("x",1,1).toInt();
+        }
+    }
+    m_format = evt3 ? EVT_3_0 : EVT_2_0;
+    m_dataOffset = qMin(pos,m_size);
+    return true;
+}
+
+size_t PropheseeRawSource::decodeEvt2(sDVSEvent *events, int64_t *ts, size_t maxCnt)
+{
+    size_t n = 0;
+    while(n < maxCnt && m_pos + 4 <= m_size) {
+        uint32_t w;
+        memcpy(&w,m_data + m_pos,sizeof(w));
+        m_pos += 4;
+
+        switch(w >> 28) {
+        case EVT2_CD_OFF:
+        case EVT2_CD_ON: {
+            int64_t t = m_timeHigh | ((w >> 22) & 0x3F);
+            if(!pushEvent((w >> 11) & 0x7FF,w & 0x7FF,(w >> 28) == EVT2_CD_ON,t,events,ts,n)) {
+                m_pos = m_size;
+                return n;
+            }
+            break;
+        }
+        case EVT2_TIME_HIGH: {
+            uint32_t raw = w & 0x0FFFFFFF;
+            if(raw < m_lastTimeHighRaw)
+                m_timeLoops += EVT2_TIME_LOOP;
+            m_lastTimeHighRaw = raw;
+            m_timeHigh = m_timeLoops | ((int64_t)raw << EVT2_TIME_LOW_BITS);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return n;
+}
+
+size_t PropheseeRawSource::decodeEvt3(sDVSEvent *events, int64_t *ts, size_t maxCnt)
+{
+    size_t n = 0;
+    while(n < maxCnt) {
+        int64_t t = m_timeHigh | m_timeLow;
+        // Emit the remaining events of a vector word first
+        if(m_vectMask != 0) {
+            int i = __builtin_ctz(m_vectMask);
+            m_vectMask &= m_vectMask - 1;
+            if(!pushEvent(m_vectX + i,m_y,m_pol,t,events,ts,n)) {
+                m_vectMask = 0;
+                m_pos = m_size;
+                return n;
+            }
+            continue;
+        }
+        if(m_pos + 2 > m_size)
+            return n;
+
+        uint16_t w;
+        memcpy(&w,m_data + m_pos,sizeof(w));
+        m_pos += 2;
+
+        switch(w >> 12) {
+        case EVT3_ADDR_Y:
+            m_y = w & 0x7FF;
+            break;
+        case EVT3_ADDR_X:
+            if(!pushEvent(w & 0x7FF,m_y,(w >> 11) & 1,t,events,ts,n)) {
+                m_pos = m_size;
+                return n;
+            }
+            break;
+        case EVT3_VECT_BASE_X:
+            m_baseX = w & 0x7FF;
+            m_pol = (w >> 11) & 1;
+            break;
+        case EVT3_VECT_12:
+            m_vectMask = w & 0xFFF;
+            m_vectX = m_baseX;
+            m_baseX += 12;
+            break;
+        case EVT3_VECT_8:
+            m_vectMask = w & 0xFF;
+            m_vectX = m_baseX;
+            m_baseX += 8;
+            break;
+        case EVT3_TIME_LOW:
+            m_timeLow = w & 0xFFF;
+            break;
+        case EVT3_TIME_HIGH: {
+            uint32_t raw = w & 0xFFF;
+            if(raw < m_lastTimeHighRaw)
+                m_timeLoops += EVT3_TIME_LOOP;
+            m_lastTimeHighRaw = raw;
+            m_timeHigh = m_timeLoops | ((int64_t)raw << EVT3_TIME_LOW_BITS);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return n;
+}
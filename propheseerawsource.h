@@ -0,0 +1,56 @@
+#ifndef PROPHESEERAWSOURCE_H
+#define PROPHESEERAWSOURCE_H
+
+#include <inttypes.h>
+
+#include <QString>
+
+#include "eventsource.h"
+
+/**
+ * @brief The PropheseeRawSource class streams Prophesee raw recordings
+ * in the EVT 2.0 (32 bit words) or EVT 3.0 (16 bit words) format.
+ * The format and the sensor size are read from the text header, the
+ * words are decoded in place inside the memory mapping. The decoder state
+ * (time base, vectorized events) is kept between calls, so batches can end
+ * anywhere in the stream. Trigger and other non-CD words are skipped.
+ */
+class PropheseeRawSource : public EventSource
+{
+public:
+    typedef enum tRawFormat {EVT_2_0, EVT_3_0} tRawFormat;
+
+    PropheseeRawSource();
+    ~PropheseeRawSource();
+
+    bool open(QString fileName);
+    void close();
+
+    void setRange(int64_t t0, int64_t t1);
+    size_t nextEvents(sDVSEvent* events, int64_t* ts, size_t maxCnt);
+
+private:
+    bool parseHeader();
+    size_t decodeEvt2(sDVSEvent* events, int64_t* ts, size_t maxCnt);
+    size_t decodeEvt3(sDVSEvent* events, int64_t* ts, size_t maxCnt);
+
+    tRawFormat m_format;
+    // File offsets of the first and the next word
+    qint64 m_dataOffset, m_pos;
+
+    // Upper timestamp bits, including the overflows of the time high counter
+    int64_t m_timeHigh;
+    // Last raw time high value, used to detect overflows
+    uint32_t m_lastTimeHighRaw;
+    int64_t m_timeLoops;
+    // EVT 3.0 state: current row, lower timestamp bits and vector base
+    uint16_t m_y;
+    uint16_t m_timeLow;
+    uint16_t m_baseX;
+    bool m_pol;
+    // Remaining events of the current vector word
+    uint32_t m_vectMask;
+    uint16_t m_vectX;
+};
+
+#endif // PROPHESEERAWSOURCE_H
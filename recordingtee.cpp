@@ -0,0 +1,271 @@
+#include "recordingtee.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QtConcurrent/QtConcurrent>
+
+#include <string.h>
+
+#include <libcaer/events/polarity.h>
+#include <libcaer/events/frame.h>
+
+#include "eventdecoder.h"
+
+/**
+ * @brief sourceName Returns the sensor name for the AEDAT header,
+ * which is used by readers to determine the sensor size.
+ */
+static const char* sourceName(uint16_t sx, uint16_t sy)
+{
+    if(sx == 240 && sy == 180)
+        return "DAVIS240C";
+    else if(sx == 346 && sy == 260)
+        return "DAVIS346";
+    else if(sx == 640 && sy == 480)
+        return "DAVIS640";
+    else if(sx == 128 && sy == 128)
+        return "DAVIS128";
+    return "DAVIS";
+}
+
+RecordingTee::RecordingTee():
+    m_format(RECORDING_AEDAT),
+    m_maxFileBytes(0),
+    m_fileIdx(0),
+    m_writerStarted(false),
+    m_sx(0),
+    m_sy(0),
+    m_isRecording(false),
+    m_droppedCnt(0),
+    m_packetCnt(0),
+    m_writtenBytes(0),
+    m_writeBufferFill(0)
+{
+}
+
+RecordingTee::~RecordingTee()
+{
+    stop();
+}
+
+bool RecordingTee::start(QString baseName, tRecordingFormat format, qint64 maxFileBytes, uint16_t sx, uint16_t sy)
+{
+    stop();
+
+    m_format = format;
+    m_baseName = baseName + "_" + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
+    m_maxFileBytes = maxFileBytes;
+    m_fileIdx = 0;
+    m_sx = sx;
+    m_sy = sy;
+    m_droppedCnt = 0;
+    m_packetCnt = 0;
+    m_writtenBytes = 0;
+    if(!openFile())
+        return false;
+
+    // Allocated once, the camera thread only copies into the ring
+    m_ring.setup(RECORDING_RING_SZ);
+    m_writeBuffer.resize(format == RECORDING_AEDAT ? RECORDING_WRITE_CHUNK_SZ : 0);
+    m_writeBufferFill = 0;
+
+    m_isRecording = true;
+    m_writerStarted = true;
+    m_future = QtConcurrent::run(this, &RecordingTee::run);
+    return true;
+}
+
+void RecordingTee::stop()
+{
+    // The writer thread also ends the recording on errors
+    if(!m_writerStarted)
+        return;
+    m_writerStarted = false;
+    m_isRecording = false;
+    {
+        QMutexLocker locker(&m_waitMutex);
+        m_waitCondition.wakeAll();
+    }
+    m_future.waitForFinished();
+
+    printf("Recording stopped: %zu packets, %zu dropped, %.1f MB in %d files\n",
+           getPacketCnt(), getDroppedCnt(), getWrittenBytes()/1048576.0, m_fileIdx);
+}
+
+bool RecordingTee::addPacket(caerEventPacketHeaderConst packet)
+{
+    if(!m_isRecording)
+        return false;
+
+    // Header and events are contiguous, the unused capacity is not copied
+    size_t sz = sizeof(struct caer_event_packet_header) + (size_t)packet->eventNumber*packet->eventSize;
+    if(!m_ring.pushAll((const uint8_t*)packet,sz)) {
+        m_droppedCnt.fetch_add(1,std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void RecordingTee::run()
+{
+    QElapsedTimer flushTimer;
+    flushTimer.start();
+    while(true) {
+        // All packets are queued before the recording is stopped
+        bool stopping = !m_isRecording;
+        size_t cnt = 0;
+        while(popPacket()) {
+            writePacket();
+            cnt++;
+        }
+
+        if(m_writeBufferFill > 0 && flushTimer.elapsed() >= RECORDING_FLUSH_INTERVAL_MS) {
+            flush();
+            flushTimer.restart();
+        }
+        if(stopping)
+            break;
+
+        // Polling keeps the camera thread free of any synchronization
+        if(cnt == 0) {
+            QMutexLocker locker(&m_waitMutex);
+            if(m_isRecording)
+                m_waitCondition.wait(&m_waitMutex,RECORDING_POLL_MS);
+        }
+    }
+    closeFile();
+}
+
+bool RecordingTee::popPacket()
+{
+    const size_t headerSz = sizeof(struct caer_event_packet_header);
+    struct caer_event_packet_header header;
+    // Packets are pushed at once, the events are available with the header
+    if(m_ring.pop((uint8_t*)&header,headerSz) != headerSz)
+        return false;
+
+    size_t payloadSz = (size_t)header.eventNumber*header.eventSize;
+    if(m_packet.size() < headerSz + payloadSz)
+        m_packet.resize(headerSz + payloadSz);
+    // The packet is written without unused capacity
+    header.eventCapacity = header.eventNumber;
+    memcpy(m_packet.data(),&header,headerSz);
+    m_ring.pop(m_packet.data() + headerSz,payloadSz);
+    m_packetCnt.fetch_add(1,std::memory_order_relaxed);
+    return true;
+}
+
+void RecordingTee::writePacket()
+{
+    // The recording stopped after an error
+    if(!m_file.isOpen() && !m_columnar.isOpen())
+        return;
+
+    caerEventPacketHeaderConst packet = (caerEventPacketHeaderConst)m_packet.data();
+    size_t sz = sizeof(struct caer_event_packet_header) + (size_t)packet->eventNumber*packet->eventSize;
+
+    // Start a new file at a packet boundary
+    if(m_maxFileBytes > 0 && getFileSize() > 0 && getFileSize() + (qint64)sz > m_maxFileBytes) {
+        closeFile();
+        if(!openFile()) {
+            m_isRecording = false;
+            return;
+        }
+    }
+
+    if(m_format == RECORDING_AEDAT) {
+        if(m_writeBufferFill + sz > m_writeBuffer.size())
+            flush();
+        if(sz > m_writeBuffer.size()) {
+            m_file.write((const char*)packet,sz);
+            m_writtenBytes.fetch_add(sz,std::memory_order_relaxed);
+        } else {
+            memcpy(m_writeBuffer.data() + m_writeBufferFill,packet,sz);
+            m_writeBufferFill += sz;
+        }
+    } else if(packet->eventType == POLARITY_EVENT) {
+        if(m_events.size() < (size_t)packet->eventNumber) {
+            m_events.resize(packet->eventNumber);
+            m_eventTs.resize(packet->eventNumber);
+        }
+        size_t cnt = decodePolarityPacket((caerPolarityEventPacketConst)packet,m_events.data());
+        // The decoder keeps the lower 32 bits, the packet overflow counter the rest
+        int64_t high = (int64_t)(packet->eventTSOverflow >> 1) << 32;
+        for(size_t i = 0; i < cnt; i++)
+            m_eventTs[i] = high | m_events[i].ts;
+        qint64 before = m_columnar.getFileSize();
+        m_columnar.addEvents(m_events.data(),cnt,m_eventTs.data());
+        m_writtenBytes.fetch_add(m_columnar.getFileSize() - before,std::memory_order_relaxed);
+    } else if(packet->eventType == FRAME_EVENT) {
+        caerFrameEventPacket framePacket = (caerFrameEventPacket)m_packet.data();
+        qint64 before = m_columnar.getFileSize();
+        for(int32_t i = 0; i < packet->eventNumber; i++) {
+            caerFrameEvent frame = caerFrameEventPacketGetEvent(framePacket,i);
+            if(!caerFrameEventIsValid(frame))
+                continue;
+            m_columnar.addFrame(caerFrameEventGetPixelArrayUnsafe(frame),caerFrameEventGetLengthX(frame),
+                                caerFrameEventGetLengthY(frame),caerFrameEventGetTimestamp64(frame,framePacket));
+        }
+        m_writtenBytes.fetch_add(m_columnar.getFileSize() - before,std::memory_order_relaxed);
+    }
+}
+
+bool RecordingTee::openFile()
+{
+    QString fileName = QString("%1_%2%3").arg(m_baseName).arg(m_fileIdx,3,10,QChar('0'))
+                       .arg(m_format == RECORDING_AEDAT ? ".aedat" : COLUMNAR_FILE_SUFFIX);
+    m_fileIdx++;
+
+    bool ok;
+    if(m_format == RECORDING_AEDAT) {
+        m_file.setFileName(fileName);
+        ok = m_file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        if(ok) {
+            QByteArray header = QString("#!AER-DAT3.1\r\n"
+                                        "#Format: RAW\r\n"
+                                        "#Source 1: %1\r\n"
+                                        "#Start-Time: %2\r\n"
+                                        "#!END-HEADER\r\n")
+                                .arg(sourceName(m_sx,m_sy))
+                                .arg(QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss"))
+                                .toLatin1();
+            ok = m_file.write(header) == header.size();
+        }
+    } else {
+        ok = m_columnar.open(fileName,m_sx,m_sy);
+    }
+
+    if(!ok)
+        printf("Can't create recording %s\n", fileName.toStdString().c_str());
+    else
+        printf("Recording to %s\n", fileName.toStdString().c_str());
+    return ok;
+}
+
+void RecordingTee::closeFile()
+{
+    if(m_format == RECORDING_AEDAT) {
+        flush();
+        if(m_file.isOpen())
+            m_file.close();
+    } else if(m_columnar.isOpen()) {
+        m_columnar.close();
+    }
+}
+
+void RecordingTee::flush()
+{
+    if(m_writeBufferFill == 0)
+        return;
+    if(m_file.write((const char*)m_writeBuffer.data(),m_writeBufferFill) != (qint64)m_writeBufferFill)
+        printf("Writing the recording failed\n");
+    m_writtenBytes.fetch_add(m_writeBufferFill,std::memory_order_relaxed);
+    m_writeBufferFill = 0;
+}
+
+qint64 RecordingTee::getFileSize() const
+{
+    if(m_format == RECORDING_AEDAT)
+        return m_file.pos() + m_writeBufferFill;
+    return m_columnar.getFileSize();
+}
@@ -0,0 +1,127 @@
+#ifndef RECORDINGTEE_H
+#define RECORDINGTEE_H
+
+#include <atomic>
+#include <vector>
+
+#include <QFile>
+#include <QString>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFuture>
+
+#include <libcaer/events/common.h>
+
+#include "columnarwriter.h"
+#include "datatypes.h"
+#include "settings.h"
+#include "spscqueue.h"
+
+/**
+ * @brief The RecordingTee class copies the raw packets of the live stream to disk.
+ * The camera thread copies each packet into a lock free ring and never waits;
+ * packets that don't fit because the disk falls behind are dropped and counted.
+ * A writer thread drains the ring, writes AEDAT 3.1 or columnar files with large
+ * sequential writes and starts a new file when the maximum file size is reached.
+ */
+class RecordingTee
+{
+public:
+    RecordingTee();
+    ~RecordingTee();
+
+    /**
+     * @brief start Creates the first file and starts the writer thread.
+     * Files are named <baseName>_<date>_<time>_<index> with the suffix of the format.
+     * @param baseName
+     * @param format
+     * @param maxFileBytes Size at which a new file is started, 0 for a single file
+     * @param sx
+     * @param sy
+     * @return False if the file can't be created
+     */
+    bool start(QString baseName, tRecordingFormat format, qint64 maxFileBytes, uint16_t sx, uint16_t sy);
+    /**
+     * @brief stop Writes all queued packets, closes the file and stops the writer thread.
+     * Must not be called while packets are added.
+     */
+    void stop();
+    bool isRecording() const
+    {
+        return m_isRecording;
+    }
+
+    /**
+     * @brief addPacket Camera thread: Queues a copy of the packet without blocking.
+     * @param packet
+     * @return False if the packet was dropped because the ring is full
+     */
+    bool addPacket(caerEventPacketHeaderConst packet);
+
+    size_t getDroppedCnt() const
+    {
+        return m_droppedCnt.load(std::memory_order_relaxed);
+    }
+    size_t getPacketCnt() const
+    {
+        return m_packetCnt.load(std::memory_order_relaxed);
+    }
+    /**
+     * @brief getWrittenBytes Returns the number of bytes written to all files.
+     * @return
+     */
+    uint64_t getWrittenBytes() const
+    {
+        return m_writtenBytes.load(std::memory_order_relaxed);
+    }
+
+protected:
+    /**
+     * @brief run Writer thread: Drains the ring until the recording is stopped.
+     */
+    void run();
+    /**
+     * @brief popPacket Moves the next packet from the ring into m_packet.
+     * @return False if the ring is empty
+     */
+    bool popPacket();
+    void writePacket();
+    bool openFile();
+    void closeFile();
+    /**
+     * @brief flush Writes the buffered AEDAT data to the file.
+     */
+    void flush();
+    qint64 getFileSize() const;
+
+    tRecordingFormat m_format;
+    QString m_baseName;
+    qint64 m_maxFileBytes;
+    int m_fileIdx;
+    // Set between start and stop, only used by the controlling thread
+    bool m_writerStarted;
+    uint16_t m_sx, m_sy;
+
+    SPSCQueue<uint8_t> m_ring;
+    std::atomic_bool m_isRecording;
+    std::atomic<size_t> m_droppedCnt;
+    std::atomic<size_t> m_packetCnt;
+    std::atomic<uint64_t> m_writtenBytes;
+
+    // Writer thread data
+    QFuture<void> m_future;
+    QMutex m_waitMutex;
+    QWaitCondition m_waitCondition;
+    // Current packet, its capacity grows to the largest packet
+    std::vector<uint8_t> m_packet;
+    // AEDAT output
+    QFile m_file;
+    std::vector<uint8_t> m_writeBuffer;
+    size_t m_writeBufferFill;
+    // Columnar output and its decoded events
+    ColumnarWriter m_columnar;
+    std::vector<sDVSEvent> m_events;
+    std::vector<int64_t> m_eventTs;
+};
+
+#endif // RECORDINGTEE_H
@@ -1,6 +1,9 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <QString>
+#include <QStringList>
+
 //#define DAVIS_IMG_WIDHT 240
 //#define DAVIS_IMG_HEIGHT 180
 
@@ -15,6 +18,116 @@
 // Lowpass filter for smoothing FPS counters
 #define FPS_LOWPASS_FILTER_COEFF 0.1
 
+// Event buffer settings
+// Maximum expected event rate in events per second.
+// The event buffer is preallocated to hold TIME_WINDOW_US at this rate.
+#define EVENT_BUFFER_MAX_EVENT_RATE 10000000
+// Factor for additional event buffer memory. Events of existing snapshots
+// are not overwritten, the headroom allows the writer to continue meanwhile.
+#define EVENT_BUFFER_SNAPSHOT_HEADROOM 2
+// Maximum time the thread adding events waits for a snapshot that still uses
+// memory to be overwritten. The remaining events of the batch are dropped afterwards.
+#define EVENT_BUFFER_PIN_WAIT_MS 5
+// Capacity of the lock free queue between camera and processing thread (events)
+#define EVENT_QUEUE_CAPACITY (1<<21)
+// Maximum number of events moved from the queue to the buffer in one step
+#define EVENT_QUEUE_BATCH_SZ (1<<14)
+
+// Wait times of the camera thread if no data is available,
+// doubled on each empty poll up to the maximum
+#define CAMERA_IDLE_WAIT_MIN_MS 1
+#define CAMERA_IDLE_WAIT_MAX_MS 4
+
+// Noise filter settings
+// Events without an event in their 8-neighbourhood within the time window are
+// removed on the camera thread, before they are queued for processing.
+// Off by default since the detector is tuned without it, enable it with --noiseDt or in the GUI.
+#define NOISE_FILTER_ENABLED false
+#define NOISE_FILTER_TIME_WINDOW_US 10000
+
+// Playback of AEDAT files
+// Maximum size of the text header
+#define AEDAT_MAX_HEADER_SZ (1<<20)
+// Suffix of the cached timestamp index next to the recording
+#define AEDAT_INDEX_SUFFIX ".idx"
+// Number of event packets used to estimate the size of unknown sensors
+#define AEDAT_SIZE_PROBE_PACKETS 64
+
+// Columnar recording format
+// Number of events per compressed block
+#define COLUMNAR_BLOCK_EVENTS 65536
+// Compression level of qCompress (0-9)
+#define COLUMNAR_COMPRESSION_LEVEL 6
+
+// Event sources for recordings (AEDAT 3.x/4, EVT 2.0/3.0, CSV, columnar)
+// Maximum number of events delivered at once during playback
+#define EVENT_SOURCE_CHUNK 4096
+// Number of events used to estimate the size of unknown sensors
+#define EVENT_SOURCE_SIZE_PROBE_EVENTS (1<<20)
+
+// Synthetic event source, played like a file named "synthetic:<key>=<value>,..."
+// Keys: size (WxH), rate (events/s), noise (events/s), people, fall (s, -1 for none),
+// flicker (number of sources), flickerHz, duration (s), seed, gt (ground truth file)
+#define SYNTHETIC_SOURCE_PREFIX "synthetic:"
+#define SYNTHETIC_WIDTH 240
+#define SYNTHETIC_HEIGHT 180
+#define SYNTHETIC_RATE 1000000
+#define SYNTHETIC_NOISE_RATE 20000
+#define SYNTHETIC_PEOPLE 1
+#define SYNTHETIC_FALL_S 5
+#define SYNTHETIC_FLICKER 0
+#define SYNTHETIC_FLICKER_HZ 100
+#define SYNTHETIC_DURATION_S 20
+#define SYNTHETIC_GT_FILE "synthetic_gt.csv"
+// The scene is updated in slices of this length
+#define SYNTHETIC_SLICE_US 1000
+// Duration of the scripted fall from standing to lying
+#define SYNTHETIC_FALL_DURATION_US 600000
+// Interval of the ground truth boxes
+#define SYNTHETIC_GT_INTERVAL_US UPDATE_INTERVAL_COMP_US
+
+// Multiple cameras
+// Worker threads shared by the processors of all cameras, 0 for the number of cores
+#define PROCESSING_POOL_THREADS 0
+// Longest sleep of an idle worker
+#define PROCESSING_POOL_MAX_IDLE_US 100000
+// Number of fall alerts kept for the GUI
+#define ALERT_HISTORY_SZ 256
+
+// Recording of the live camera stream
+// Format used on startup, see tRecordingFormat
+#define RECORDING_FORMAT RECORDING_AEDAT
+// Size of the lock free ring between the camera thread and the writer thread
+#define RECORDING_RING_SZ (64<<20)
+// Data is written in chunks of this size, or after the flush interval at low rates
+#define RECORDING_WRITE_CHUNK_SZ (4<<20)
+#define RECORDING_FLUSH_INTERVAL_MS 1000
+// Polling interval of the writer thread, the camera thread never signals it
+#define RECORDING_POLL_MS 10
+// A new file is started when a file exceeds this size, 0 disables the rotation
+#define RECORDING_MAX_FILE_MB 1024
+
+// Hot pixel filter settings
+// Pixels are masked if their event count during the calibration is above
+// mean + N*std of all pixels and their rate is above the minimum rate
+#define HOT_PIXEL_FILTER_ENABLED true
+#define HOT_PIXEL_CALIBRATION_US 5000000
+#define HOT_PIXEL_THRESHOLD_STD 5
+#define HOT_PIXEL_MIN_RATE_HZ 100
+// Minimum time between two events of the same pixel, 0 disables the refractory period.
+// Disabled by default, it lowers the event counts TRACK_MIN_EVENT_CNT is tuned for.
+#define HOT_PIXEL_REFRACTORY_US 0
+// Mask file for the camera. The file stores the serial number of the camera,
+// a mask of another camera is replaced by a new calibration.
+// Recordings only read a mask given on the command line,
+// otherwise their mask is learned in memory and never written.
+#define HOT_PIXEL_MASK_FILE "hotpixels.mask"
+
+// Spatial binning factor (1, 2 or 4) applied to incoming events.
+// Detection and tracking run on the binned grid, which keeps
+// the processing cost low for high resolution sensors.
+#define SPATIAL_BINNING 1
+
 // Tracking and detection settings
 // How long has a ROI with lost tracking to be kept alive
 #define TRACK_DELAY_KEEP_ROI_US 1000000
@@ -33,6 +146,39 @@
 // Threshold for binarizing the resulting smoothed image
 // Lower values expand the contour, higher values are closer to the original shape
 #define TRACK_BOX_DETECTOR_THRESHOLD (255*0.04)
+// Sparse variant of the dense path for nearly empty scenes: Below a number of active pixels,
+// precomputed gaussian footprints are accumulated around the opened pixels
+// instead of blurring the whole image. The crossover is measured on startup.
+#define TRACK_SPARSE_DETECTOR true
+// Number of timed runs of each path for the crossover, the fastest run counts
+#define TRACK_SPARSE_CALIBRATION_RUNS 5
+
+// Time surface detector, alternative to the dense opening, blur and temporal smoothing
+// Detection engine used on startup, see tDetector
+#define TRACK_DETECTOR DETECTOR_DENSE
+// Edge length of the time surface cells in sensor pixels
+#define TIME_SURFACE_CELL_SZ 4
+// Time constant of the exponential decay. Together with the refractory period
+// below, a pixel with a single event contributes for about as long as it stays
+// in the time window and the temporal smoothing of the dense path combined.
+#define TIME_SURFACE_TAU_US (TIME_WINDOW_US/2)
+// Each pixel contributes at most once per period, this removes the influence
+// of the event rate per pixel like the occupancy image does
+#define TIME_SURFACE_PIXEL_REFRACTORY_US TIME_SURFACE_TAU_US
+// Threshold for the fraction of active pixels, same as for the dense path
+#define TIME_SURFACE_THRESHOLD (TRACK_BOX_DETECTOR_THRESHOLD/255.0)
+// Resolution of the decay lookup table: 2^N us per entry
+#define TIME_SURFACE_LUT_SHIFT 6
+// Decay factors for time differences above N*tau are zero
+#define TIME_SURFACE_LUT_RANGE_TAU 8
+
+// Pyramid detector, runs the dense path on a downsampled occupancy image
+// Pyramid level of the detection: The binned grid is downsampled by 2^N.
+// The level is reduced if the scaled gaussian sigma would drop below one pixel.
+#define TRACK_PYRAMID_LEVEL 2
+// Run the dense or pyramid path as shadow of the active detector and
+// print the detection times and box overlaps when the processor stops
+#define TRACK_BENCHMARK_DETECTORS false
 
 // Optional scaling factor for detected bounding boxes
 #define TRACK_BOX_SCALE (1.1)
@@ -75,17 +221,71 @@
 // To detect humans in falling objects
 #define FALL_DETECTOR_POSTCLASSIFY_HUMANS false
 
+typedef enum tDetector {
+    // Opening, gaussian blur and temporal smoothing of the occupancy image
+    DETECTOR_DENSE = 0,
+    // Exponentially decaying activity surface, see TimeSurface
+    DETECTOR_TIME_SURFACE = 1,
+    // Dense path on a pyramid level, box edges refined on the binned grid
+    DETECTOR_PYRAMID = 2
+} tDetector;
+
+typedef enum tRecordingFormat {
+    // AEDAT 3.1, the packets are written unchanged
+    RECORDING_AEDAT = 0,
+    // Compact columnar format, see columnarformat.h
+    RECORDING_COLUMNAR = 1
+} tRecordingFormat;
+
 typedef struct tSettings {
     double fall_detector_y_speed_min_threshold;
     double fall_detector_y_speed_max_threshold;
     double fall_detector_y_center_threshold_fall;
     double fall_detector_y_center_threshold_unfall;
+    int binning;
+    tDetector detector;
+    bool benchmark_detectors;
+    bool noise_filter_enabled;
+    uint32_t noise_filter_time_window_us;
+    bool hot_pixel_filter_enabled;
+    bool hot_pixel_recalibrate;
+    uint32_t hot_pixel_refractory_us;
+    QString hot_pixel_mask_file;
+    // Mask read for played recordings, empty to learn the mask in memory
+    QString playback_hot_pixel_mask_file;
+    // Playback range relative to the beginning of a recording, end 0 for the whole file
+    int64_t playback_from_us;
+    int64_t playback_to_us;
+    // Base name of the recordings of the live stream, empty to disable the recording
+    QString record_file;
+    tRecordingFormat record_format;
+    uint32_t record_max_file_mb;
+    // Serial numbers of the live cameras, empty entries for the next free camera
+    QStringList camera_serials;
+    int processing_threads;
+    float playback_speed;
     tSettings()
     {
         fall_detector_y_speed_min_threshold = FALL_DETECTOR_Y_SPEED_MIN_THRESHOLD;
         fall_detector_y_speed_max_threshold = FALL_DETECTOR_Y_SPEED_MAX_THRESHOLD;
         fall_detector_y_center_threshold_fall = FALL_DETECTOR_Y_CENTER_THRESHOLD_FALL;
         fall_detector_y_center_threshold_unfall = FALL_DETECTOR_Y_CENTER_THRESHOLD_UNFALL;
+        binning = SPATIAL_BINNING;
+        detector = TRACK_DETECTOR;
+        benchmark_detectors = TRACK_BENCHMARK_DETECTORS;
+        noise_filter_enabled = NOISE_FILTER_ENABLED;
+        noise_filter_time_window_us = NOISE_FILTER_TIME_WINDOW_US;
+        hot_pixel_filter_enabled = HOT_PIXEL_FILTER_ENABLED;
+        hot_pixel_recalibrate = false;
+        hot_pixel_refractory_us = HOT_PIXEL_REFRACTORY_US;
+        hot_pixel_mask_file = HOT_PIXEL_MASK_FILE;
+        playback_from_us = 0;
+        playback_to_us = 0;
+        record_format = RECORDING_FORMAT;
+        record_max_file_mb = RECORDING_MAX_FILE_MB;
+        camera_serials = QStringList() << QString();
+        processing_threads = PROCESSING_POOL_THREADS;
+        playback_speed = 1;
     }
 
 } tSettings;
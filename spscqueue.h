@@ -0,0 +1,206 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// Assumed cache line size, used to keep producer and consumer indices apart
+#define SPSC_CACHE_LINE_SIZE 64
+
+/**
+ * @brief The SPSCQueue class is a bounded, lock free queue
+ * for exactly one producer thread and one consumer thread.
+ * The capacity is rounded up to the next power of two.
+ * Producer and consumer indices live on separate cache lines
+ * and each side keeps a cached copy of the other side's index
+ * to avoid touching the shared cache line on every operation.
+ */
+template<typename T>
+class SPSCQueue
+{
+public:
+    SPSCQueue():
+        m_head(0),
+        m_tail(0),
+        m_cachedHead(0),
+        m_highWaterMark(0),
+        m_droppedCnt(0),
+        m_cachedTail(0),
+        m_mask(0)
+    {
+    }
+
+    /**
+     * @brief setup Allocates the queue storage and resets all counters.
+     * Must not be called while a producer or consumer is active.
+     * @param capacity Minimum number of elements
+     */
+    void setup(size_t capacity)
+    {
+        size_t cap = 1;
+        while(cap < capacity)
+            cap <<= 1;
+        m_buffer.resize(cap);
+        m_mask = cap - 1;
+        clear();
+    }
+
+    /**
+     * @brief clear Removes all elements and resets the statistics.
+     * Must not be called while a producer or consumer is active.
+     */
+    void clear()
+    {
+        m_head.store(0);
+        m_tail.store(0);
+        m_cachedHead = 0;
+        m_cachedTail = 0;
+        m_highWaterMark.store(0);
+        m_droppedCnt.store(0);
+    }
+
+    /**
+     * @brief push Producer side: Appends a single element.
+     * @param item
+     * @return False if the queue is full and the element was dropped.
+     */
+    bool push(const T& item)
+    {
+        return push(&item,1) == 1;
+    }
+
+    /**
+     * @brief push Producer side: Appends up to cnt elements.
+     * Elements that don't fit are dropped and counted.
+     * @param items
+     * @param cnt
+     * @return Number of appended elements
+     */
+    size_t push(const T* items, size_t cnt)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t free = m_buffer.size() - (tail - m_cachedHead);
+        if(free < cnt) {
+            // Refresh the cached consumer position
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            free = m_buffer.size() - (tail - m_cachedHead);
+        }
+        size_t n = std::min(free, cnt);
+        if(n < cnt)
+            m_droppedCnt.fetch_add(cnt - n, std::memory_order_relaxed);
+        if(n == 0)
+            return 0;
+
+        // Copy in at most two contiguous parts
+        size_t start = tail & m_mask;
+        size_t first = std::min(n, m_buffer.size() - start);
+        std::copy(items, items + first, &m_buffer[start]);
+        std::copy(items + first, items + n, &m_buffer[0]);
+
+        m_tail.store(tail + n, std::memory_order_release);
+
+        size_t fill = tail + n - m_head.load(std::memory_order_relaxed);
+        if(fill > m_highWaterMark.load(std::memory_order_relaxed))
+            m_highWaterMark.store(fill, std::memory_order_relaxed);
+        return n;
+    }
+
+    /**
+     * @brief pushAll Producer side: Appends either all cnt elements or none of them.
+     * @param items
+     * @param cnt
+     * @return False if the elements don't fit, they are counted as dropped.
+     */
+    bool pushAll(const T* items, size_t cnt)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if(m_buffer.size() - (tail - m_cachedHead) < cnt) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if(m_buffer.size() - (tail - m_cachedHead) < cnt) {
+                m_droppedCnt.fetch_add(cnt, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        return push(items,cnt) == cnt;
+    }
+
+    /**
+     * @brief pop Consumer side: Removes up to maxCnt elements.
+     * @param items Destination array
+     * @param maxCnt
+     * @return Number of removed elements
+     */
+    size_t pop(T* items, size_t maxCnt)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        size_t avail = m_cachedTail - head;
+        if(avail < maxCnt) {
+            // Refresh the cached producer position
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            avail = m_cachedTail - head;
+        }
+        size_t n = std::min(avail, maxCnt);
+        if(n == 0)
+            return 0;
+
+        size_t start = head & m_mask;
+        size_t first = std::min(n, m_buffer.size() - start);
+        std::copy(&m_buffer[start], &m_buffer[start] + first, items);
+        std::copy(&m_buffer[0], &m_buffer[0] + (n - first), items + first);
+
+        m_head.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief size Returns the current number of queued elements.
+     * The value is only a snapshot if the queue is used concurrently.
+     * @return
+     */
+    size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+    bool empty() const
+    {
+        return size() == 0;
+    }
+    size_t capacity() const
+    {
+        return m_buffer.size();
+    }
+    /**
+     * @brief getHighWaterMark Returns the highest fill level since the last clear.
+     * @return
+     */
+    size_t getHighWaterMark() const
+    {
+        return m_highWaterMark.load(std::memory_order_relaxed);
+    }
+    /**
+     * @brief getDroppedCnt Returns the number of elements dropped because the queue was full.
+     * @return
+     */
+    size_t getDroppedCnt() const
+    {
+        return m_droppedCnt.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Consumer position
+    alignas(SPSC_CACHE_LINE_SIZE) std::atomic<size_t> m_head;
+    // Producer position and producer local data
+    alignas(SPSC_CACHE_LINE_SIZE) std::atomic<size_t> m_tail;
+    size_t m_cachedHead;
+    std::atomic<size_t> m_highWaterMark;
+    std::atomic<size_t> m_droppedCnt;
+    // Consumer local data
+    alignas(SPSC_CACHE_LINE_SIZE) size_t m_cachedTail;
+    // Shared, read only data
+    alignas(SPSC_CACHE_LINE_SIZE) size_t m_mask;
+    std::vector<T> m_buffer;
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,92 @@
+#include "summedareatable.h"
+
+#include <algorithm>
+#include <cstring>
+
+SummedAreaTable::SummedAreaTable():m_sx(0),m_sy(0)
+{
+}
+
+void SummedAreaTable::compute(const uint32_t *count, const uint8_t *occupancy, uint16_t sx, uint16_t sy)
+{
+    size_t stride = sx + 1;
+    if(sx != m_sx || sy != m_sy) {
+        m_sx = sx;
+        m_sy = sy;
+        m_allEvents.resize(stride*(sy+1));
+        m_uniquePixels.resize(stride*(sy+1));
+        // First row and column stay zero
+        memset(m_allEvents.data(),0,m_allEvents.size()*sizeof(sMoments));
+        memset(m_uniquePixels.data(),0,m_uniquePixels.size()*sizeof(sMoments));
+    }
+
+    for(int y = 0; y < sy; y++) {
+        const uint32_t* cRow = count + y*sx;
+        const uint8_t* oRow = occupancy + y*sx;
+        const sMoments* aPrev = &m_allEvents[y*stride];
+        const sMoments* uPrev = &m_uniquePixels[y*stride];
+        sMoments* aCurr = &m_allEvents[(y+1)*stride];
+        sMoments* uCurr = &m_uniquePixels[(y+1)*stride];
+
+        // Running sums of the current row
+        sMoments a = {0,0,0,0,0};
+        sMoments u = {0,0,0,0,0};
+        for(int x = 0; x < sx; x++) {
+            int64_t c = cRow[x];
+            if(c > 0) {
+                a.n += c;
+                a.x += c*x;
+                a.y += c*y;
+                a.xx += c*x*x;
+                a.yy += c*y*y;
+            }
+            if(oRow[x] > 0) {
+                u.n += 1;
+                u.x += x;
+                u.y += y;
+                u.xx += x*x;
+                u.yy += y*y;
+            }
+            sMoments &ac = aCurr[x+1];
+            const sMoments &ap = aPrev[x+1];
+            ac.n = ap.n + a.n;
+            ac.x = ap.x + a.x;
+            ac.y = ap.y + a.y;
+            ac.xx = ap.xx + a.xx;
+            ac.yy = ap.yy + a.yy;
+
+            sMoments &uc = uCurr[x+1];
+            const sMoments &up = uPrev[x+1];
+            uc.n = up.n + u.n;
+            uc.x = up.x + u.x;
+            uc.y = up.y + u.y;
+            uc.xx = up.xx + u.xx;
+            uc.yy = up.yy + u.yy;
+        }
+    }
+}
+
+sMoments SummedAreaTable::getMoments(const cv::Rect &r, bool allEvents) const
+{
+    sMoments m = {0,0,0,0,0};
+    int x1 = std::max(0,r.x);
+    int y1 = std::max(0,r.y);
+    int x2 = std::min((int)m_sx,r.x+r.width);
+    int y2 = std::min((int)m_sy,r.y+r.height);
+    if(x2 <= x1 || y2 <= y1)
+        return m;
+
+    const std::vector<sMoments> &t = allEvents?m_allEvents:m_uniquePixels;
+    size_t stride = m_sx + 1;
+    const sMoments &br = t[y2*stride+x2];
+    const sMoments &tr = t[y1*stride+x2];
+    const sMoments &bl = t[y2*stride+x1];
+    const sMoments &tl = t[y1*stride+x1];
+
+    m.n = br.n - tr.n - bl.n + tl.n;
+    m.x = br.x - tr.x - bl.x + tl.x;
+    m.y = br.y - tr.y - bl.y + tl.y;
+    m.xx = br.xx - tr.xx - bl.xx + tl.xx;
+    m.yy = br.yy - tr.yy - bl.yy + tl.yy;
+    return m;
+}
@@ -0,0 +1,68 @@
+#ifndef SUMMEDAREATABLE_H
+#define SUMMEDAREATABLE_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * Raw moments of all pixel coordinates inside a region.
+ */
+typedef struct sMoments {
+    // Weight sum (number of events or pixels)
+    int64_t n;
+    // Sum of coordinates
+    int64_t x, y;
+    // Sum of squared coordinates
+    int64_t xx, yy;
+} sMoments;
+
+/**
+ * @brief The SummedAreaTable class stores integral images of the per pixel
+ * event counts and their first and second order coordinate moments.
+ * Each table is computed for all events and for unique pixels (each pixel
+ * with events counted once), so the moments of any rectangle
+ * can be queried with four lookups.
+ */
+class SummedAreaTable
+{
+public:
+    SummedAreaTable();
+
+    /**
+     * @brief compute Recomputes the tables from per pixel data.
+     * @param count Number of events per pixel
+     * @param occupancy Nonzero for pixels with at least one event
+     * @param sx
+     * @param sy
+     */
+    void compute(const uint32_t* count, const uint8_t* occupancy, uint16_t sx, uint16_t sy);
+
+    /**
+     * @brief getMoments Returns the moments of all pixels inside the rectangle.
+     * The rectangle is clipped to the image.
+     * @param r
+     * @param allEvents Use all events, otherwise each active pixel is counted once
+     * @return
+     */
+    sMoments getMoments(const cv::Rect &r, bool allEvents) const;
+
+    /**
+     * @brief getEventCount Returns the number of events inside the rectangle.
+     * @param r
+     * @return
+     */
+    int64_t getEventCount(const cv::Rect &r) const
+    {
+        return getMoments(r,true).n;
+    }
+
+private:
+    // Tables with (sx+1)*(sy+1) entries, first row and column are zero
+    std::vector<sMoments> m_allEvents;
+    std::vector<sMoments> m_uniquePixels;
+    uint16_t m_sx,m_sy;
+};
+
+#endif // SUMMEDAREATABLE_H
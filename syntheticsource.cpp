@@ -0,0 +1,375 @@
+#include "syntheticsource.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <math.h>
+
+#include "settings.h"
+
+// Limits of the scene spec
+#define SYNTHETIC_MAX_PEOPLE 16
+#define SYNTHETIC_MAX_FLICKER 16
+// Events of a person that stands still, e.g. from moving arms, as edge speed in px/s
+#define SYNTHETIC_IDLE_SPEED 20.0f
+// Events per pixel of a flicker source at each transition
+#define SYNTHETIC_FLICKER_EVENTS_PER_PIXEL 2
+
+SyntheticSource::SyntheticSource():
+    m_isOpen(false),
+    m_rate(SYNTHETIC_RATE),
+    m_noiseRate(SYNTHETIC_NOISE_RATE),
+    m_peopleCnt(SYNTHETIC_PEOPLE),
+    m_fallTs(INT64_MAX),
+    m_flickerCnt(SYNTHETIC_FLICKER),
+    m_flickerHz(SYNTHETIC_FLICKER_HZ),
+    m_duration(0),
+    m_seed(1),
+    m_rng(1),
+    m_sliceStart(0),
+    m_sliceEventCnt(0),
+    m_sliceEvent(0),
+    m_eventCarry(0),
+    m_totalWeight(0),
+    m_nextGtTs(0),
+    m_fallReported(false),
+    m_generatedCnt(0),
+    m_finished(false)
+{
+}
+
+SyntheticSource::~SyntheticSource()
+{
+    close();
+}
+
+bool SyntheticSource::open(QString spec)
+{
+    close();
+    if(spec.startsWith(SYNTHETIC_SOURCE_PREFIX))
+        spec = spec.mid(QString(SYNTHETIC_SOURCE_PREFIX).length());
+
+    int sx = SYNTHETIC_WIDTH, sy = SYNTHETIC_HEIGHT;
+    double fall = SYNTHETIC_FALL_S;
+    double duration = SYNTHETIC_DURATION_S;
+    m_rate = SYNTHETIC_RATE;
+    m_noiseRate = SYNTHETIC_NOISE_RATE;
+    m_peopleCnt = SYNTHETIC_PEOPLE;
+    m_flickerCnt = SYNTHETIC_FLICKER;
+    m_flickerHz = SYNTHETIC_FLICKER_HZ;
+    m_seed = 1;
+    m_gtFileName = SYNTHETIC_GT_FILE;
+
+    QStringList entries = spec.split(",",QString::SkipEmptyParts);
+    for(int i = 0; i < entries.size(); i++) {
+        QString key = entries.at(i).section('=',0,0).trimmed();
+        QString value = entries.at(i).section('=',1).trimmed();
+        bool ok = true;
+        if(key == "size") {
+            QStringList parts = value.split("x");
+            ok = parts.size() == 2;
+            if(ok)
+                sx = parts.at(0).toInt(&ok);
+            if(ok)
+                sy = parts.at(1).toInt(&ok);
+        } else if(key == "rate")
+            m_rate = value.toDouble(&ok);
+        else if(key == "noise")
+            m_noiseRate = value.toDouble(&ok);
+        else if(key == "people")
+            m_peopleCnt = value.toInt(&ok);
+        else if(key == "fall")
+            fall = value.toDouble(&ok);
+        else if(key == "flicker")
+            m_flickerCnt = value.toInt(&ok);
+        else if(key == "flickerHz")
+            m_flickerHz = value.toDouble(&ok);
+        else if(key == "duration")
+            duration = value.toDouble(&ok);
+        else if(key == "seed")
+            m_seed = value.toULongLong(&ok);
+        else if(key == "gt")
+            m_gtFileName = value;
+        else
+            ok = false;
+
+        if(!ok) {
+            printf("Invalid synthetic scene parameter: %s\n", entries.at(i).toStdString().c_str());
+            return false;
+        }
+    }
+
+    if(sx < 32 || sy < 32 || sx > DVS_EVENT_X_MASK || sy > DVS_EVENT_Y_MASK
+            || m_rate < 0 || m_noiseRate < 0 || duration <= 0
+            || m_peopleCnt < 0 || m_peopleCnt > SYNTHETIC_MAX_PEOPLE
+            || m_flickerCnt < 0 || m_flickerCnt > SYNTHETIC_MAX_FLICKER || m_flickerHz <= 0) {
+        printf("Invalid synthetic scene: %s\n", spec.toStdString().c_str());
+        return false;
+    }
+
+    m_sx = sx;
+    m_sy = sy;
+    m_startTs = 0;
+    m_duration = (int64_t)(duration*1000000);
+    m_fallTs = fall >= 0 ? (int64_t)(fall*1000000) : INT64_MAX;
+
+    // The scene is the same for each seed
+    m_rng = m_seed ^ 0x9E3779B97F4A7C15ULL;
+    if(m_rng == 0)
+        m_rng = 1;
+    m_people.resize(m_peopleCnt);
+    float range = sceneRight() - sceneLeft();
+    for(int i = 0; i < m_peopleCnt; i++) {
+        sPerson &p = m_people[i];
+        p.w = m_sy/5.0f;
+        p.h = m_sy/2.0f;
+        p.x0 = sceneLeft() + (i + 0.5f)*range/m_peopleCnt;
+        p.speed = m_sx/8.0f*(0.7f + 0.6f*rand01())*(i % 2 == 0 ? 1 : -1);
+        p.fallTs = i == 0 ? m_fallTs : INT64_MAX;
+    }
+    m_flickers.resize(m_flickerCnt);
+    float flickerSz = std::max(4.0f,m_sy/15.0f);
+    for(int i = 0; i < m_flickerCnt; i++) {
+        sBox &b = m_flickers[i];
+        b.x = (i + 1)*m_sx/(m_flickerCnt + 1.0f) - flickerSz/2;
+        b.y = 0.05f*m_sy;
+        b.w = b.h = flickerSz;
+    }
+    m_objects.resize(m_peopleCnt + m_flickerCnt);
+
+    m_isOpen = true;
+    printf("Synthetic scene: %dx%d, %.0f events/s, %.0f noise events/s, %d people, fall at %.2f s, "
+           "%d flicker sources at %.0f Hz, %.1f s\n",
+           m_sx, m_sy, m_rate, m_noiseRate, m_peopleCnt, m_peopleCnt > 0 ? fall : -1.0,
+           m_flickerCnt, m_flickerHz, duration);
+    return true;
+}
+
+void SyntheticSource::close()
+{
+    EventSource::close();
+    if(m_gtFile.isOpen())
+        m_gtFile.close();
+    m_isOpen = false;
+    m_people.clear();
+    m_flickers.clear();
+    m_objects.clear();
+}
+
+void SyntheticSource::setRange(int64_t t0, int64_t t1)
+{
+    m_t0 = t0;
+    m_t1 = t1;
+    t0 = std::max(t0,(int64_t)0);
+    // Positions are functions of the time, the scene starts directly at t0
+    m_sliceStart = t0 - SYNTHETIC_SLICE_US;
+    m_sliceEventCnt = m_sliceEvent = 0;
+    m_eventCarry = 0;
+    m_nextGtTs = (t0 + SYNTHETIC_GT_INTERVAL_US - 1)/SYNTHETIC_GT_INTERVAL_US*SYNTHETIC_GT_INTERVAL_US;
+    m_fallReported = m_peopleCnt == 0 || m_fallTs < t0;
+    m_generatedCnt = 0;
+    m_finished = false;
+
+    if(m_gtFile.isOpen())
+        m_gtFile.close();
+    m_gtFile.setFileName(m_gtFileName);
+    if(m_gtFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        m_gtFile.write("t_us,type,id,x,y,w,h\n");
+    else
+        printf("Can't create ground truth file %s\n", m_gtFileName.toStdString().c_str());
+    m_timer.start();
+}
+
+size_t SyntheticSource::nextEvents(sDVSEvent *events, int64_t *ts, size_t maxCnt)
+{
+    size_t n = 0;
+    while(n < maxCnt) {
+        if(m_sliceEvent >= m_sliceEventCnt) {
+            if(!nextSlice())
+                break;
+            continue;
+        }
+
+        // Events are spread evenly over the slice to keep them ordered
+        float f = (float)m_sliceEvent/m_sliceEventCnt;
+        int64_t t = m_sliceStart + (int64_t)(m_sliceEvent*SYNTHETIC_SLICE_US/m_sliceEventCnt);
+        m_sliceEvent++;
+
+        float r = rand01()*m_totalWeight;
+        size_t idx = 0;
+        while(idx < m_objects.size() && r >= m_objects[idx].weight) {
+            r -= m_objects[idx].weight;
+            idx++;
+        }
+
+        float x, y;
+        bool pol;
+        if(idx == m_objects.size()) {
+            // Noise
+            x = rand01()*m_sx;
+            y = rand01()*m_sy;
+            pol = nextRand() & 1;
+        } else if(idx >= m_people.size()) {
+            // Flicker, each pixel of the square changes
+            const sObject &o = m_objects[idx];
+            x = o.box0.x + rand01()*o.box0.w;
+            y = o.box0.y + rand01()*o.box0.h;
+            pol = o.pol;
+        } else {
+            // Person, events on the edges of the box at the event time
+            const sObject &o = m_objects[idx];
+            sBox b;
+            b.x = o.box0.x + f*(o.box1.x - o.box0.x);
+            b.y = o.box0.y + f*(o.box1.y - o.box0.y);
+            b.w = o.box0.w + f*(o.box1.w - o.box0.w);
+            b.h = o.box0.h + f*(o.box1.h - o.box0.h);
+
+            float e = rand01()*o.edgeWeight[3];
+            int edge = 0;
+            while(edge < 3 && e >= o.edgeWeight[edge])
+                edge++;
+            float u = rand01();
+            float jitter = 2*rand01() - 1;
+            switch(edge) {
+            case 0:
+                x = b.x + jitter;
+                y = b.y + u*b.h;
+                break;
+            case 1:
+                x = b.x + b.w + jitter;
+                y = b.y + u*b.h;
+                break;
+            case 2:
+                x = b.x + u*b.w;
+                y = b.y + jitter;
+                break;
+            default:
+                x = b.x + u*b.w;
+                y = b.y + b.h + jitter;
+                break;
+            }
+            // Moving edges: ON at the leading, OFF at the trailing side
+            float motion = o.edgeMotion[edge]*1000000.0f/SYNTHETIC_SLICE_US;
+            if(rand01()*(fabsf(motion) + SYNTHETIC_IDLE_SPEED) < fabsf(motion))
+                pol = motion > 0;
+            else
+                pol = nextRand() & 1;
+        }
+
+        int xi = std::min(std::max((int)x,0),m_sx - 1);
+        int yi = std::min(std::max((int)y,0),m_sy - 1);
+        pushEvent(xi,yi,pol,t,events,ts,n);
+    }
+    m_generatedCnt += n;
+
+    // End of the scene
+    if(n < maxCnt && !m_finished) {
+        m_finished = true;
+        double elapsed = m_timer.nsecsElapsed()*1e-9;
+        printf("Synthetic source: %zu events in %.2f s, %.2f Mev/s including processing\n",
+               m_generatedCnt, elapsed, elapsed > 0 ? m_generatedCnt/elapsed*1e-6 : 0);
+        if(m_gtFile.isOpen())
+            m_gtFile.close();
+    }
+    return n;
+}
+
+SyntheticSource::sBox SyntheticSource::personBox(const SyntheticSource::sPerson &p, int64_t t) const
+{
+    // Walking back and forth between the scene borders until the fall
+    double range = sceneRight() - sceneLeft();
+    double pos = p.x0 - sceneLeft() + p.speed*(std::min(t,p.fallTs)*1e-6);
+    pos = fmod(pos,2*range);
+    if(pos < 0)
+        pos += 2*range;
+    float xc = sceneLeft() + (pos < range ? pos : 2*range - pos);
+
+    // The fall accelerates from standing to lying
+    float s = 0;
+    if(t > p.fallTs) {
+        float progress = (float)(t - p.fallTs)/SYNTHETIC_FALL_DURATION_US;
+        s = progress >= 1 ? 1 : progress*progress;
+    }
+    sBox b;
+    b.w = p.w + s*(p.h - p.w);
+    b.h = p.h + s*(p.w - p.h);
+    b.x = xc - b.w/2;
+    b.y = sceneFloor() - b.h;
+    return b;
+}
+
+bool SyntheticSource::nextSlice()
+{
+    m_sliceStart += SYNTHETIC_SLICE_US;
+    int64_t sliceEnd = m_sliceStart + SYNTHETIC_SLICE_US;
+    if(m_sliceStart >= m_duration || m_sliceStart > m_t1)
+        return false;
+
+    while(m_nextGtTs < sliceEnd) {
+        writeGroundTruth(m_nextGtTs);
+        m_nextGtTs += SYNTHETIC_GT_INTERVAL_US;
+    }
+    if(!m_fallReported && m_fallTs < sliceEnd) {
+        m_fallReported = true;
+        sBox b = personBox(m_people[0],m_fallTs);
+        printf("[Ground truth] Fall of person 0, Time: %lld\n", (long long)m_fallTs);
+        if(m_gtFile.isOpen())
+            m_gtFile.write(QString("%1,fall,0,%2,%3,%4,%5\n").arg((long long)m_fallTs)
+                           .arg(b.x).arg(b.y).arg(b.w).arg(b.h).toLatin1());
+    }
+
+    // Event shares of the people are proportional to the edge length and speed
+    float signal = 0;
+    for(size_t i = 0; i < m_people.size(); i++) {
+        sObject &o = m_objects[i];
+        o.box0 = personBox(m_people[i],m_sliceStart);
+        o.box1 = personBox(m_people[i],sliceEnd);
+        o.edgeMotion[0] = o.box0.x - o.box1.x;
+        o.edgeMotion[1] = (o.box1.x + o.box1.w) - (o.box0.x + o.box0.w);
+        o.edgeMotion[2] = o.box0.y - o.box1.y;
+        o.edgeMotion[3] = (o.box1.y + o.box1.h) - (o.box0.y + o.box0.h);
+        float sum = 0;
+        for(int e = 0; e < 4; e++) {
+            float len = e < 2 ? o.box0.h : o.box0.w;
+            sum += len*(fabsf(o.edgeMotion[e])*1000000.0f/SYNTHETIC_SLICE_US + SYNTHETIC_IDLE_SPEED);
+            o.edgeWeight[e] = sum;
+        }
+        o.weight = sum;
+        signal += sum;
+    }
+    float signalCnt = m_people.empty() ? 0 : std::max(m_rate - m_noiseRate,0.0)*SYNTHETIC_SLICE_US*1e-6;
+    float total = m_noiseRate*SYNTHETIC_SLICE_US*1e-6;
+    for(size_t i = 0; i < m_people.size(); i++) {
+        m_objects[i].weight *= signalCnt/signal;
+        total += m_objects[i].weight;
+    }
+
+    // Flickers only produce events in slices with a transition
+    for(size_t i = 0; i < m_flickers.size(); i++) {
+        sObject &o = m_objects[m_people.size() + i];
+        int64_t k0 = (int64_t)(m_sliceStart*2e-6*m_flickerHz);
+        int64_t k1 = (int64_t)(sliceEnd*2e-6*m_flickerHz);
+        o.box0 = o.box1 = m_flickers[i];
+        o.pol = k1 % 2 == 0;
+        o.weight = k1 != k0 ? o.box0.w*o.box0.h*SYNTHETIC_FLICKER_EVENTS_PER_PIXEL : 0;
+        total += o.weight;
+    }
+
+    m_totalWeight = total;
+    m_eventCarry += total;
+    m_sliceEventCnt = (size_t)m_eventCarry;
+    m_eventCarry -= m_sliceEventCnt;
+    m_sliceEvent = 0;
+    return true;
+}
+
+void SyntheticSource::writeGroundTruth(int64_t t)
+{
+    if(!m_gtFile.isOpen())
+        return;
+    for(size_t i = 0; i < m_people.size(); i++) {
+        sBox b = personBox(m_people[i],t);
+        m_gtFile.write(QString("%1,box,%2,%3,%4,%5,%6\n").arg((long long)t).arg((int)i)
+                       .arg(b.x).arg(b.y).arg(b.w).arg(b.h).toLatin1());
+    }
+}
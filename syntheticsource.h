@@ -0,0 +1,139 @@
+#ifndef SYNTHETICSOURCE_H
+#define SYNTHETICSOURCE_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include <QFile>
+#include <QString>
+#include <QElapsedTimer>
+
+#include "eventsource.h"
+
+/**
+ * @brief The SyntheticSource class generates event streams of parametric scenes.
+ * People are rectangles walking left and right, one of them falls at a scripted
+ * time. Flicker sources toggle squares at a fixed frequency and noise events are
+ * spread uniformly over the sensor. Events are generated at the configured rate
+ * on the edges of the moving objects, ordered by time.
+ * The ground truth boxes and fall times are written to a CSV file
+ * "t_us,type,id,x,y,w,h" to measure the detection latency.
+ * The scene is opened with a spec "key=value,..." (see SYNTHETIC_SOURCE_PREFIX).
+ */
+class SyntheticSource : public EventSource
+{
+public:
+    SyntheticSource();
+    ~SyntheticSource();
+
+    /**
+     * @brief open Parses the scene spec, with or without SYNTHETIC_SOURCE_PREFIX.
+     * @param spec
+     * @return False if the spec is invalid
+     */
+    bool open(QString spec);
+    void close();
+    bool isOpen() const
+    {
+        return m_isOpen;
+    }
+
+    /**
+     * @brief setRange Restarts the scene at t0 and truncates the ground truth file.
+     * @param t0
+     * @param t1
+     */
+    void setRange(int64_t t0, int64_t t1);
+    size_t nextEvents(sDVSEvent* events, int64_t* ts, size_t maxCnt);
+
+private:
+    typedef struct sBox {
+        float x, y, w, h;
+    } sBox;
+    typedef struct sPerson {
+        // Start position and walking speed in px/s, negative to the left
+        float x0, speed;
+        float w, h;
+        // Start of the fall, INT64_MAX if the person doesn't fall
+        int64_t fallTs;
+    } sPerson;
+    typedef struct sObject {
+        // Box at the start and the end of the slice
+        sBox box0, box1;
+        // Cumulative event shares of the edges left, right, top, bottom
+        float edgeWeight[4];
+        // Displacement of each edge in px/slice, positive to the outside
+        float edgeMotion[4];
+        // Flickers: Polarity of the transition
+        bool pol;
+        // Expected number of events in the slice
+        float weight;
+    } sObject;
+
+    /**
+     * @brief personBox Returns the box of a person at time t.
+     */
+    sBox personBox(const sPerson &p, int64_t t) const;
+    float sceneLeft() const
+    {
+        return 0.25f*m_sx;
+    }
+    float sceneRight() const
+    {
+        return 0.75f*m_sx;
+    }
+    float sceneFloor() const
+    {
+        return 0.95f*m_sy;
+    }
+    /**
+     * @brief nextSlice Updates the objects and their event shares for the next slice.
+     * @return False at the end of the scene
+     */
+    bool nextSlice();
+    void writeGroundTruth(int64_t t);
+
+    inline uint32_t nextRand()
+    {
+        // xorshift64*
+        m_rng ^= m_rng >> 12;
+        m_rng ^= m_rng << 25;
+        m_rng ^= m_rng >> 27;
+        return (uint32_t)((m_rng*2685821657736338717ULL) >> 32);
+    }
+    inline float rand01()
+    {
+        return (nextRand() >> 8)*(1.0f/16777216.0f);
+    }
+
+    bool m_isOpen;
+    // Scene parameters
+    double m_rate, m_noiseRate;
+    int m_peopleCnt;
+    int64_t m_fallTs;
+    int m_flickerCnt;
+    double m_flickerHz;
+    int64_t m_duration;
+    uint64_t m_seed;
+    QString m_gtFileName;
+
+    std::vector<sPerson> m_people;
+    std::vector<sBox> m_flickers;
+    // People followed by flickers, noise is the remaining share
+    std::vector<sObject> m_objects;
+
+    uint64_t m_rng;
+    int64_t m_sliceStart;
+    size_t m_sliceEventCnt, m_sliceEvent;
+    double m_eventCarry;
+    float m_totalWeight;
+    int64_t m_nextGtTs;
+    bool m_fallReported;
+
+    QFile m_gtFile;
+    QElapsedTimer m_timer;
+    size_t m_generatedCnt;
+    bool m_finished;
+};
+
+#endif // SYNTHETICSOURCE_H
@@ -0,0 +1,120 @@
+#include "temporalsmoothing.h"
+
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <opencv2/opencv.hpp>
+
+#include "settings.h"
+
+/**
+ * @brief smoothScalar Reference implementation, the same expression as the original dense path.
+ */
+static void smoothScalar(const uint8_t* img, uint8_t* state, uint8_t* mask, uint8_t* preview,
+                         size_t cnt, uint8_t threshold)
+{
+    for(size_t i = 0; i < cnt; i++) {
+        uint8_t b = TRACK_BOX_TEMPORAL_SMOOTHING*img[i]+(1-TRACK_BOX_TEMPORAL_SMOOTHING)*state[i];
+        state[i] = b;
+        mask[i] = b > threshold ? 255 : 0;
+        if(preview != NULL)
+            preview[i] = mask[i];
+    }
+}
+
+#ifdef __SSE2__
+/**
+ * @brief blendQuarter Blends 4 pixels given as 32 bit integers with the
+ * same double precision products and sum as the scalar expression.
+ */
+static inline __m128i blendQuarter(__m128i img, __m128i state, __m128d wImg, __m128d wState)
+{
+    __m128d i0 = _mm_cvtepi32_pd(img);
+    __m128d i1 = _mm_cvtepi32_pd(_mm_srli_si128(img,8));
+    __m128d s0 = _mm_cvtepi32_pd(state);
+    __m128d s1 = _mm_cvtepi32_pd(_mm_srli_si128(state,8));
+    // Truncation like the conversion to uint8_t
+    __m128i r0 = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(wImg,i0),_mm_mul_pd(wState,s0)));
+    __m128i r1 = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(wImg,i1),_mm_mul_pd(wState,s1)));
+    return _mm_unpacklo_epi64(r0,r1);
+}
+#endif
+
+void smoothAndThreshold(const uint8_t* img, uint8_t* state, uint8_t* mask, uint8_t* preview,
+                        size_t cnt, uint8_t threshold, bool vectorized)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    if(vectorized) {
+        const __m128d wImg = _mm_set1_pd(TRACK_BOX_TEMPORAL_SMOOTHING);
+        const __m128d wState = _mm_set1_pd(1-TRACK_BOX_TEMPORAL_SMOOTHING);
+        const __m128i zero = _mm_setzero_si128();
+        // Unsigned comparison by flipping the sign bits
+        const __m128i sign = _mm_set1_epi8((char)0x80);
+        const __m128i thr = _mm_set1_epi8((char)(threshold ^ 0x80));
+
+        // 16 pixels per step, the image is read before the mask is written
+        for(; i + 16 <= cnt; i += 16) {
+            __m128i vImg = _mm_loadu_si128((const __m128i*)(img + i));
+            __m128i vState = _mm_loadu_si128((const __m128i*)(state + i));
+            __m128i img16[2] = {_mm_unpacklo_epi8(vImg,zero),_mm_unpackhi_epi8(vImg,zero)};
+            __m128i state16[2] = {_mm_unpacklo_epi8(vState,zero),_mm_unpackhi_epi8(vState,zero)};
+            __m128i res16[2];
+            for(int h = 0; h < 2; h++) {
+                __m128i lo = blendQuarter(_mm_unpacklo_epi16(img16[h],zero),_mm_unpacklo_epi16(state16[h],zero),wImg,wState);
+                __m128i hi = blendQuarter(_mm_unpackhi_epi16(img16[h],zero),_mm_unpackhi_epi16(state16[h],zero),wImg,wState);
+                res16[h] = _mm_packs_epi32(lo,hi);
+            }
+            __m128i res = _mm_packus_epi16(res16[0],res16[1]);
+            __m128i m = _mm_cmpgt_epi8(_mm_xor_si128(res,sign),thr);
+            _mm_storeu_si128((__m128i*)(state + i),res);
+            _mm_storeu_si128((__m128i*)(mask + i),m);
+            if(preview != NULL)
+                _mm_storeu_si128((__m128i*)(preview + i),m);
+        }
+    }
+#endif
+    smoothScalar(img + i,state + i,mask + i,preview != NULL ? preview + i : NULL,cnt - i,threshold);
+}
+
+/**
+ * @brief runCheck Runs both kernels on all 65536 pairs plus a tail that is not a multiple of the vector width
+ * and compares them with the original blend loop followed by cv::threshold, which floors the threshold.
+ */
+static bool runCheck()
+{
+    const size_t cnt = 256*256 + 7;
+    const uint8_t threshold = (uint8_t)TRACK_BOX_DETECTOR_THRESHOLD;
+    std::vector<uint8_t> img(cnt), state(cnt);
+    for(size_t i = 0; i < cnt; i++) {
+        img[i] = i & 0xFF;
+        state[i] = (i >> 8) & 0xFF;
+    }
+
+    // Original dense path: Blend into the image and the state, threshold the image
+    std::vector<uint8_t> origState = state, origMask = img;
+    for(size_t i = 0; i < cnt; i++) {
+        origMask[i] = TRACK_BOX_TEMPORAL_SMOOTHING*origMask[i]+(1-TRACK_BOX_TEMPORAL_SMOOTHING)*origState[i];
+        origState[i] = origMask[i];
+    }
+    cv::Mat origMat(1,cnt,CV_8UC1,origMask.data());
+    cv::threshold(origMat,origMat,TRACK_BOX_DETECTOR_THRESHOLD,255,CV_THRESH_BINARY);
+
+    bool exact = true;
+    for(int vectorized = 0; vectorized < 2; vectorized++) {
+        // In place like the dense path: The mask overwrites the image
+        std::vector<uint8_t> s = state, mask = img, preview(cnt);
+        smoothAndThreshold(mask.data(),s.data(),mask.data(),preview.data(),cnt,threshold,vectorized != 0);
+        exact = exact && s == origState && mask == origMask && preview == origMask;
+    }
+    return exact;
+}
+
+bool checkSmoothAndThreshold()
+{
+    static const bool exact = runCheck();
+    return exact;
+}
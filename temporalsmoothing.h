@@ -0,0 +1,33 @@
+#ifndef TEMPORALSMOOTHING_H
+#define TEMPORALSMOOTHING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief smoothAndThreshold Blends the spatially smoothed image into the temporal
+ * smoothing state, thresholds the new state and exports the mask in a single pass:
+ * state = TRACK_BOX_TEMPORAL_SMOOTHING*img + (1-TRACK_BOX_TEMPORAL_SMOOTHING)*state,
+ * truncated to 8 bit, mask = state > threshold ? 255 : 0.
+ * The blend is computed in double precision with SSE2 if available,
+ * so both variants give the same result as the scalar expression.
+ * @param img Spatially smoothed image, may be the same array as mask
+ * @param state Temporal smoothing state, updated in place
+ * @param mask Binary mask
+ * @param preview Optional copy of the mask, NULL to skip
+ * @param cnt Number of pixels
+ * @param threshold
+ * @param vectorized Use SSE2 if available, otherwise the scalar expression
+ */
+void smoothAndThreshold(const uint8_t* img, uint8_t* state, uint8_t* mask, uint8_t* preview,
+                        size_t cnt, uint8_t threshold, bool vectorized = true);
+
+/**
+ * @brief checkSmoothAndThreshold Compares the vectorized and the scalar kernel with
+ * the original blend followed by cv::threshold for all pairs of image and state values.
+ * The check runs once, later calls return the stored result.
+ * @return True if both kernels give the same state, mask and preview as the original
+ */
+bool checkSmoothAndThreshold();
+
+#endif // TEMPORALSMOOTHING_H
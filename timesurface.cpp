@@ -0,0 +1,101 @@
+#include "timesurface.h"
+
+#include <cmath>
+#include <algorithm>
+
+TimeSurface::TimeSurface():
+    m_initialized(false),
+    m_refractory(0),
+    m_cellSz(1),
+    m_cellsX(0),
+    m_cellsY(0),
+    m_sx(0),
+    m_sy(0)
+{
+}
+
+void TimeSurface::setup(uint16_t sx, uint16_t sy, int cellSz, uint32_t tau, uint32_t refractory)
+{
+    m_sx = sx;
+    m_sy = sy;
+    m_cellSz = std::max(1,cellSz);
+    m_cellsX = (sx + m_cellSz - 1)/m_cellSz;
+    m_cellsY = (sy + m_cellSz - 1)/m_cellSz;
+    m_refractory = refractory;
+
+    // Factors below exp(-TIME_SURFACE_LUT_RANGE_TAU) are treated as zero
+    size_t lutSz = ((uint64_t)tau*TIME_SURFACE_LUT_RANGE_TAU >> TIME_SURFACE_LUT_SHIFT) + 1;
+    m_decayLUT.resize(lutSz);
+    for(size_t i = 0; i < lutSz; i++)
+        m_decayLUT[i] = std::exp(-(double)(i << TIME_SURFACE_LUT_SHIFT)/tau);
+
+    m_activity.resize(m_cellsX*m_cellsY);
+    m_cellTs.resize(m_cellsX*m_cellsY);
+    m_invCellArea.resize(m_cellsX*m_cellsY);
+    for(int cy = 0; cy < m_cellsY; cy++) {
+        int h = std::min(m_cellSz, sy - cy*m_cellSz);
+        for(int cx = 0; cx < m_cellsX; cx++) {
+            int w = std::min(m_cellSz, sx - cx*m_cellSz);
+            m_invCellArea[cy*m_cellsX+cx] = 1.0f/(w*h);
+        }
+    }
+    m_pixelTs.resize(sx*sy);
+    m_cellOfX.resize(sx);
+    for(int x = 0; x < sx; x++)
+        m_cellOfX[x] = x/m_cellSz;
+
+    clear();
+}
+
+void TimeSurface::clear()
+{
+    std::fill(m_activity.begin(),m_activity.end(),0.0f);
+    m_initialized = false;
+}
+
+void TimeSurface::addEvents(const sDVSEvent *events, size_t cnt)
+{
+    if(cnt == 0)
+        return;
+
+    if(!m_initialized) {
+        // All pixels may contribute immediately
+        uint32_t ts = events[0].ts;
+        std::fill(m_pixelTs.begin(),m_pixelTs.end(),ts - m_refractory);
+        std::fill(m_cellTs.begin(),m_cellTs.end(),ts);
+        m_initialized = true;
+    }
+
+    for(size_t i = 0; i < cnt; i++) {
+        const uint32_t ts = events[i].ts;
+        const uint32_t addr = events[i].addr;
+        const uint16_t x = dvsEventX(addr);
+        const uint16_t y = dvsEventY(addr);
+        if(x >= m_sx || y >= m_sy)
+            continue;
+
+        uint32_t &pixelTs = m_pixelTs[y*m_sx + x];
+        if(ts - pixelTs < m_refractory)
+            continue;
+        pixelTs = ts;
+
+        size_t c = (y/m_cellSz)*m_cellsX + m_cellOfX[x];
+        m_activity[c] = m_activity[c]*decay(ts - m_cellTs[c]) + 1.0f;
+        m_cellTs[c] = ts;
+    }
+}
+
+void TimeSurface::computeDensity(uint32_t ts, cv::Mat &density)
+{
+    density.create(m_cellsY,m_cellsX,CV_32FC1);
+    float* dPtr = density.ptr<float>();
+    for(size_t c = 0; c < m_activity.size(); c++) {
+        // Move all cells to the current time, this keeps the
+        // time differences small even for cells without events
+        if(m_initialized) {
+            m_activity[c] *= decay(ts - m_cellTs[c]);
+            m_cellTs[c] = ts;
+        }
+        dPtr[c] = m_activity[c]*m_invCellArea[c];
+    }
+}
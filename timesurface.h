@@ -0,0 +1,96 @@
+#ifndef TIMESURFACE_H
+#define TIMESURFACE_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "datatypes.h"
+#include "settings.h"
+
+/**
+ * @brief The TimeSurface class maintains an exponentially decaying activity
+ * surface on a coarse grid of cells. It is updated per event and replaces the
+ * dense spatial and temporal smoothing of the occupancy image.
+ * Each pixel contributes at most once per refractory period to its cell, so the
+ * normalized activity approximates the fraction of recently active pixels.
+ */
+class TimeSurface
+{
+public:
+    TimeSurface();
+
+    /**
+     * @brief setup Allocates the cell grid and the decay lookup table.
+     * @param sx Width of the event grid
+     * @param sy Height of the event grid
+     * @param cellSz Edge length of a cell in pixels
+     * @param tau Time constant of the exponential decay in us
+     * @param refractory Minimum time between two contributions of the same pixel in us
+     */
+    void setup(uint16_t sx, uint16_t sy, int cellSz, uint32_t tau, uint32_t refractory);
+    /**
+     * @brief clear Resets all activities.
+     */
+    void clear();
+    /**
+     * @brief addEvents Adds a batch of events, ordered from old to new.
+     * @param events
+     * @param cnt
+     */
+    void addEvents(const sDVSEvent* events, size_t cnt);
+    /**
+     * @brief computeDensity Decays all cells to the provided time and returns
+     * the activity per pixel of each cell as CV_32FC1 image with the size of the cell grid.
+     * @param ts Lower 32 bits of the current time
+     * @param density
+     */
+    void computeDensity(uint32_t ts, cv::Mat &density);
+
+    int getCellSize() const
+    {
+        return m_cellSz;
+    }
+    int getCellsX() const
+    {
+        return m_cellsX;
+    }
+    int getCellsY() const
+    {
+        return m_cellsY;
+    }
+
+private:
+    /**
+     * @brief decay Returns the decay factor for a time difference.
+     * @param dt
+     * @return
+     */
+    float decay(uint32_t dt) const
+    {
+        uint32_t idx = dt >> TIME_SURFACE_LUT_SHIFT;
+        return idx < m_decayLUT.size() ? m_decayLUT[idx] : 0.0f;
+    }
+
+    // Decay factors for time differences in steps of 2^TIME_SURFACE_LUT_SHIFT us
+    std::vector<float> m_decayLUT;
+    // Per cell activity and time of its last update
+    std::vector<float> m_activity;
+    std::vector<uint32_t> m_cellTs;
+    // Inverse number of pixels per cell, smaller at the right and bottom border
+    std::vector<float> m_invCellArea;
+    // Per pixel time of the last contribution
+    std::vector<uint32_t> m_pixelTs;
+    // Maps pixel columns to cell columns
+    std::vector<uint16_t> m_cellOfX;
+    // True after the first event, timestamps are initialized relative to it
+    bool m_initialized;
+
+    uint32_t m_refractory;
+    int m_cellSz;
+    int m_cellsX, m_cellsY;
+    uint16_t m_sx, m_sy;
+};
+
+#endif // TIMESURFACE_H